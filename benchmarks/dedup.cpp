@@ -0,0 +1,93 @@
+#include <argparse/argparse.hpp>
+#include <atomic>
+#include <jaffarCommon/concurrent.hpp>
+#include <jaffarCommon/dedup.hpp>
+#include <jaffarCommon/parallel.hpp>
+#include <jaffarCommon/string.hpp>
+#include <jaffarCommon/timing.hpp>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace jaffarCommon;
+using namespace jaffarCommon::hash;
+
+int main(int argc, char* argv[])
+{
+  argparse::ArgumentParser program("bdedup", "1.0");
+  program.add_description("Compares per-step deduplication by sorting against the history (dedup::radixSort + dedup::dedupAgainst) with insertion into a concurrent::HashSet_t");
+  program.add_argument("--threads").help("Comma-separated thread counts to test").default_value(std::string("1,2,4,8,16,32,64,128"));
+  program.add_argument("--stepCount").help("Number of search steps (batches)").default_value(size_t(16)).scan<'u', size_t>();
+  program.add_argument("--batchSize").help("Number of hashes produced per step").default_value(size_t(1000000)).scan<'u', size_t>();
+  program.add_argument("--duplicateRatio").help("Percentage of hashes that repeat an earlier one (from the same or an earlier step)").default_value(size_t(50)).scan<'u', size_t>();
+
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error& err)
+  {
+    fprintf(stderr, "%s\n%s", err.what(), program.help().str().c_str());
+    return -1;
+  }
+
+  const auto threadCounts   = string::split(program.get<std::string>("--threads"), ',');
+  const auto stepCount      = program.get<size_t>("--stepCount");
+  const auto batchSize      = program.get<size_t>("--batchSize");
+  const auto duplicateRatio = program.get<size_t>("--duplicateRatio");
+
+  // The hashes produced at every step, with the requested share repeating an earlier one (recent steps are more likely)
+  std::mt19937_64                  rng(0);
+  std::vector<std::vector<hash_t>> batches(stepCount, std::vector<hash_t>(batchSize));
+  for (size_t step = 0; step < stepCount; step++)
+    for (size_t i = 0; i < batchSize; i++)
+    {
+      const bool   isDuplicate = (step > 0 || i > 0) && rng() % 100 < duplicateRatio;
+      const size_t sourceStep  = step - std::min(step, (size_t)(rng() % 3));
+      const size_t sourceCount = sourceStep == step ? i : batchSize;
+      batches[step][i]         = isDuplicate && sourceCount > 0 ? batches[sourceStep][rng() % sourceCount] : hash_t(rng(), rng());
+    }
+
+  printf("%8s %20s %20s %14s\n", "Threads", "HashSet_t Mop/s", "Sort+dedup Mop/s", "New states");
+  for (const auto& threadString : threadCounts)
+  {
+    const size_t threadCount = std::stoul(threadString);
+    parallel::setThreadCount(threadCount);
+
+    // Hash set: every thread inserts its share of the step's hashes into the shared set
+    concurrent::HashSet_t<hash_t> set;
+    std::atomic<size_t>           setNewCount = 0;
+    auto                          t0          = timing::now();
+    for (const auto& batch : batches)
+    {
+      JAFFAR_PARALLEL
+      {
+        size_t localNew = 0;
+        JAFFAR_FOR
+        for (size_t i = 0; i < batch.size(); i++) localNew += set.insert(batch[i]).second ? 1 : 0;
+        setNewCount += localNew;
+      }
+    }
+    const double setSeconds = timing::timeDeltaSeconds(timing::now(), t0);
+
+    // Sorting: every step's batch is sorted and filtered against the sorted runs of the earlier steps
+    std::vector<std::vector<hash_t>> history;
+    size_t                           sortNewCount = 0;
+    t0                                            = timing::now();
+    for (const auto& batch : batches)
+    {
+      std::vector<hash_t> sorted = batch;
+      dedup::radixSort(sorted);
+      sortNewCount += dedup::dedupAgainst(sorted, history);
+      history.push_back(std::move(sorted));
+    }
+    const double sortSeconds = timing::timeDeltaSeconds(timing::now(), t0);
+
+    if (setNewCount != sortNewCount) fprintf(stderr, "New state count mismatch: %lu vs %lu\n", setNewCount.load(), sortNewCount);
+
+    const double totalOperations = (double)(stepCount * batchSize) * 1.0e-6;
+    printf("%8lu %20.2f %20.2f %14lu\n", threadCount, totalOperations / setSeconds, totalOperations / sortSeconds, sortNewCount);
+  }
+
+  return 0;
+}
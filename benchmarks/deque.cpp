@@ -0,0 +1,87 @@
+#include <argparse/argparse.hpp>
+#include <atomic>
+#include <jaffarCommon/concurrent.hpp>
+#include <jaffarCommon/parallel.hpp>
+#include <jaffarCommon/string.hpp>
+#include <jaffarCommon/timing.hpp>
+#include <stdio.h>
+
+using namespace jaffarCommon;
+
+// Measures the throughput (millions of operations per second) of a deque used as a shared pool of free state slots:
+// a fill phase, a recycling phase where every thread takes a slot and gives it back, and a batched drain phase
+template <class Deque>
+void runPhases(const size_t elementCount, const size_t recycleCount, const size_t threadCount, double& fillRate, double& recycleRate, double& drainRate)
+{
+  Deque               deque;
+  std::atomic<size_t> drainedCount = 0;
+  parallel::setThreadCount(threadCount);
+
+  auto t0 = timing::now();
+  JAFFAR_PARALLEL_FOR
+  for (size_t i = 0; i < elementCount; i++)
+  {
+    if (i % 2 == 0) deque.push_back(i);
+    else deque.push_front(i);
+  }
+  fillRate = (double)elementCount / timing::timeDeltaSeconds(timing::now(), t0) * 1.0e-6;
+
+  t0 = timing::now();
+  JAFFAR_PARALLEL_FOR
+  for (size_t i = 0; i < recycleCount; i++)
+  {
+    size_t slot;
+    if (deque.pop_front_get(slot)) deque.push_back(slot);
+  }
+  recycleRate = 2.0 * (double)recycleCount / timing::timeDeltaSeconds(timing::now(), t0) * 1.0e-6;
+
+  t0 = timing::now();
+  JAFFAR_PARALLEL
+  {
+    size_t batch[64];
+    size_t localDrained = 0;
+    for (size_t count = deque.pop_front_get_batch(batch, 64); count > 0; count = deque.pop_front_get_batch(batch, 64)) localDrained += count;
+    drainedCount += localDrained;
+  }
+  drainRate = (double)elementCount / timing::timeDeltaSeconds(timing::now(), t0) * 1.0e-6;
+
+  if (drainedCount != elementCount) fprintf(stderr, "Drain mismatch: got %lu of %lu elements\n", drainedCount.load(), elementCount);
+}
+
+int main(int argc, char* argv[])
+{
+  argparse::ArgumentParser program("bdeque", "1.0");
+  program.add_description("Compares the concurrent throughput of concurrent::LockFreeDeque against the mutex-based concurrent::Deque");
+  program.add_argument("--threads").help("Comma-separated thread counts to test").default_value(std::string("1,2,4,8,16,32,64,128"));
+  program.add_argument("--elementCount").help("Number of elements pushed (and then drained) per run").default_value(size_t(8000000)).scan<'u', size_t>();
+  program.add_argument("--recycleCount").help("Number of pop/push pairs in the recycling phase").default_value(size_t(8000000)).scan<'u', size_t>();
+
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error& err)
+  {
+    fprintf(stderr, "%s\n%s", err.what(), program.help().str().c_str());
+    return -1;
+  }
+
+  const auto threadCounts = string::split(program.get<std::string>("--threads"), ',');
+  const auto elementCount = program.get<size_t>("--elementCount");
+  const auto recycleCount = program.get<size_t>("--recycleCount");
+
+  printf("%8s %20s %20s %20s %20s %20s %20s\n", "Threads", "Deque fill Mop/s", "LockFree fill Mop/s", "Deque recycle Mop/s", "LockFree recycle Mop/s", "Deque drain Mop/s",
+         "LockFree drain Mop/s");
+  for (const auto& threadString : threadCounts)
+  {
+    const size_t threadCount = std::stoul(threadString);
+
+    double mutexFill, mutexRecycle, mutexDrain, lockFreeFill, lockFreeRecycle, lockFreeDrain;
+    runPhases<concurrent::Deque<size_t>>(elementCount, recycleCount, threadCount, mutexFill, mutexRecycle, mutexDrain);
+    runPhases<concurrent::LockFreeDeque<size_t>>(elementCount, recycleCount, threadCount, lockFreeFill, lockFreeRecycle, lockFreeDrain);
+
+    printf("%8lu %20.2f %20.2f %20.2f %20.2f %20.2f %20.2f\n", threadCount, mutexFill, lockFreeFill, mutexRecycle, lockFreeRecycle, mutexDrain, lockFreeDrain);
+  }
+
+  return 0;
+}
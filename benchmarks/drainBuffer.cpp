@@ -0,0 +1,88 @@
+#include <argparse/argparse.hpp>
+#include <atomic>
+#include <jaffarCommon/concurrent.hpp>
+#include <jaffarCommon/parallel.hpp>
+#include <jaffarCommon/string.hpp>
+#include <jaffarCommon/timing.hpp>
+#include <stdio.h>
+#include <vector>
+
+using namespace jaffarCommon;
+
+// Fills a buffer serially, then drains it the way a search step does: most threads take batches from the front, one
+// takes single elements from the back. Returns the drain throughput (millions of elements per second)
+template <class Buffer>
+double runDrain(Buffer& buffer, const size_t elementCount, const size_t batchSize, const size_t threadCount)
+{
+  buffer.clear();
+  for (size_t i = 0; i < elementCount; i++) buffer.push_back_no_lock(i);
+
+  std::atomic<size_t> drainedCount = 0;
+  std::atomic<size_t> checksum     = 0;
+  parallel::setThreadCount(threadCount);
+
+  const auto t0 = timing::now();
+  JAFFAR_PARALLEL
+  {
+    std::vector<size_t> batch(batchSize);
+    size_t              localDrained  = 0;
+    size_t              localChecksum = 0;
+    const bool          fromBack      = parallel::getThreadCount() > 1 && parallel::getThreadId() == parallel::getThreadCount() - 1;
+    while (true)
+    {
+      const size_t taken = fromBack ? (buffer.pop_back_get(batch[0]) ? 1 : 0) : buffer.pop_front_get_batch(batch.data(), batchSize);
+      if (taken == 0) break;
+      for (size_t i = 0; i < taken; i++) localChecksum += batch[i];
+      localDrained += taken;
+    }
+    drainedCount += localDrained;
+    checksum += localChecksum;
+  }
+  const double seconds = timing::timeDeltaSeconds(timing::now(), t0);
+
+  if (drainedCount != elementCount || checksum != elementCount * (elementCount - 1) / 2)
+    fprintf(stderr, "Drain mismatch: got %lu of %lu elements\n", drainedCount.load(), elementCount);
+  return (double)elementCount / seconds * 1.0e-6;
+}
+
+int main(int argc, char* argv[])
+{
+  argparse::ArgumentParser program("bdrainBuffer", "1.0");
+  program.add_description(
+    "Compares the drain throughput of concurrent::DrainBuffer (32-bit packed claims) against concurrent::WideDrainBuffer (64-bit claims) and concurrent::SegmentedDrainBuffer");
+  program.add_argument("--threads").help("Comma-separated thread counts to test").default_value(std::string("1,2,4,8,16,32,64,128"));
+  program.add_argument("--elementCount").help("Number of elements per fill").default_value(size_t(32000000)).scan<'u', size_t>();
+  program.add_argument("--batchSize").help("Number of elements taken per front claim").default_value(size_t(64)).scan<'u', size_t>();
+
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error& err)
+  {
+    fprintf(stderr, "%s\n%s", err.what(), program.help().str().c_str());
+    return -1;
+  }
+
+  const auto threadCounts = string::split(program.get<std::string>("--threads"), ',');
+  const auto elementCount = program.get<size_t>("--elementCount");
+  const auto batchSize    = program.get<size_t>("--batchSize");
+
+  concurrent::DrainBuffer<size_t> packed;
+  packed.reserve(elementCount);
+  concurrent::WideDrainBuffer<size_t> wide;
+  wide.reserve(elementCount);
+  concurrent::SegmentedDrainBuffer<size_t> segmented;
+
+  printf("%8s %22s %22s %22s\n", "Threads", "DrainBuffer Mel/s", "WideDrainBuffer Mel/s", "Segmented Mel/s");
+  for (const auto& threadString : threadCounts)
+  {
+    const size_t threadCount   = std::stoul(threadString);
+    const double packedRate    = runDrain(packed, elementCount, batchSize, threadCount);
+    const double wideRate      = runDrain(wide, elementCount, batchSize, threadCount);
+    const double segmentedRate = runDrain(segmented, elementCount, batchSize, threadCount);
+    printf("%8lu %22.2f %22.2f %22.2f\n", threadCount, packedRate, wideRate, segmentedRate);
+  }
+
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <argparse/argparse.hpp>
+#include <jaffarCommon/hash.hpp>
+#include <jaffarCommon/hashers/crc32c.hpp>
+#include <jaffarCommon/hashers/xxh3Style.hpp>
+#include <jaffarCommon/string.hpp>
+#include <jaffarCommon/timing.hpp>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace jaffarCommon;
+using namespace jaffarCommon::hash;
+
+// Sink for benchmark results, so the compiler cannot elide the hashing
+volatile uint64_t sink = 0;
+
+// Counts the number of colliding pairs among a set of keys
+template <class Key>
+size_t countCollisions(std::vector<Key>& keys)
+{
+  std::sort(keys.begin(), keys.end());
+  size_t collisions = 0;
+  size_t run        = 1;
+  for (size_t i = 1; i <= keys.size(); i++)
+  {
+    if (i < keys.size() && keys[i] == keys[i - 1])
+    {
+      run++;
+      continue;
+    }
+    collisions += run * (run - 1) / 2;
+    run = 1;
+  }
+  return collisions;
+}
+
+template <class Hasher>
+void benchmarkBackend(const size_t stateSize, const size_t stateCount, const size_t totalBytes, const std::vector<uint8_t>& base)
+{
+  // Throughput: hashing a small pool of distinct states over and over (states are usually cache-resident right after being produced)
+  const size_t             poolSize = 64;
+  std::vector<uint8_t>     pool(poolSize * stateSize);
+  std::vector<const void*> pointers(poolSize);
+  std::vector<hash_t>      hashes(poolSize);
+  for (size_t i = 0; i < poolSize; i++) memcpy(&pool[i * stateSize], base.data(), stateSize), pool[i * stateSize] ^= (uint8_t)i, pointers[i] = &pool[i * stateSize];
+  const size_t iterations = std::max((size_t)1, totalBytes / (poolSize * stateSize));
+
+  uint64_t checksum = 0;
+  auto     t0       = timing::now();
+  for (size_t it = 0; it < iterations; it++)
+    for (size_t i = 0; i < poolSize; i++) checksum += Hasher::calculate(pointers[i], stateSize).first;
+  const double singleSeconds = timing::timeDeltaSeconds(timing::now(), t0);
+
+  t0 = timing::now();
+  for (size_t it = 0; it < iterations; it++)
+  {
+    Hasher::calculateBatch(pointers.data(), poolSize, stateSize, hashes.data());
+    checksum += hashes[it % poolSize].first;
+  }
+  const double batchSeconds = timing::timeDeltaSeconds(timing::now(), t0);
+
+  const double gigabytes = (double)(iterations * poolSize * stateSize) * 1.0e-9;
+
+  // Collisions: every state is the base state with its index XOR-ed into a random 8-byte slot, so all inputs are distinct
+  std::mt19937_64       rng(stateSize);
+  std::vector<uint8_t>  state = base;
+  std::vector<uint64_t> first(stateCount), low32(stateCount);
+  const size_t          slotCount = stateSize / 8;
+  std::vector<hash_t>   all(stateCount);
+  for (size_t i = 0; i < stateCount; i++)
+  {
+    const size_t   slot  = rng() % slotCount;
+    const uint64_t index = i + 1;
+    uint64_t       word;
+    memcpy(&word, &state[slot * 8], 8), word ^= index, memcpy(&state[slot * 8], &word, 8);
+    all[i] = Hasher::calculate(state.data(), stateSize);
+    word ^= index, memcpy(&state[slot * 8], &word, 8);
+  }
+
+  for (size_t i = 0; i < stateCount; i++) first[i] = all[i].first, low32[i] = all[i].second & 0xFFFFFFFFull;
+  const size_t fullCollisions  = countCollisions(all);
+  const size_t firstCollisions = countCollisions(first);
+  const size_t low32Collisions = countCollisions(low32);
+  const double expected32      = (double)stateCount * (double)(stateCount - 1) / 2.0 / 4294967296.0;
+
+  sink = sink + checksum;
+
+  printf("%-14s %10lu %10.2f %10.2f %10lu %10lu %10lu %12.1f\n", Hasher::name, stateSize, gigabytes / singleSeconds, gigabytes / batchSeconds, fullCollisions,
+         firstCollisions, low32Collisions, expected32);
+}
+
+int main(int argc, char* argv[])
+{
+  argparse::ArgumentParser program("bhash", "1.0");
+  program.add_description("Compares the throughput and collision statistics of the available hashing backends");
+  program.add_argument("--stateSizes").help("Comma-separated state sizes (bytes) to test").default_value(std::string("4096,65536,524288"));
+  program.add_argument("--stateCount").help("Number of distinct states hashed for the collision statistics").default_value(size_t(1000000)).scan<'u', size_t>();
+  program.add_argument("--totalBytes").help("Number of bytes hashed per throughput measurement").default_value(size_t(4000000000)).scan<'u', size_t>();
+
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error& err)
+  {
+    fprintf(stderr, "%s\n%s", err.what(), program.help().str().c_str());
+    return -1;
+  }
+
+  const auto stateSizes = string::split(program.get<std::string>("--stateSizes"), ',');
+  const auto stateCount = program.get<size_t>("--stateCount");
+  const auto totalBytes = program.get<size_t>("--totalBytes");
+
+  printf("%-14s %10s %10s %10s %10s %10s %10s %12s\n", "Backend", "Size (B)", "GB/s", "Batch GB/s", "Coll. 128b", "Coll. 64b", "Coll. 32b", "Expected 32b");
+  for (const auto& sizeString : stateSizes)
+  {
+    const size_t stateSize = std::stoul(sizeString);
+    if (stateSize < 8)
+    {
+      fprintf(stderr, "State size must be at least 8 bytes\n");
+      return -1;
+    }
+
+    // Base state with realistic structure: mostly zeroes with scattered random bytes
+    std::mt19937_64      rng(0);
+    std::vector<uint8_t> base(stateSize, 0);
+    for (size_t i = 0; i < stateSize; i += 1 + rng() % 16) base[i] = (uint8_t)rng();
+
+    benchmarkBackend<MetroHash128Hasher>(stateSize, stateCount, totalBytes, base);
+    benchmarkBackend<CRC32CHasher>(stateSize, stateCount, totalBytes, base);
+    benchmarkBackend<XXH3StyleHasher>(stateSize, stateCount, totalBytes, base);
+  }
+
+  return 0;
+}
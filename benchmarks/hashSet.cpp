@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <argparse/argparse.hpp>
+#include <atomic>
+#include <jaffarCommon/concurrent.hpp>
+#include <jaffarCommon/parallel.hpp>
+#include <jaffarCommon/string.hpp>
+#include <jaffarCommon/timing.hpp>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace jaffarCommon;
+using namespace jaffarCommon::hash;
+
+// Runs the insert and lookup phases on a set, returning the throughput of each (millions of operations per second)
+template <class Set>
+void runPhases(Set& set, const std::vector<hash_t>& keys, const size_t threadCount, double& insertRate, double& lookupRate, size_t& inserted)
+{
+  std::atomic<size_t> insertedCount = 0;
+  std::atomic<size_t> foundCount    = 0;
+  parallel::setThreadCount(threadCount);
+
+  auto t0 = timing::now();
+  JAFFAR_PARALLEL
+  {
+    size_t localInserted = 0;
+    JAFFAR_FOR
+    for (size_t i = 0; i < keys.size(); i++) localInserted += set.insert(keys[i]) ? 1 : 0;
+    insertedCount += localInserted;
+  }
+  const double insertSeconds = timing::timeDeltaSeconds(timing::now(), t0);
+
+  t0 = timing::now();
+  JAFFAR_PARALLEL
+  {
+    size_t localFound = 0;
+    JAFFAR_FOR
+    for (size_t i = 0; i < keys.size(); i++) localFound += set.contains(keys[i]) ? 1 : 0;
+    foundCount += localFound;
+  }
+  const double lookupSeconds = timing::timeDeltaSeconds(timing::now(), t0);
+
+  if (foundCount != keys.size()) fprintf(stderr, "Lookup mismatch: found %lu of %lu keys\n", foundCount.load(), keys.size());
+
+  insertRate = (double)keys.size() / insertSeconds * 1.0e-6;
+  lookupRate = (double)keys.size() / lookupSeconds * 1.0e-6;
+  inserted   = insertedCount;
+}
+
+// HashSet_t's insert returns an (iterator, inserted) pair; this adapts it to the interface used above
+struct phmapSet
+{
+  concurrent::HashSet_t<hash_t> set;
+  bool                          insert(const hash_t& key) { return set.insert(key).second; }
+  bool                          contains(const hash_t& key) const { return set.contains(key); }
+};
+
+int main(int argc, char* argv[])
+{
+  argparse::ArgumentParser program("bhashSet", "1.0");
+  program.add_description("Compares the concurrent insert/lookup throughput of concurrent::HashSet against concurrent::HashSet_t, and the lookup throughput of the frozen index");
+  program.add_argument("--threads").help("Comma-separated thread counts to test").default_value(std::string("1,2,4,8,16,32,64,128"));
+  program.add_argument("--keyCount").help("Number of insert operations per run").default_value(size_t(8000000)).scan<'u', size_t>();
+  program.add_argument("--duplicateRatio").help("Percentage of inserts that repeat an earlier key").default_value(size_t(50)).scan<'u', size_t>();
+
+  try
+  {
+    program.parse_args(argc, argv);
+  }
+  catch (const std::runtime_error& err)
+  {
+    fprintf(stderr, "%s\n%s", err.what(), program.help().str().c_str());
+    return -1;
+  }
+
+  const auto threadCounts   = string::split(program.get<std::string>("--threads"), ',');
+  const auto keyCount       = program.get<size_t>("--keyCount");
+  const auto duplicateRatio = program.get<size_t>("--duplicateRatio");
+
+  // Random state hashes, with the requested share of repeated keys (as new states often turn out to be already seen)
+  std::mt19937_64     rng(0);
+  std::vector<hash_t> keys(keyCount);
+  for (size_t i = 0; i < keyCount; i++) keys[i] = (i > 0 && rng() % 100 < duplicateRatio) ? keys[rng() % i] : hash_t(rng(), rng());
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  printf("%8s %20s %20s %20s %20s %20s %20s %12s\n", "Threads", "HashSet_t ins Mop/s", "HashSet ins Mop/s", "HashSet_t get Mop/s", "HashSet get Mop/s", "Frozen get Mop/s",
+         "Frozen batch Mop/s", "Freeze (s)");
+  for (const auto& threadString : threadCounts)
+  {
+    const size_t threadCount = std::stoul(threadString);
+
+    double phmapInsert, phmapLookup, lockFreeInsert, lockFreeLookup;
+    size_t phmapInserted, lockFreeInserted;
+
+    phmapSet phmap;
+    runPhases(phmap, keys, threadCount, phmapInsert, phmapLookup, phmapInserted);
+
+    concurrent::HashSet lockFree(2 * keyCount);
+    runPhases(lockFree, keys, threadCount, lockFreeInsert, lockFreeLookup, lockFreeInserted);
+
+    if (phmapInserted != lockFreeInserted) fprintf(stderr, "Insert count mismatch: %lu vs %lu\n", phmapInserted, lockFreeInserted);
+
+    // Freezing the populated set and measuring lookups on the resulting read-only index
+    auto         t0            = timing::now();
+    const auto   frozen        = concurrent::freeze(phmap.set);
+    const double freezeSeconds = timing::timeDeltaSeconds(timing::now(), t0);
+
+    std::atomic<size_t> foundCount = 0;
+    t0                             = timing::now();
+    JAFFAR_PARALLEL
+    {
+      size_t localFound = 0;
+      JAFFAR_FOR
+      for (size_t i = 0; i < keys.size(); i++) localFound += frozen->contains(keys[i]) ? 1 : 0;
+      foundCount += localFound;
+    }
+    const double frozenLookup = (double)keys.size() / timing::timeDeltaSeconds(timing::now(), t0) * 1.0e-6;
+    if (foundCount != keys.size()) fprintf(stderr, "Frozen lookup mismatch: found %lu of %lu keys\n", foundCount.load(), keys.size());
+
+    const size_t batchSize = 256;
+    foundCount             = 0;
+    t0                     = timing::now();
+    JAFFAR_PARALLEL
+    {
+      bool   results[batchSize];
+      size_t localFound = 0;
+      JAFFAR_FOR
+      for (size_t i = 0; i < keys.size(); i += batchSize)
+      {
+        const size_t count = std::min(batchSize, keys.size() - i);
+        frozen->containsBatch(&keys[i], count, results);
+        for (size_t j = 0; j < count; j++) localFound += results[j] ? 1 : 0;
+      }
+      foundCount += localFound;
+    }
+    const double frozenBatchLookup = (double)keys.size() / timing::timeDeltaSeconds(timing::now(), t0) * 1.0e-6;
+    if (foundCount != keys.size()) fprintf(stderr, "Frozen batch lookup mismatch: found %lu of %lu keys\n", foundCount.load(), keys.size());
+
+    printf("%8lu %20.2f %20.2f %20.2f %20.2f %20.2f %20.2f %12.3f\n", threadCount, phmapInsert, lockFreeInsert, phmapLookup, lockFreeLookup, frozenLookup, frozenBatchLookup,
+           freezeSeconds);
+  }
+
+  return 0;
+}
\ No newline at end of file
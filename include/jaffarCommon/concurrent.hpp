@@ -5,16 +5,26 @@
  * @brief Containers designed for fast parallel, mutual exclusive access
  */
 
+#include "exceptions.hpp"
+#include "hash.hpp"
+#include "parallel.hpp"
+#include "timing.hpp"
+#include <algorithm>
 #include <atomic>
 #include <atomic_queue/include/atomic_queue/atomic_queue.h>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <oneapi/tbb/concurrent_map.h>
 #include <phmap/parallel_hashmap/phmap.h>
 #include <stddef.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace jaffarCommon
 {
@@ -22,6 +32,63 @@ namespace jaffarCommon
 namespace concurrent
 {
 
+/**
+ * The shared step of the ordered concurrent fills of the drain buffers
+ *
+ * Every thread of a parallel region gets the output position of its elements as the prefix sum of the element counts
+ * of the threads before it, after what the buffer already holds. The master thread then commits the new fill count,
+ * but only if the whole fill fits in the capacity. Otherwise nothing is committed, and every thread learns it from the
+ * returned flag, so that no exception has to leave the parallel region between its barriers.
+ */
+class OrderedFill
+{
+public:
+  /**
+   * Computes the calling thread's output position and commits the new fill count, if the fill fits
+   *
+   * @param[in,out] fillCount The fill count of the buffer, advanced by the total count of the fill if it fits
+   * @param[in] capacity The capacity of the buffer
+   * @param[in] count The number of elements of the calling thread
+   * @param[out] position The output position of the calling thread's elements
+   * @return Whether the fill fits; if not, the fill count is left untouched
+   *
+   * @note This is a collective call: every thread of the enclosing parallel region must make it (it contains barriers).
+   *       The threads must also pass a barrier after copying their elements, before the next call.
+   */
+  __JAFFAR_COMMON_INLINE__ bool claim(std::atomic<size_t>& fillCount, const size_t capacity, const size_t count, size_t& position)
+  {
+    const size_t threadId = parallel::getThreadId();
+    JAFFAR_MASTER { _offsets.assign(parallel::getThreadCount() + 1, 0); }
+    JAFFAR_BARRIER
+
+    _offsets[threadId + 1] = count;
+    JAFFAR_BARRIER
+
+    JAFFAR_MASTER
+    {
+      _offsets[0] = fillCount.load(std::memory_order_relaxed);
+      for (size_t t = 0; t + 1 < _offsets.size(); t++) _offsets[t + 1] += _offsets[t];
+      _fits = _offsets.back() <= capacity;
+      if (_fits == true) fillCount.store(_offsets.back(), std::memory_order_relaxed);
+    }
+    JAFFAR_BARRIER
+
+    position = _offsets[threadId];
+    return _fits;
+  }
+
+private:
+  /**
+   * Per-thread output offsets of the current fill
+   */
+  std::vector<size_t> _offsets;
+
+  /**
+   * Whether the current fill fits in the capacity
+   */
+  bool _fits = false;
+};
+
 /**
  * A fixed-capacity buffer specialized for a fill-once / drain-from-both-ends lifecycle, with a
  * lock-free concurrent drain phase.
@@ -39,6 +106,11 @@ namespace concurrent
  * a back claim can never alias the same slot. Indices only grow within a step and are reset
  * (clear()) only while the buffer is quiescent, so there is no ABA hazard.
  *
+ * The fill may also be done by many threads at once: reserveRange/push_back_batch claim contiguous ranges with a
+ * single CAS (in arbitrary order), and push_back_ordered places every thread's elements at an offset given by a
+ * prefix sum over the threads' counts (in thread order, deterministic). A barrier must still separate fill and drain.
+ * A concurrent fill that does not fit in the capacity appends nothing.
+ *
  * @note Capacity is fixed at reserve() time; the fill phase must not exceed it. Capacity is limited
  *       to UINT32_MAX elements (the claim counters are 32-bit halves).
  */
@@ -64,11 +136,11 @@ public:
 
   /**
    * Resets the buffer to empty for a new fill phase. Must be called while quiescent (no concurrent
-   * drain in flight), e.g. right before the single-threaded fill of the next step.
+   * drain in flight), e.g. right before the fill of the next step.
    */
   __JAFFAR_COMMON_INLINE__ void clear()
   {
-    _count = 0;
+    _count.store(0, std::memory_order_relaxed);
     _claim.store(0, std::memory_order_relaxed);
   }
 
@@ -80,7 +152,66 @@ public:
    * @note Not thread safe -- intended to be called by a single filler thread between clear() and
    *       the start of the concurrent drain.
    */
-  __JAFFAR_COMMON_INLINE__ void push_back_no_lock(T element) { _buffer[_count++] = element; }
+  __JAFFAR_COMMON_INLINE__ void push_back_no_lock(T element)
+  {
+    const size_t count = _count.load(std::memory_order_relaxed);
+    _buffer[count]     = element;
+    _count.store(count + 1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Reserves a contiguous range at the end of the buffer during a concurrent fill phase, with a single CAS. The
+   * caller then writes the range without any synchronization.
+   *
+   * @param[in] count The number of elements to reserve
+   * @return A pointer to the first element of the range
+   *
+   * @note Thread safe with respect to other reservations and push_back_batch, but not to push_back_no_lock. Ranges
+   *       from different threads end up in an arbitrary order; use push_back_ordered for a deterministic one. A range
+   *       that does not fit in the capacity throws, leaving the buffer as it was.
+   */
+  __JAFFAR_COMMON_INLINE__ T* reserveRange(const size_t count)
+  {
+    size_t begin = _count.load(std::memory_order_relaxed);
+    do {
+      if (begin + count > _capacity) JAFFAR_THROW_RUNTIME("Drain buffer capacity (%lu) exceeded by a fill of %lu elements at position %lu", _capacity, count, begin);
+    } while (_count.compare_exchange_weak(begin, begin + count, std::memory_order_relaxed, std::memory_order_relaxed) == false);
+    return &_buffer[begin];
+  }
+
+  /**
+   * Appends elements during a concurrent fill phase, as a single contiguous range
+   *
+   * @param[in] elements The elements to append
+   * @param[in] count The number of elements
+   *
+   * @note Same thread safety as reserveRange
+   */
+  __JAFFAR_COMMON_INLINE__ void push_back_batch(const T* elements, const size_t count)
+  {
+    if (count > 0) memcpy(reserveRange(count), elements, count * sizeof(T));
+  }
+
+  /**
+   * Appends every thread's elements in thread order, all threads copying at the same time. Each thread's offset is the
+   * prefix sum of the counts of the threads before it, so the result is the same as if the threads appended one after
+   * the other.
+   *
+   * @param[in] elements The calling thread's elements
+   * @param[in] count The number of elements of the calling thread
+   * @return True, if the fill fit in the capacity; false, if it did not, in which case nothing was appended
+   *
+   * @note This is a collective call: every thread of the enclosing parallel region must make it (it contains barriers).
+   *       All threads get the same result.
+   */
+  __JAFFAR_COMMON_INLINE__ bool push_back_ordered(const T* elements, const size_t count)
+  {
+    size_t     position;
+    const bool fits = _orderedFill.claim(_count, _capacity, count, position);
+    if (fits == true && count > 0) memcpy(&_buffer[position], elements, count * sizeof(T));
+    JAFFAR_BARRIER
+    return fits;
+  }
 
   /**
    * Claims up to maxCount elements from the front in a single lock-free step, copying them into the
@@ -92,15 +223,16 @@ public:
    */
   __JAFFAR_COMMON_INLINE__ size_t pop_front_get_batch(T* elements, const size_t maxCount)
   {
-    uint64_t observed = _claim.load(std::memory_order_acquire);
-    uint64_t desired;
-    uint32_t front;
-    size_t   take;
+    const size_t filled   = _count.load(std::memory_order_relaxed);
+    uint64_t     observed = _claim.load(std::memory_order_acquire);
+    uint64_t     desired;
+    uint32_t     front;
+    size_t       take;
     do {
       front               = (uint32_t)(observed & 0xFFFFFFFFULL);
       const uint32_t back = (uint32_t)(observed >> 32);
-      if ((size_t)front + (size_t)back >= _count) return 0; // empty
-      const size_t available = _count - (size_t)front - (size_t)back;
+      if ((size_t)front + (size_t)back >= filled) return 0; // empty
+      const size_t available = filled - (size_t)front - (size_t)back;
       take                   = maxCount < available ? maxCount : available;
       desired                = (observed & 0xFFFFFFFF00000000ULL) | (uint64_t)(front + (uint32_t)take);
     } while (_claim.compare_exchange_weak(observed, desired, std::memory_order_acq_rel, std::memory_order_acquire) == false);
@@ -123,17 +255,18 @@ public:
    */
   __JAFFAR_COMMON_INLINE__ bool pop_back_get(T& element)
   {
-    uint64_t observed = _claim.load(std::memory_order_acquire);
-    uint64_t desired;
-    uint32_t back;
+    const size_t filled   = _count.load(std::memory_order_relaxed);
+    uint64_t     observed = _claim.load(std::memory_order_acquire);
+    uint64_t     desired;
+    uint32_t     back;
     do {
       const uint32_t front = (uint32_t)(observed & 0xFFFFFFFFULL);
       back                 = (uint32_t)(observed >> 32);
-      if ((size_t)front + (size_t)back >= _count) return false; // empty
+      if ((size_t)front + (size_t)back >= filled) return false; // empty
       desired = (observed & 0x00000000FFFFFFFFULL) | ((uint64_t)(back + 1) << 32);
     } while (_claim.compare_exchange_weak(observed, desired, std::memory_order_acq_rel, std::memory_order_acquire) == false);
 
-    element = _buffer[_count - 1 - (size_t)back];
+    element = _buffer[filled - 1 - (size_t)back];
     return true;
   }
 
@@ -144,9 +277,10 @@ public:
    */
   __JAFFAR_COMMON_INLINE__ size_t wasSize() const
   {
+    const size_t   filled   = _count.load(std::memory_order_relaxed);
     const uint64_t observed = _claim.load(std::memory_order_relaxed);
     const size_t   claimed  = (size_t)(observed & 0xFFFFFFFFULL) + (size_t)(observed >> 32);
-    return claimed >= _count ? 0 : _count - claimed;
+    return claimed >= filled ? 0 : filled - claimed;
   }
 
 private:
@@ -161,9 +295,14 @@ private:
   size_t _capacity = 0;
 
   /**
-   * Number of elements filled in the current phase (written single-threaded during fill)
+   * Number of elements filled in the current phase (advanced with a CAS by concurrent fills)
    */
-  size_t _count = 0;
+  std::atomic<size_t> _count = 0;
+
+  /**
+   * Output positions of the current push_back_ordered call
+   */
+  OrderedFill _orderedFill;
 
   /**
    * Packed claim counters: low 32 bits = elements claimed from the front, high 32 bits = elements
@@ -173,258 +312,4532 @@ private:
 };
 
 /**
- * Definition for an atomic queue. It enables lock-free concurrent push and pop operations.
- */
-template <class T>
-using atomicQueue_t = atomic_queue::AtomicQueueB<T>;
-
-/**
- * Definition for a parallel hash set. It enables concurrent inserts and queries
- */
-template <class V>
-using HashSet_t = phmap::parallel_flat_hash_set<V, phmap::priv::hash_default_hash<V>, phmap::priv::hash_default_eq<V>, std::allocator<V>, 8, std::mutex>;
-
-/**
- * Definition for a parallel hash map. It enables concurrent inserts and queries
- */
-template <class K, class V>
-using HashMap_t = phmap::parallel_flat_hash_map<K, V, phmap::priv::hash_default_hash<K>, phmap::priv::hash_default_eq<K>, std::allocator<std::pair<const K, V>>, 8, std::mutex>;
-
-/**
- * Definition for a concurrent multimap. It enables concurrent inserts and queries
- */
-template <class K, class V, class C = std::greater<K>>
-using concurrentMultimap_t = oneapi::tbb::concurrent_multimap<K, V, C>;
-
-/**
- * This implementation of a concurrent doble-ended queue class was created specifically for Jaffar's engine
- * It allows for lock-free front and back push, pop, and pop_get operations
- * It uses a single mutex to coordinate access. This could theoretically be improved, but for the time being seems to suffice
+ * A DrainBuffer that grows as it is filled, instead of having its capacity fixed by reserve()
+ *
+ * The elements live in fixed-size segments of 2^SegmentBits elements, found through a directory indexed by the
+ * position's upper bits, so a fill only allocates the segments it reaches and no worst-case capacity has to be
+ * reserved up front. Segments released by clear() go to a pool and are reused by the next fills, so a steady search
+ * stops allocating after its largest step; trimPool() gives the excess back when steps get smaller.
+ *
+ * The lifecycle and the lock-free drain are those of DrainBuffer: a fill phase (single-threaded, or concurrent with
+ * push_back_batch and push_back_ordered), a barrier, and a drain from both ends, claimed with a single CAS on the
+ * same packed front/back counters. A batch may span two or more segments, in which case it is copied piece by piece.
+ *
+ * @note Capacity is limited to UINT32_MAX elements (the claim counters are 32-bit halves).
  */
-template <class T>
-class Deque
+template <class T, size_t SegmentBits = 16>
+class SegmentedDrainBuffer
 {
 public:
-  Deque()  = default;
-  ~Deque() = default;
+  SegmentedDrainBuffer()
+  {
+    // Zeroed pages are only mapped in when touched, so the directory's footprint follows the number of segments used
+    _segments = (T**)calloc(_maxSegmentCount, sizeof(T*));
+    if (_segments == nullptr) JAFFAR_THROW_RUNTIME("Could not allocate the segment directory (%lu entries)", _maxSegmentCount);
+  }
+
+  ~SegmentedDrainBuffer()
+  {
+    clear();
+    trimPool(0);
+    free(_segments);
+  }
+
+  SegmentedDrainBuffer(const SegmentedDrainBuffer&)            = delete;
+  SegmentedDrainBuffer& operator=(const SegmentedDrainBuffer&) = delete;
 
   /**
-   * Gets access to the internal Deque storage
-   * @return A reference to the internal Deque storage
+   * Resets the buffer to empty for a new fill phase, returning its segments to the pool. Must be called while
+   * quiescent (no concurrent fill or drain in flight)
    */
-  __JAFFAR_COMMON_INLINE__ auto& getInternalStorage() { return _internalDeque; }
+  __JAFFAR_COMMON_INLINE__ void clear()
+  {
+    const size_t segmentCount = std::min(getSegmentCount(), _maxSegmentCount);
+    for (size_t s = 0; s < segmentCount; s++)
+      if (_segments[s] != nullptr)
+      {
+        _pool.push_back(_segments[s]);
+        _segments[s] = nullptr;
+      }
+    _count.store(0, std::memory_order_relaxed);
+    _claim.store(0, std::memory_order_relaxed);
+  }
 
   /**
-   * Pushes an element to the back of the deque without any locking protection
-   *
-   * @note This is not a thread safe operation
+   * Frees pooled segments beyond a given number. Must be called while quiescent
    *
-   * @param[in] element The input element to push
+   * @param[in] maxPooledSegments The number of segments to keep for later fills
    */
-  __JAFFAR_COMMON_INLINE__ void push_back_no_lock(T element)
+  __JAFFAR_COMMON_INLINE__ void trimPool(const size_t maxPooledSegments)
   {
-    _internalDeque.push_back(element);
-    _size.fetch_add(1, std::memory_order_relaxed);
+    while (_pool.size() > maxPooledSegments)
+    {
+      free(_pool.back());
+      _pool.pop_back();
+    }
   }
 
   /**
-   * Pushes an element to the back of the deque with locking protection
+   * Appends an element during the (single-threaded) fill phase
    *
-   * @note This is a thread safe operation
+   * @param[in] element The element to append to the buffer
    *
-   * @param[in] element The input element to push
+   * @note Not thread safe -- intended to be called by a single filler thread between clear() and the start of the
+   *       concurrent drain.
    */
-  __JAFFAR_COMMON_INLINE__ void push_back(T element)
+  __JAFFAR_COMMON_INLINE__ void push_back_no_lock(T element)
   {
-    _mutex.lock();
-    _internalDeque.push_back(element);
-    _size.fetch_add(1, std::memory_order_relaxed);
-    _mutex.unlock();
+    const size_t count = _count.load(std::memory_order_relaxed);
+    if (count == _maxElementCount) JAFFAR_THROW_RUNTIME("Segmented drain buffer capacity (%lu) exceeded", _maxElementCount);
+    getSegment(count >> SegmentBits)[count & _segmentMask] = element;
+    _count.store(count + 1, std::memory_order_relaxed);
   }
 
   /**
-   * Pushes an element to the front of the deque without any locking protection
+   * Appends elements during a concurrent fill phase, as a single contiguous range claimed with one CAS
    *
-   * @note This is not a thread safe operation
+   * @param[in] elements The elements to append
+   * @param[in] count The number of elements
    *
-   * @param[in] element The input element to push
+   * @note Thread safe with respect to other push_back_batch calls, but not to push_back_no_lock. Ranges from different
+   *       threads end up in an arbitrary order; use push_back_ordered for a deterministic one. A range that does not fit
+   *       in the capacity throws, leaving the buffer as it was.
    */
-  __JAFFAR_COMMON_INLINE__ void push_front_no_lock(T element)
+  __JAFFAR_COMMON_INLINE__ void push_back_batch(const T* elements, const size_t count)
   {
-    _internalDeque.push_front(element);
-    _size.fetch_add(1, std::memory_order_relaxed);
+    size_t begin = _count.load(std::memory_order_relaxed);
+    do {
+      if (begin + count > _maxElementCount)
+        JAFFAR_THROW_RUNTIME("Segmented drain buffer capacity (%lu) exceeded by a fill of %lu elements at position %lu", _maxElementCount, count, begin);
+    } while (_count.compare_exchange_weak(begin, begin + count, std::memory_order_relaxed, std::memory_order_relaxed) == false);
+    copyIn(begin, elements, count);
   }
 
   /**
-   * Pushes an element to the front of the deque with locking protection
+   * Appends every thread's elements in thread order, all threads copying at the same time. Each thread's offset is the
+   * prefix sum of the counts of the threads before it.
    *
-   * @note This is a thread safe operation
+   * @param[in] elements The calling thread's elements
+   * @param[in] count The number of elements of the calling thread
+   * @return True, if the fill fit in the capacity; false, if it did not, in which case nothing was appended
    *
-   * @param[in] element The input element to push
+   * @note This is a collective call: every thread of the enclosing parallel region must make it (it contains barriers).
+   *       All threads get the same result.
    */
-  __JAFFAR_COMMON_INLINE__ void push_front(T element)
+  __JAFFAR_COMMON_INLINE__ bool push_back_ordered(const T* elements, const size_t count)
   {
-    _mutex.lock();
-    _internalDeque.push_front(element);
-    _size.fetch_add(1, std::memory_order_relaxed);
-    _mutex.unlock();
+    size_t     position;
+    const bool fits = _orderedFill.claim(_count, _maxElementCount, count, position);
+    if (fits == true) copyIn(position, elements, count);
+    JAFFAR_BARRIER
+    return fits;
   }
 
   /**
-   * Gets the element at the front of the Deque
-   *
-   * @note This is not a thread safe operation
-   * @note This operation does not check for an empty container and might produce unexpected behaviour if ran with an empty container
+   * Claims up to maxCount elements from the front in a single lock-free step, copying them into the
+   * provided buffer in front-to-back order.
    *
-   * @return The element at the front of the Deque
+   * @param[out] elements Destination buffer; room for at least maxCount elements
+   * @param[in] maxCount Maximum number of elements to claim
+   * @return The number of elements actually claimed (0 if empty)
    */
-  __JAFFAR_COMMON_INLINE__ T front() const { return _internalDeque.front(); }
+  __JAFFAR_COMMON_INLINE__ size_t pop_front_get_batch(T* elements, const size_t maxCount)
+  {
+    const size_t filled   = _count.load(std::memory_order_relaxed);
+    uint64_t     observed = _claim.load(std::memory_order_acquire);
+    uint64_t     desired;
+    uint32_t     front;
+    size_t       take;
+    do {
+      front               = (uint32_t)(observed & 0xFFFFFFFFULL);
+      const uint32_t back = (uint32_t)(observed >> 32);
+      if ((size_t)front + (size_t)back >= filled) return 0; // empty
+      const size_t available = filled - (size_t)front - (size_t)back;
+      take                   = maxCount < available ? maxCount : available;
+      desired                = (observed & 0xFFFFFFFF00000000ULL) | (uint64_t)(front + (uint32_t)take);
+    } while (_claim.compare_exchange_weak(observed, desired, std::memory_order_acq_rel, std::memory_order_acquire) == false);
+
+    // Copying segment by segment
+    for (size_t copied = 0; copied < take;)
+    {
+      const size_t position = front + copied;
+      const size_t offset   = position & _segmentMask;
+      const size_t pieceLen = std::min(take - copied, _segmentSize - offset);
+      memcpy(&elements[copied], &_segments[position >> SegmentBits][offset], pieceLen * sizeof(T));
+      copied += pieceLen;
+    }
+    return take;
+  }
 
   /**
-   * Gets the element at the back of the Deque
-   *
-   * @note This is not a thread safe operation
-   * @note This operation does not check for an empty container and might produce unexpected behaviour if ran with an empty container
-   *
-   * @return The element at the back of the Deque
+   * Claims a single element from the front. Lock-free.
+   * @param[out] element Storage for the claimed element
+   * @return True if an element was claimed; false if empty
    */
-  __JAFFAR_COMMON_INLINE__ T back() const { return _internalDeque.back(); }
+  __JAFFAR_COMMON_INLINE__ bool pop_front_get(T& element) { return pop_front_get_batch(&element, 1) == 1; }
 
   /**
-   * Pops (removes) the element at the front of the Deque
-   *
-   * @note This is a thread safe operation
-   * @note This operation does not check for an empty container and might produce unexpected behaviour if ran with an empty container
+   * Claims a single element from the back. Lock-free.
+   * @param[out] element Storage for the claimed element
+   * @return True if an element was claimed; false if empty
    */
-  __JAFFAR_COMMON_INLINE__ void pop_front()
+  __JAFFAR_COMMON_INLINE__ bool pop_back_get(T& element)
   {
-    _mutex.lock();
-    _internalDeque.pop_front();
-    _size.fetch_sub(1, std::memory_order_relaxed);
-    _mutex.unlock();
+    const size_t filled   = _count.load(std::memory_order_relaxed);
+    uint64_t     observed = _claim.load(std::memory_order_acquire);
+    uint64_t     desired;
+    uint32_t     back;
+    do {
+      const uint32_t front = (uint32_t)(observed & 0xFFFFFFFFULL);
+      back                 = (uint32_t)(observed >> 32);
+      if ((size_t)front + (size_t)back >= filled) return false; // empty
+      desired = (observed & 0x00000000FFFFFFFFULL) | ((uint64_t)(back + 1) << 32);
+    } while (_claim.compare_exchange_weak(observed, desired, std::memory_order_acq_rel, std::memory_order_acquire) == false);
+
+    const size_t position = filled - 1 - (size_t)back;
+    element               = _segments[position >> SegmentBits][position & _segmentMask];
+    return true;
   }
 
   /**
-   * Pops (removes) the element at the back of the Deque
+   * Number of elements not yet claimed, at the time of checking. Safe to call concurrently.
    *
-   * @note This is a thread safe operation
-   * @note This operation does not check for an empty container and might produce unexpected behaviour if ran with an empty container
+   * @return The number of elements not yet claimed at the moment of the call
    */
-  __JAFFAR_COMMON_INLINE__ void pop_back()
+  __JAFFAR_COMMON_INLINE__ size_t wasSize() const
   {
-    _mutex.lock();
-    _internalDeque.pop_back();
-    _size.fetch_sub(1, std::memory_order_relaxed);
-    _mutex.unlock();
+    const size_t   filled   = _count.load(std::memory_order_relaxed);
+    const uint64_t observed = _claim.load(std::memory_order_relaxed);
+    const size_t   claimed  = (size_t)(observed & 0xFFFFFFFFULL) + (size_t)(observed >> 32);
+    return claimed >= filled ? 0 : filled - claimed;
   }
 
   /**
-   * Pops (removes) the element at the back of the Deque and retrieves it
+   * Gets the number of segments in use by the current fill
    *
-   * @note This is a thread safe operation
-   * @param[out] element A reference to the storage to save the element into
-   * @return True, if the operation was successful; false, if the Deque was empty
+   * @return The segment count
    */
-  __JAFFAR_COMMON_INLINE__ bool pop_back_get(T& element)
-  {
-    _mutex.lock();
+  __JAFFAR_COMMON_INLINE__ size_t getSegmentCount() const { return (_count.load(std::memory_order_relaxed) + _segmentSize - 1) >> SegmentBits; }
 
-    if (_internalDeque.empty())
-    {
-      _mutex.unlock();
-      return false;
-    }
+  /**
+   * Gets the number of segments kept in the pool for later fills
+   *
+   * @return The pooled segment count
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getPooledSegmentCount() const { return _pool.size(); }
 
-    element = _internalDeque.back();
-    _internalDeque.pop_back();
-    _size.fetch_sub(1, std::memory_order_relaxed);
+  /**
+   * Gets the number of elements per segment
+   *
+   * @return The segment size
+   */
+  static constexpr size_t getSegmentSize() { return _segmentSize; }
 
-    _mutex.unlock();
-    return true;
-  }
+private:
+  static constexpr size_t _segmentSize     = (size_t)1 << SegmentBits;
+  static constexpr size_t _segmentMask     = _segmentSize - 1;
+  static constexpr size_t _maxElementCount = UINT32_MAX;
+  static constexpr size_t _maxSegmentCount = (_maxElementCount + _segmentSize - 1) >> SegmentBits;
+
+  static_assert(SegmentBits >= 8 && SegmentBits < 32, "The segment size must be between 2^8 and 2^31 elements");
 
   /**
-   * Pops (removes) the element at the front of the Deque and retrieves it
+   * Gets a segment, installing one (from the pool, if possible) if it is not there yet. Concurrent fills that reach a
+   * new segment at the same time race to install theirs; the losers give them back to the pool
    *
-   * @note This is a thread safe operation
-   * @param[out] element A reference to the storage to save the element into
-   * @return True, if the operation was successful; false, if the Deque was empty
+   * @param[in] index The segment index
+   * @return The segment
    */
-  __JAFFAR_COMMON_INLINE__ bool pop_front_get(T& element)
+  __JAFFAR_COMMON_INLINE__ T* getSegment(const size_t index)
   {
-    _mutex.lock();
+    std::atomic_ref<T*> slot(_segments[index]);
+    T*                  segment = slot.load(std::memory_order_acquire);
+    if (segment != nullptr) return segment;
 
-    if (_internalDeque.empty())
+    T* fresh = nullptr;
     {
-      _mutex.unlock();
-      return false;
+      std::lock_guard<std::mutex> lock(_poolMutex);
+      if (_pool.empty() == false)
+      {
+        fresh = _pool.back();
+        _pool.pop_back();
+      }
     }
+    if (fresh == nullptr) fresh = (T*)malloc(_segmentSize * sizeof(T));
+    if (fresh == nullptr) JAFFAR_THROW_RUNTIME("Could not allocate a drain buffer segment of %lu bytes", _segmentSize * sizeof(T));
 
-    element = _internalDeque.front();
-    _internalDeque.pop_front();
-    _size.fetch_sub(1, std::memory_order_relaxed);
+    if (slot.compare_exchange_strong(segment, fresh, std::memory_order_acq_rel, std::memory_order_acquire) == true) return fresh;
 
-    _mutex.unlock();
-    return true;
+    std::lock_guard<std::mutex> lock(_poolMutex);
+    _pool.push_back(fresh);
+    return segment;
   }
 
   /**
-   * Pops (removes) up to maxCount elements from the front of the Deque under a single lock
-   * acquisition, copying them into the provided buffer in front-to-back order.
-   *
-   * @note This is a thread safe operation.
-   *
-   * Batching amortizes the mutex cost across many elements. Under heavy multi-consumer contention
-   * (dozens of threads each pulling one element at a time, as the Jaffar engine does when the
-   * per-element work is cheap) the lock/unlock pair -- not the pop itself -- dominates wall time.
-   * Grabbing a run of elements per lock cuts lock-acquisition traffic by up to maxCount.
+   * Copies elements into a claimed range, segment by segment
    *
-   * @param[out] elements Destination buffer; must have room for at least maxCount elements
-   * @param[in] maxCount Maximum number of elements to pop
-   * @return The number of elements actually popped (0 if the Deque was empty)
+   * @param[in] position The first position of the range
+   * @param[in] elements The elements
+   * @param[in] count The number of elements
    */
-  __JAFFAR_COMMON_INLINE__ size_t pop_front_get_batch(T* elements, const size_t maxCount)
+  __JAFFAR_COMMON_INLINE__ void copyIn(const size_t position, const T* elements, const size_t count)
   {
-    _mutex.lock();
-
-    size_t count = 0;
+    for (size_t copied = 0; copied < count;)
+    {
+      const size_t offset   = (position + copied) & _segmentMask;
+      const size_t pieceLen = std::min(count - copied, _segmentSize - offset);
+      memcpy(&getSegment((position + copied) >> SegmentBits)[offset], &elements[copied], pieceLen * sizeof(T));
+      copied += pieceLen;
+    }
+  }
+
+  /**
+   * The segment directory, one entry per possible segment (accessed atomically while filling)
+   */
+  T** _segments;
+
+  /**
+   * Segments released by earlier fills, ready for reuse
+   */
+  std::vector<T*> _pool;
+
+  /**
+   * Guards the pool during concurrent fills
+   */
+  std::mutex _poolMutex;
+
+  /**
+   * Number of elements filled in the current phase (advanced with a CAS by concurrent fills)
+   */
+  std::atomic<size_t> _count = 0;
+
+  /**
+   * Output positions of the current push_back_ordered call
+   */
+  OrderedFill _orderedFill;
+
+  /**
+   * Packed claim counters: low 32 bits = elements claimed from the front, high 32 bits = elements
+   * claimed from the back. A single atomic so front/back claims can't race onto the same slot.
+   */
+  std::atomic<uint64_t> _claim{0};
+};
+
+/**
+ * A DrainBuffer with 64-bit claim counters, for fills beyond UINT32_MAX elements
+ *
+ * DrainBuffer packs its front and back claim counters into one 64-bit atomic, so that a single CAS both claims and
+ * checks against the other end. Here the two counters are 64-bit halves of a 128-bit word, claimed with the x86-64
+ * cmpxchg16b instruction when the running CPU supports it (checked once at runtime), so a claim still costs one CAS.
+ * The CAS is seeded with a plain read of the two halves, which may be torn; since both counters only grow, a torn read
+ * can make the buffer look fuller than it is (and the CAS fails and retries), but never emptier.
+ *
+ * Elsewhere, a claim goes in two steps instead:
+ *
+ * - It reserves its element count from a shared budget of unclaimed elements (one CAS, which fails if the budget is
+ *   smaller, taking what is left instead), so the reservations of both ends can never add up to more than the fill.
+ * - It then takes its positions with a fetch_add on its own end's 64-bit counter: fronts grow from the start, backs
+ *   from the end. Since reservations never exceed the fill, the ranges of the two ends never alias.
+ *
+ * The lifecycle and interface are those of DrainBuffer (including the concurrent fills).
+ */
+template <class T>
+class WideDrainBuffer
+{
+public:
+  /**
+   * Constructor for the wide drain buffer
+   *
+   * @param[in] useWideCAS Whether to claim with the 128-bit CAS when the CPU supports it (otherwise, claims always go in two steps)
+   */
+  WideDrainBuffer(const bool useWideCAS = true)
+    : _useWideCAS(useWideCAS && hasWideCAS())
+  {
+  }
+
+  ~WideDrainBuffer()
+  {
+    if (_buffer != nullptr) free(_buffer);
+  }
+
+  WideDrainBuffer(const WideDrainBuffer&)            = delete;
+  WideDrainBuffer& operator=(const WideDrainBuffer&) = delete;
+
+  /**
+   * Allocates the backing storage. Must be called once before use.
+   * @param[in] capacity Maximum number of elements the buffer will ever hold in a single fill phase
+   */
+  __JAFFAR_COMMON_INLINE__ void reserve(const size_t capacity)
+  {
+    if (_buffer != nullptr) free(_buffer);
+    _capacity = capacity;
+    _buffer   = (T*)malloc(capacity * sizeof(T));
+    if (_buffer == nullptr && capacity > 0) JAFFAR_THROW_RUNTIME("Could not allocate a drain buffer of %lu elements", capacity);
+  }
+
+  /**
+   * Resets the buffer to empty for a new fill phase. Must be called while quiescent (no concurrent
+   * drain in flight), e.g. right before the fill of the next step.
+   */
+  __JAFFAR_COMMON_INLINE__ void clear()
+  {
+    _count.store(0, std::memory_order_relaxed);
+    _claim = 0;
+    _front.store(0, std::memory_order_relaxed);
+    _back.store(0, std::memory_order_relaxed);
+    _remaining.store(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * Appends an element during the (single-threaded) fill phase.
+   *
+   * @param[in] element The element to append to the buffer
+   *
+   * @note Not thread safe -- intended to be called by a single filler thread between clear() and
+   *       the start of the concurrent drain.
+   */
+  __JAFFAR_COMMON_INLINE__ void push_back_no_lock(T element)
+  {
+    const size_t count = _count.load(std::memory_order_relaxed);
+    _buffer[count]     = element;
+    _count.store(count + 1, std::memory_order_relaxed);
+    if (_useWideCAS == false) _remaining.store(count + 1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Reserves a contiguous range at the end of the buffer during a concurrent fill phase, with a single CAS. The
+   * caller then writes the range without any synchronization.
+   *
+   * @param[in] count The number of elements to reserve
+   * @return A pointer to the first element of the range
+   *
+   * @note Thread safe with respect to other reservations and push_back_batch, but not to push_back_no_lock. Ranges
+   *       from different threads end up in an arbitrary order; use push_back_ordered for a deterministic one. A range
+   *       that does not fit in the capacity throws, leaving the buffer as it was.
+   */
+  __JAFFAR_COMMON_INLINE__ T* reserveRange(const size_t count)
+  {
+    size_t begin = _count.load(std::memory_order_relaxed);
+    do {
+      if (begin + count > _capacity) JAFFAR_THROW_RUNTIME("Drain buffer capacity (%lu) exceeded by a fill of %lu elements at position %lu", _capacity, count, begin);
+    } while (_count.compare_exchange_weak(begin, begin + count, std::memory_order_relaxed, std::memory_order_relaxed) == false);
+    if (_useWideCAS == false) _remaining.fetch_add(count, std::memory_order_relaxed);
+    return &_buffer[begin];
+  }
+
+  /**
+   * Appends elements during a concurrent fill phase, as a single contiguous range
+   *
+   * @param[in] elements The elements to append
+   * @param[in] count The number of elements
+   *
+   * @note Same thread safety as reserveRange
+   */
+  __JAFFAR_COMMON_INLINE__ void push_back_batch(const T* elements, const size_t count)
+  {
+    if (count > 0) memcpy(reserveRange(count), elements, count * sizeof(T));
+  }
+
+  /**
+   * Appends every thread's elements in thread order, all threads copying at the same time. Each thread's offset is the
+   * prefix sum of the counts of the threads before it.
+   *
+   * @param[in] elements The calling thread's elements
+   * @param[in] count The number of elements of the calling thread
+   * @return True, if the fill fit in the capacity; false, if it did not, in which case nothing was appended
+   *
+   * @note This is a collective call: every thread of the enclosing parallel region must make it (it contains barriers).
+   *       All threads get the same result.
+   */
+  __JAFFAR_COMMON_INLINE__ bool push_back_ordered(const T* elements, const size_t count)
+  {
+    size_t     position;
+    const bool fits = _orderedFill.claim(_count, _capacity, count, position);
+    if (fits == true && count > 0)
+    {
+      memcpy(&_buffer[position], elements, count * sizeof(T));
+      if (_useWideCAS == false) _remaining.fetch_add(count, std::memory_order_relaxed);
+    }
+    JAFFAR_BARRIER
+    return fits;
+  }
+
+  /**
+   * Claims up to maxCount elements from the front in a single lock-free step, copying them into the
+   * provided buffer in front-to-back order.
+   *
+   * @param[out] elements Destination buffer; room for at least maxCount elements
+   * @param[in] maxCount Maximum number of elements to claim
+   * @return The number of elements actually claimed (0 if empty)
+   */
+  __JAFFAR_COMMON_INLINE__ size_t pop_front_get_batch(T* elements, const size_t maxCount)
+  {
+    const size_t filled = _count.load(std::memory_order_relaxed);
+    size_t       front, take;
+
+#if defined(__x86_64__)
+    if (_useWideCAS == true)
+    {
+      claim_t observed = loadClaim();
+      claim_t desired;
+      do {
+        front             = (size_t)observed;
+        const size_t back = (size_t)(observed >> 64);
+        if (front + back >= filled) return 0; // empty
+        const size_t available = filled - front - back;
+        take                   = maxCount < available ? maxCount : available;
+        desired                = observed + take;
+      } while (compareExchangeClaim(observed, desired) == false);
+    }
+    else
+#endif
+    {
+      take = claimBudget(maxCount);
+      if (take == 0) return 0;
+      front = _front.fetch_add(take, std::memory_order_relaxed);
+    }
+
+    memcpy(elements, &_buffer[front], take * sizeof(T));
+    return take;
+  }
+
+  /**
+   * Claims a single element from the front. Lock-free.
+   * @param[out] element Storage for the claimed element
+   * @return True if an element was claimed; false if empty
+   */
+  __JAFFAR_COMMON_INLINE__ bool pop_front_get(T& element) { return pop_front_get_batch(&element, 1) == 1; }
+
+  /**
+   * Claims a single element from the back. Lock-free.
+   * @param[out] element Storage for the claimed element
+   * @return True if an element was claimed; false if empty
+   */
+  __JAFFAR_COMMON_INLINE__ bool pop_back_get(T& element)
+  {
+    const size_t filled = _count.load(std::memory_order_relaxed);
+    size_t       back;
+
+#if defined(__x86_64__)
+    if (_useWideCAS == true)
+    {
+      claim_t observed = loadClaim();
+      claim_t desired;
+      do {
+        const size_t front = (size_t)observed;
+        back               = (size_t)(observed >> 64);
+        if (front + back >= filled) return false; // empty
+        desired = observed + ((claim_t)1 << 64);
+      } while (compareExchangeClaim(observed, desired) == false);
+    }
+    else
+#endif
+    {
+      if (claimBudget(1) == 0) return false;
+      back = _back.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    element = _buffer[filled - 1 - back];
+    return true;
+  }
+
+  /**
+   * Number of elements not yet claimed, at the time of checking. Safe to call concurrently.
+   *
+   * @return The number of elements not yet claimed at the moment of the call
+   */
+  __JAFFAR_COMMON_INLINE__ size_t wasSize() const
+  {
+    if (_useWideCAS == false) return _remaining.load(std::memory_order_relaxed);
+
+    const size_t  filled   = _count.load(std::memory_order_relaxed);
+    const claim_t observed = loadClaim();
+    const size_t  claimed  = (size_t)observed + (size_t)(observed >> 64);
+    return claimed >= filled ? 0 : filled - claimed;
+  }
+
+private:
+  /**
+   * The front (low half) and back (high half) claim counters
+   */
+  using claim_t = unsigned __int128;
+
+  /**
+   * Checks whether the 128-bit CAS is available on the running CPU
+   *
+   * @return True, if cmpxchg16b is supported; false, otherwise
+   */
+  static __JAFFAR_COMMON_INLINE__ bool hasWideCAS()
+  {
+#if defined(__x86_64__)
+    static const bool supported = __builtin_cpu_supports("cmpxchg16b");
+    return supported;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * Whether claims use the 128-bit CAS
+   */
+  const bool _useWideCAS;
+
+  /**
+   * Reads the claim counters, one half at a time (the result may be torn, but never shows fewer claims than there were before the call)
+   *
+   * @return The claim counters
+   */
+  __JAFFAR_COMMON_INLINE__ claim_t loadClaim() const
+  {
+    const uint64_t* halves = (const uint64_t*)&_claim;
+    const uint64_t  front  = std::atomic_ref<uint64_t>(const_cast<uint64_t&>(halves[0])).load(std::memory_order_acquire);
+    const uint64_t  back   = std::atomic_ref<uint64_t>(const_cast<uint64_t&>(halves[1])).load(std::memory_order_acquire);
+    return ((claim_t)back << 64) | front;
+  }
+
+#if defined(__x86_64__)
+  /**
+   * Replaces the claim counters if they hold an expected value, with a single cmpxchg16b
+   *
+   * @param[in,out] expected The expected value; updated with the actual one on failure
+   * @param[in] desired The new value
+   * @return True, if the counters were replaced; false, otherwise
+   */
+  __attribute__((target("cx16"))) __JAFFAR_COMMON_INLINE__ bool compareExchangeClaim(claim_t& expected, const claim_t desired)
+  {
+    const claim_t previous = __sync_val_compare_and_swap(&_claim, expected, desired);
+    const bool    success  = previous == expected;
+    expected               = previous;
+    return success;
+  }
+#endif
+
+  /**
+   * Takes up to maxCount elements from the budget of unclaimed ones
+   *
+   * @param[in] maxCount Maximum number of elements to take
+   * @return The number of elements taken (0 if none was left)
+   */
+  __JAFFAR_COMMON_INLINE__ size_t claimBudget(const size_t maxCount)
+  {
+    size_t observed = _remaining.load(std::memory_order_relaxed);
+    size_t take;
+    do {
+      if (observed == 0) return 0; // empty
+      take = maxCount < observed ? maxCount : observed;
+    } while (_remaining.compare_exchange_weak(observed, observed - take, std::memory_order_relaxed, std::memory_order_relaxed) == false);
+    return take;
+  }
+
+  /**
+   * Contiguous backing storage, allocated once by reserve()
+   */
+  T* _buffer = nullptr;
+
+  /**
+   * Allocated capacity (elements)
+   */
+  size_t _capacity = 0;
+
+  /**
+   * Number of elements filled in the current phase (advanced with a CAS by concurrent fills)
+   */
+  std::atomic<size_t> _count = 0;
+
+  /**
+   * Output positions of the current push_back_ordered call
+   */
+  OrderedFill _orderedFill;
+
+  /**
+   * Front and back claim counters, when the 128-bit CAS is available
+   */
+  alignas(64) claim_t _claim = 0;
+
+  /**
+   * Budget of elements not yet reserved by any claim (when the 128-bit CAS is not available)
+   */
+  alignas(64) std::atomic<size_t> _remaining = 0;
+
+  /**
+   * Elements claimed from the front and from the back, on their own cache lines (when the 128-bit CAS is not available)
+   */
+  alignas(64) std::atomic<size_t> _front = 0;
+  alignas(64) std::atomic<size_t> _back  = 0;
+};
+
+/**
+ * Definition for an atomic queue. It enables lock-free concurrent push and pop operations.
+ */
+template <class T>
+using atomicQueue_t = atomic_queue::AtomicQueueB<T>;
+
+/**
+ * A test-and-test-and-set spinlock, for submaps whose critical sections are too short to be worth putting a thread to sleep
+ *
+ * It satisfies the Lockable requirements, so it can be used as the lock type of HashSet_t and HashMap_t.
+ */
+class SpinLock
+{
+public:
+  SpinLock() = default;
+
+  SpinLock(const SpinLock&)            = delete;
+  SpinLock& operator=(const SpinLock&) = delete;
+
+  /**
+   * Acquires the lock, spinning on a plain load (which keeps the cache line shared) until it looks free
+   */
+  __JAFFAR_COMMON_INLINE__ void lock()
+  {
+    while (_locked.exchange(true, std::memory_order_acquire) == true)
+      while (_locked.load(std::memory_order_relaxed) == true)
+      {
+#if defined(__x86_64__)
+        __builtin_ia32_pause();
+#endif
+      }
+  }
+
+  /**
+   * Tries to acquire the lock without waiting
+   *
+   * @return True, if the lock was acquired; false, otherwise
+   */
+  __JAFFAR_COMMON_INLINE__ bool try_lock() { return _locked.load(std::memory_order_relaxed) == false && _locked.exchange(true, std::memory_order_acquire) == false; }
+
+  /**
+   * Releases the lock
+   */
+  __JAFFAR_COMMON_INLINE__ void unlock() { _locked.store(false, std::memory_order_release); }
+
+private:
+  /**
+   * Whether the lock is held
+   */
+  std::atomic<bool> _locked = false;
+};
+
+/**
+ * A mutex wrapper that counts acquisitions, contended acquisitions and the time spent waiting for the lock
+ *
+ * Used as the lock type of HashSet_t or HashMap_t, every submap gets its own counters (see getSubmapMutex()), so the
+ * number of submaps and the lock type can be chosen from measured contention. An acquisition is contended when an
+ * initial try_lock() fails; only then is the clock read, so uncontended acquisitions stay cheap. The counters are only
+ * modified while the lock is held, so they need no atomic read-modify-write operations.
+ *
+ * @note phmap treats any lock type other than its known shared mutexes as exclusive, so wrapped reader-writer locks
+ *       are only ever locked exclusively
+ *
+ * @tparam Mutex The underlying lock type
+ */
+template <class Mutex = std::mutex>
+class ContentionStatsMutex
+{
+public:
+  ContentionStatsMutex() = default;
+
+  ContentionStatsMutex(const ContentionStatsMutex&)            = delete;
+  ContentionStatsMutex& operator=(const ContentionStatsMutex&) = delete;
+
+  /**
+   * Acquires the lock, measuring the wait if it was held by someone else
+   */
+  __JAFFAR_COMMON_INLINE__ void lock()
+  {
+    if (_mutex.try_lock() == false)
+    {
+      const auto t0 = timing::now();
+      _mutex.lock();
+      increment(_contendedCount, 1);
+      increment(_waitNanoseconds, timing::timeDeltaNanoseconds(timing::now(), t0));
+    }
+    increment(_acquisitionCount, 1);
+  }
+
+  /**
+   * Tries to acquire the lock without waiting
+   *
+   * @return True, if the lock was acquired; false, otherwise
+   */
+  __JAFFAR_COMMON_INLINE__ bool try_lock()
+  {
+    if (_mutex.try_lock() == false) return false;
+    increment(_acquisitionCount, 1);
+    return true;
+  }
+
+  /**
+   * Releases the lock
+   */
+  __JAFFAR_COMMON_INLINE__ void unlock() { _mutex.unlock(); }
+
+  /**
+   * Gets the number of times the lock was acquired
+   *
+   * @return The acquisition count
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getAcquisitionCount() const { return _acquisitionCount.load(std::memory_order_relaxed); }
+
+  /**
+   * Gets the number of acquisitions that had to wait for another holder
+   *
+   * @return The contended acquisition count
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getContendedCount() const { return _contendedCount.load(std::memory_order_relaxed); }
+
+  /**
+   * Gets the total time spent waiting in contended acquisitions
+   *
+   * @return The waiting time, in nanoseconds
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getWaitNanoseconds() const { return _waitNanoseconds.load(std::memory_order_relaxed); }
+
+  /**
+   * Resets the counters
+   *
+   * @note This is not a thread safe operation
+   */
+  __JAFFAR_COMMON_INLINE__ void resetStats()
+  {
+    _acquisitionCount.store(0, std::memory_order_relaxed);
+    _contendedCount.store(0, std::memory_order_relaxed);
+    _waitNanoseconds.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  /**
+   * Adds to a counter. Only called with the lock held, so a plain load and store suffice
+   *
+   * @param[in,out] counter The counter
+   * @param[in] amount The amount to add
+   */
+  static __JAFFAR_COMMON_INLINE__ void increment(std::atomic<size_t>& counter, const size_t amount)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+
+  /**
+   * The underlying lock
+   */
+  Mutex _mutex;
+
+  /**
+   * Number of acquisitions
+   */
+  std::atomic<size_t> _acquisitionCount = 0;
+
+  /**
+   * Number of contended acquisitions
+   */
+  std::atomic<size_t> _contendedCount = 0;
+
+  /**
+   * Total waiting time, in nanoseconds
+   */
+  std::atomic<size_t> _waitNanoseconds = 0;
+};
+
+/**
+ * Definition for a parallel hash set. It enables concurrent inserts and queries
+ *
+ * Besides the phmap interface, it offers insertBatch(), which takes each submap's lock once per batch instead of once per key
+ *
+ * @tparam V The key type
+ * @tparam SubmapBits The base-2 logarithm of the number of submaps (each with its own lock)
+ * @tparam Mutex The lock type of every submap (e.g., std::mutex, SpinLock, or ContentionStatsMutex to measure contention)
+ */
+template <class V, size_t SubmapBits = 8, class Mutex = std::mutex>
+class HashSet_t : public phmap::parallel_flat_hash_set<V, phmap::priv::hash_default_hash<V>, phmap::priv::hash_default_eq<V>, std::allocator<V>, SubmapBits, Mutex>
+{
+  using Base = phmap::parallel_flat_hash_set<V, phmap::priv::hash_default_hash<V>, phmap::priv::hash_default_eq<V>, std::allocator<V>, SubmapBits, Mutex>;
+
+public:
+  using Base::Base;
+
+  /**
+   * Gets the lock of a submap (e.g., to read its contention statistics)
+   *
+   * @param[in] index The submap index, below subcnt()
+   * @return The submap's lock
+   */
+  __JAFFAR_COMMON_INLINE__ Mutex& getSubmapMutex(const size_t index) { return this->sets_[index]; }
+
+  /**
+   * Calls a function on every key of a submap, under the submap's lock. Different threads may traverse different submaps at the same time
+   *
+   * @param[in] index The submap index, below subcnt()
+   * @param[in] callback The function to call on every key
+   */
+  template <class F>
+  __JAFFAR_COMMON_INLINE__ void forEachInSubmap(const size_t index, F&& callback) const
+  {
+    auto&                  inner = const_cast<HashSet_t*>(this)->sets_[index];
+    std::lock_guard<Mutex> lock(inner);
+    for (const auto& key : inner.set_) callback(key);
+  }
+
+  /**
+   * Inserts many keys, locking every submap at most once. Thread safe
+   *
+   * The hashes and submap indices of all keys are computed first, outside of any lock. Keys are then grouped by submap
+   * with a counting sort, and every non-empty submap is locked once to insert its whole group.
+   *
+   * @param[in] keys The keys to insert
+   * @param[in] count The number of keys
+   * @param[out] wasNew Storage for the count results: true, if the corresponding key was inserted; false, if it was already present (or repeated earlier in the batch). May be nullptr
+   */
+  __JAFFAR_COMMON_INLINE__ void insertBatch(const V* keys, const size_t count, bool* wasNew)
+  {
+    // Scratch space, kept across calls so that batches do not allocate
+    thread_local std::vector<size_t> hashValues;
+    thread_local std::vector<size_t> order;
+    thread_local std::vector<size_t> submapStarts;
+    hashValues.resize(count);
+    order.resize(count);
+    submapStarts.assign(Base::subcnt() + 1, 0);
+
+    for (size_t i = 0; i < count; i++) hashValues[i] = this->hash(keys[i]);
+    for (size_t i = 0; i < count; i++) submapStarts[Base::subidx(hashValues[i]) + 1]++;
+    for (size_t s = 0; s < Base::subcnt(); s++) submapStarts[s + 1] += submapStarts[s];
+    for (size_t i = 0; i < count; i++) order[submapStarts[Base::subidx(hashValues[i])]++] = i;
+
+    // After the scatter, every start has moved to the next submap's; submap s spans [end of s-1, end of s)
+    for (size_t s = 0, groupStart = 0; s < Base::subcnt(); groupStart = submapStarts[s++])
+    {
+      if (groupStart == submapStarts[s]) continue;
+
+      auto&                  inner = this->sets_[s];
+      std::lock_guard<Mutex> lock(inner);
+      for (size_t j = groupStart; j < submapStarts[s]; j++)
+      {
+        const size_t i        = order[j];
+        const bool   inserted = inner.set_.emplace_with_hash(hashValues[i], keys[i]).second;
+        if (wasNew != nullptr) wasNew[i] = inserted;
+      }
+    }
+  }
+};
+
+/**
+ * A per-thread staging buffer for HashSet_t inserts
+ *
+ * Keys pushed into it are inserted with HashSet_t::insertBatch once the buffer is full (or on flush()), so the submap
+ * locks are taken once per batch. The flush callback receives the staged keys, in push order, along with whether each
+ * was new, so the caller can keep whatever it staged alongside (e.g., the states the keys belong to) at matching indices.
+ *
+ * @note Every thread must use its own buffer. Keys are only visible in the set after the flush that inserts them
+ */
+template <class V, size_t SubmapBits = 8, class Mutex = std::mutex>
+class HashSetInsertBuffer
+{
+public:
+  /**
+   * Callback invoked on every flush with the staged keys, whether each was new, and their count
+   */
+  typedef std::function<void(const V* keys, const bool* wasNew, const size_t count)> flushCallback_t;
+
+  /**
+   * Constructor for the staging buffer
+   *
+   * @param[in] set The set to insert into
+   * @param[in] capacity Number of keys staged before an automatic flush
+   * @param[in] onFlush The callback invoked with the results of every flush
+   */
+  HashSetInsertBuffer(HashSet_t<V, SubmapBits, Mutex>& set, const size_t capacity, const flushCallback_t onFlush)
+    : _set(set),
+      _capacity(capacity),
+      _onFlush(onFlush)
+  {
+    if (capacity == 0) JAFFAR_THROW_LOGIC("The staging buffer capacity must be a positive number");
+    _keys.reserve(capacity);
+    _wasNew.reset(new bool[capacity]);
+  }
+
+  ~HashSetInsertBuffer() = default;
+
+  HashSetInsertBuffer(const HashSetInsertBuffer&)            = delete;
+  HashSetInsertBuffer& operator=(const HashSetInsertBuffer&) = delete;
+
+  /**
+   * Stages a key for insertion, flushing if the buffer becomes full
+   *
+   * @param[in] key The key to insert
+   */
+  __JAFFAR_COMMON_INLINE__ void push(const V& key)
+  {
+    _keys.push_back(key);
+    if (_keys.size() == _capacity) flush();
+  }
+
+  /**
+   * Inserts all staged keys and reports the results through the flush callback
+   */
+  __JAFFAR_COMMON_INLINE__ void flush()
+  {
+    if (_keys.empty()) return;
+    _set.insertBatch(_keys.data(), _keys.size(), _wasNew.get());
+    _onFlush(_keys.data(), _wasNew.get(), _keys.size());
+    _keys.clear();
+  }
+
+  /**
+   * Gets the number of keys currently staged
+   *
+   * @return The number of staged keys
+   */
+  __JAFFAR_COMMON_INLINE__ size_t size() const { return _keys.size(); }
+
+private:
+  /**
+   * The set to insert into
+   */
+  HashSet_t<V, SubmapBits, Mutex>& _set;
+
+  /**
+   * Number of keys staged before an automatic flush
+   */
+  const size_t _capacity;
+
+  /**
+   * The flush callback
+   */
+  const flushCallback_t _onFlush;
+
+  /**
+   * The staged keys
+   */
+  std::vector<V> _keys;
+
+  /**
+   * Insertion results of the current flush
+   */
+  std::unique_ptr<bool[]> _wasNew;
+};
+
+/**
+ * Definition for a parallel hash map. It enables concurrent inserts and queries
+ *
+ * @tparam K The key type
+ * @tparam V The value type
+ * @tparam SubmapBits The base-2 logarithm of the number of submaps (each with its own lock)
+ * @tparam Mutex The lock type of every submap (e.g., std::mutex, SpinLock, or ContentionStatsMutex to measure contention)
+ */
+template <class K, class V, size_t SubmapBits = 8, class Mutex = std::mutex>
+class HashMap_t
+  : public phmap::parallel_flat_hash_map<K, V, phmap::priv::hash_default_hash<K>, phmap::priv::hash_default_eq<K>, std::allocator<std::pair<const K, V>>, SubmapBits, Mutex>
+{
+  using Base = phmap::parallel_flat_hash_map<K, V, phmap::priv::hash_default_hash<K>, phmap::priv::hash_default_eq<K>, std::allocator<std::pair<const K, V>>, SubmapBits, Mutex>;
+
+public:
+  using Base::Base;
+
+  /**
+   * Gets the lock of a submap (e.g., to read its contention statistics)
+   *
+   * @param[in] index The submap index, below subcnt()
+   * @return The submap's lock
+   */
+  __JAFFAR_COMMON_INLINE__ Mutex& getSubmapMutex(const size_t index) { return this->sets_[index]; }
+
+  /**
+   * Erases the entries of a submap that satisfy a predicate, under the submap's lock. Different threads may sweep different submaps at the same time
+   *
+   * @param[in] index The submap index, below subcnt()
+   * @param[in] predicate The function telling whether to erase an entry
+   * @return The number of entries erased
+   */
+  template <class F>
+  __JAFFAR_COMMON_INLINE__ size_t eraseIfInSubmap(const size_t index, F&& predicate)
+  {
+    auto&                  inner  = this->sets_[index];
+    std::lock_guard<Mutex> lock(inner);
+    size_t                 erased = 0;
+    for (auto it = inner.set_.begin(), end = inner.set_.end(); it != end;)
+      if (predicate(*it)) inner.set_._erase(it++), erased++;
+      else ++it;
+    return erased;
+  }
+};
+
+/**
+ * Waits for the thread writing an open-addressing slot (see HashSet) to publish its tag. It spins with a pause hint for
+ * the few cycles publishing normally takes, and then yields the CPU, in case the writer was preempted
+ *
+ * @param[in] tag The slot's tag word
+ * @param[in] observed The tag value last observed
+ * @param[in] busyTag The tag value of a slot being written
+ * @return The first tag value observed other than busyTag
+ */
+__JAFFAR_COMMON_INLINE__ uint64_t waitForSlotPublish(const std::atomic_ref<uint64_t>& tag, uint64_t observed, const uint64_t busyTag)
+{
+  for (size_t spins = 0; observed == busyTag; spins++)
+  {
+    if (spins < 64)
+    {
+#if defined(__x86_64__)
+      __builtin_ia32_pause();
+#endif
+    }
+    else std::this_thread::yield();
+    observed = tag.load(std::memory_order_acquire);
+  }
+  return observed;
+}
+
+/**
+ * An insert-only hash set specialized for 128-bit state hashes (hash::hash_t), with no locks on its common paths
+ *
+ * State hashes are already uniformly distributed, so unlike HashSet_t this set does not rehash them: the low bits of
+ * the first word pick the home slot directly. Slots live in a single preallocated open-addressing table (linear
+ * probing) and there are no locks on the insert or lookup paths:
+ *
+ * - Each slot holds a tag word and a payload word. The tag is 0 while the slot is empty, 1 while an inserting thread
+ *   is writing the payload, and the key's first word once the slot is published.
+ * - An insert claims the first empty slot on the probe path with a single 64-bit CAS on its tag (0 -> 1), writes the
+ *   payload (second word) and then publishes the first word with a release store. A thread that finds a slot being
+ *   written waits for it to be published before comparing, so two concurrent inserts of the same key cannot both
+ *   succeed. That wait is normally a few cycles, but lasts as long as the writer is preempted, so inserts and lookups
+ *   are not strictly lock-free.
+ * - Keys whose first word collides with the sentinels (0 or 1, a 1 in 2^63 chance per key) go to a small
+ *   mutex-guarded overflow list, so every hash_t value is supported.
+ *
+ * Entries are never erased, and the capacity is fixed at construction. Since linear probing slows down as the table
+ * fills up, the capacity should be about twice the expected number of entries. Inserting into a full table throws.
+ */
+class HashSet
+{
+public:
+  /**
+   * Constructor for the hash set
+   *
+   * @param[in] capacity The minimum number of slots to preallocate (rounded up to a power of two)
+   */
+  HashSet(const size_t capacity)
+  {
+    if (capacity == 0) JAFFAR_THROW_LOGIC("The hash set capacity must be a positive number");
+    _capacity = 1;
+    while (_capacity < capacity) _capacity *= 2;
+    _mask = _capacity - 1;
+
+    // Zeroed memory means all slots start empty; large tables get their pages on first touch
+    _slots = (slot_t*)calloc(_capacity, sizeof(slot_t));
+    if (_slots == nullptr) JAFFAR_THROW_RUNTIME("Could not allocate %lu hash set slots", _capacity);
+  }
+
+  ~HashSet() { free(_slots); }
+
+  HashSet(const HashSet&)            = delete;
+  HashSet& operator=(const HashSet&) = delete;
+
+  /**
+   * Inserts a hash into the set. Safe to call concurrently with other inserts and lookups (it may wait on a slot another thread is still writing)
+   *
+   * @param[in] key The hash to insert
+   * @return True, if the hash was inserted; false, if it was already present
+   */
+  __JAFFAR_COMMON_INLINE__ bool insert(const hash::hash_t& key)
+  {
+    if (key.first <= _busyTag) return insertOverflow(key);
+
+    for (size_t probe = 0, idx = key.first & _mask; probe < _capacity; probe++, idx = (idx + 1) & _mask)
+    {
+      std::atomic_ref<uint64_t> tag(_slots[idx].tag);
+      uint64_t                  observed = tag.load(std::memory_order_acquire);
+
+      // Trying to claim an empty slot
+      if (observed == _emptyTag)
+      {
+        if (tag.compare_exchange_strong(observed, _busyTag, std::memory_order_acquire, std::memory_order_acquire) == true)
+        {
+          std::atomic_ref<uint64_t>(_slots[idx].second).store(key.second, std::memory_order_relaxed);
+          tag.store(key.first, std::memory_order_release);
+          return true;
+        }
+      }
+
+      // Another thread is writing this slot: waiting for it to publish its key
+      observed = waitForSlotPublish(tag, observed, _busyTag);
+
+      if (observed == key.first && std::atomic_ref<uint64_t>(_slots[idx].second).load(std::memory_order_relaxed) == key.second) return false;
+    }
+
+    JAFFAR_THROW_RUNTIME("Hash set is full (capacity: %lu)", _capacity);
+  }
+
+  /**
+   * Checks whether a hash is in the set. Safe to call concurrently with inserts (it may wait on a slot another thread is still writing)
+   *
+   * @param[in] key The hash to look for
+   * @return True, if the hash is present; false, otherwise
+   */
+  __JAFFAR_COMMON_INLINE__ bool contains(const hash::hash_t& key) const
+  {
+    if (key.first <= _busyTag) return containsOverflow(key);
+
+    for (size_t probe = 0, idx = key.first & _mask; probe < _capacity; probe++, idx = (idx + 1) & _mask)
+    {
+      std::atomic_ref<uint64_t> tag(_slots[idx].tag);
+      uint64_t                  observed = tag.load(std::memory_order_acquire);
+      observed = waitForSlotPublish(tag, observed, _busyTag);
+
+      if (observed == _emptyTag) return false;
+      if (observed == key.first && std::atomic_ref<uint64_t>(_slots[idx].second).load(std::memory_order_relaxed) == key.second) return true;
+    }
+
+    return false;
+  }
+
+  /**
+   * Counts the entries in the set
+   *
+   * @note This walks the whole table, and is only exact while there are no concurrent inserts
+   *
+   * @return The number of hashes in the set
+   */
+  __JAFFAR_COMMON_INLINE__ size_t size() const
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < _capacity; i++) count += std::atomic_ref<uint64_t>(_slots[i].tag).load(std::memory_order_relaxed) != _emptyTag;
+
+    std::lock_guard<std::mutex> lock(_overflowMutex);
+    return count + _overflow.size();
+  }
+
+  /**
+   * Gets the number of slots in the table
+   *
+   * @return The table capacity
+   */
+  __JAFFAR_COMMON_INLINE__ size_t capacity() const { return _capacity; }
+
+  /**
+   * Removes all entries
+   *
+   * @note This is not a thread safe operation
+   */
+  __JAFFAR_COMMON_INLINE__ void clear()
+  {
+    memset(_slots, 0, _capacity * sizeof(slot_t));
+    _overflow.clear();
+  }
+
+private:
+  /**
+   * A table slot: the tag (empty, busy or the key's first word) and the key's second word
+   */
+  struct slot_t
+  {
+    uint64_t tag;
+    uint64_t second;
+  };
+
+  /**
+   * Tag of an empty slot
+   */
+  static constexpr uint64_t _emptyTag = 0;
+
+  /**
+   * Tag of a slot whose payload is being written
+   */
+  static constexpr uint64_t _busyTag = 1;
+
+  /**
+   * Inserts a key whose first word collides with a sentinel tag
+   *
+   * @param[in] key The hash to insert
+   * @return True, if the hash was inserted; false, if it was already present
+   */
+  __JAFFAR_COMMON_INLINE__ bool insertOverflow(const hash::hash_t& key)
+  {
+    std::lock_guard<std::mutex> lock(_overflowMutex);
+    for (const auto& entry : _overflow)
+      if (entry == key) return false;
+    _overflow.push_back(key);
+    return true;
+  }
+
+  /**
+   * Looks for a key whose first word collides with a sentinel tag
+   *
+   * @param[in] key The hash to look for
+   * @return True, if the hash is present; false, otherwise
+   */
+  __JAFFAR_COMMON_INLINE__ bool containsOverflow(const hash::hash_t& key) const
+  {
+    std::lock_guard<std::mutex> lock(_overflowMutex);
+    for (const auto& entry : _overflow)
+      if (entry == key) return true;
+    return false;
+  }
+
+  /**
+   * The open-addressing table
+   */
+  slot_t* _slots;
+
+  /**
+   * Number of slots (a power of two)
+   */
+  size_t _capacity;
+
+  /**
+   * Mask turning a key word into a slot index
+   */
+  size_t _mask;
+
+  /**
+   * Keys whose first word collides with a sentinel tag
+   */
+  std::vector<hash::hash_t> _overflow;
+
+  /**
+   * Mutual exclusion for the overflow list
+   */
+  mutable std::mutex _overflowMutex;
+};
+
+/**
+ * A hash map from state hashes (hash::hash_t) to 64-bit values updated with atomic read-modify-write operations
+ *
+ * It is meant for per-state metadata (visit counts, best reward seen, etc.) that HashMap_t can only update under a
+ * submap lock. The table follows HashSet's design (fixed capacity, linear probing from a home slot picked by the key's
+ * first word, slots claimed with a CAS on their tag word), and each slot adds a value word. A missing key is inserted
+ * with the map's initial value, published together with the key, and then every operation acts directly on the
+ * slot's value with a single atomic instruction (fetchAdd) or a CAS loop (fetchMax, fetchMin).
+ *
+ * Keys whose first word collides with the sentinel tags go to a mutex-guarded overflow list. Their values still live
+ * at stable addresses, so only finding them takes the lock. As in HashSet, finding a key may also wait on a slot
+ * another thread is still writing (see waitForSlotPublish), so the map is not strictly lock-free.
+ *
+ * @note Value operations are relaxed atomics (except compareExchange): every key's value is always consistent, but
+ *       updates to different keys are not ordered with respect to each other
+ *
+ * @tparam Value The value type: a 64-bit integer or a double
+ */
+template <class Value = uint64_t>
+class AtomicHashMap
+{
+  static_assert(std::is_arithmetic<Value>::value && sizeof(Value) == sizeof(uint64_t), "Values must be 64-bit integers or doubles");
+
+public:
+  /**
+   * Constructor for the atomic hash map
+   *
+   * @param[in] capacity The minimum number of slots to preallocate (rounded up to a power of two)
+   * @param[in] initialValue The value a key takes when it is first accessed
+   */
+  AtomicHashMap(const size_t capacity, const Value initialValue = Value(0))
+    : _initialValue(initialValue)
+  {
+    if (capacity == 0) JAFFAR_THROW_LOGIC("The hash map capacity must be a positive number");
+    _capacity = 1;
+    while (_capacity < capacity) _capacity *= 2;
+    _mask = _capacity - 1;
+
+    // Zeroed memory means all slots start empty; large tables get their pages on first touch
+    _slots = (slot_t*)calloc(_capacity, sizeof(slot_t));
+    if (_slots == nullptr) JAFFAR_THROW_RUNTIME("Could not allocate %lu hash map slots", _capacity);
+  }
+
+  ~AtomicHashMap() { free(_slots); }
+
+  AtomicHashMap(const AtomicHashMap&)            = delete;
+  AtomicHashMap& operator=(const AtomicHashMap&) = delete;
+
+  /**
+   * Adds to a key's value. Thread safe (finding the key may wait on a slot another thread is still writing)
+   *
+   * @param[in] key The key, inserted with the initial value if missing
+   * @param[in] delta The amount to add
+   * @return The value before the addition
+   */
+  __JAFFAR_COMMON_INLINE__ Value fetchAdd(const hash::hash_t& key, const Value delta) { return std::atomic_ref<Value>(*findOrInsert(key)).fetch_add(delta, std::memory_order_relaxed); }
+
+  /**
+   * Raises a key's value to a given one, if it is lower. Thread safe (finding the key may wait on a slot another thread is still writing)
+   *
+   * @param[in] key The key, inserted with the initial value if missing
+   * @param[in] value The candidate value
+   * @return The value before the update
+   */
+  __JAFFAR_COMMON_INLINE__ Value fetchMax(const hash::hash_t& key, const Value value)
+  {
+    std::atomic_ref<Value> slotValue(*findOrInsert(key));
+    Value                  current = slotValue.load(std::memory_order_relaxed);
+    while (current < value && slotValue.compare_exchange_weak(current, value, std::memory_order_relaxed) == false);
+    return current;
+  }
+
+  /**
+   * Lowers a key's value to a given one, if it is higher. Thread safe (finding the key may wait on a slot another thread is still writing)
+   *
+   * @param[in] key The key, inserted with the initial value if missing
+   * @param[in] value The candidate value
+   * @return The value before the update
+   */
+  __JAFFAR_COMMON_INLINE__ Value fetchMin(const hash::hash_t& key, const Value value)
+  {
+    std::atomic_ref<Value> slotValue(*findOrInsert(key));
+    Value                  current = slotValue.load(std::memory_order_relaxed);
+    while (value < current && slotValue.compare_exchange_weak(current, value, std::memory_order_relaxed) == false);
+    return current;
+  }
+
+  /**
+   * Replaces a key's value if it equals an expected one. Thread safe (finding the key may wait on a slot another thread is still writing)
+   *
+   * @param[in] key The key, inserted with the initial value if missing
+   * @param[in,out] expected The expected value. If the exchange fails, it is updated to the current value
+   * @param[in] desired The new value
+   * @return True, if the value was replaced; false, otherwise
+   */
+  __JAFFAR_COMMON_INLINE__ bool compareExchange(const hash::hash_t& key, Value& expected, const Value desired)
+  {
+    return std::atomic_ref<Value>(*findOrInsert(key)).compare_exchange_strong(expected, desired, std::memory_order_acq_rel, std::memory_order_acquire);
+  }
+
+  /**
+   * Reads a key's value without inserting it. Thread safe (finding the key may wait on a slot another thread is still writing)
+   *
+   * @param[in] key The key
+   * @param[out] value The key's value, if present
+   * @return True, if the key is present; false, otherwise
+   */
+  __JAFFAR_COMMON_INLINE__ bool get(const hash::hash_t& key, Value& value) const
+  {
+    Value* slotValue = find(key);
+    if (slotValue == nullptr) return false;
+    value = std::atomic_ref<Value>(*slotValue).load(std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * Calls a function on every entry, splitting the table among the OpenMP threads (e.g., for an end-of-step scan)
+   *
+   * @note The callback is called concurrently from several threads. Entries inserted or updated during the scan may or may not be seen
+   *
+   * @param[in] callback The function to call with every key and its value
+   */
+  __JAFFAR_COMMON_INLINE__ void parallelForEach(const std::function<void(const hash::hash_t&, const Value)>& callback) const
+  {
+    JAFFAR_PARALLEL_FOR
+    for (size_t i = 0; i < _capacity; i++)
+    {
+      const uint64_t tag = std::atomic_ref<uint64_t>(_slots[i].tag).load(std::memory_order_acquire);
+      if (tag == _emptyTag || tag == _busyTag) continue;
+      callback(hash::hash_t(tag, _slots[i].second), std::atomic_ref<Value>(_slots[i].value).load(std::memory_order_relaxed));
+    }
+
+    std::lock_guard<std::mutex> lock(_overflowMutex);
+    for (const auto& entry : _overflow) callback(entry.key, std::atomic_ref<Value>(entry.value).load(std::memory_order_relaxed));
+  }
+
+  /**
+   * Counts the entries in the map
+   *
+   * @note This walks the whole table, and is only exact while there are no concurrent inserts
+   *
+   * @return The number of keys in the map
+   */
+  __JAFFAR_COMMON_INLINE__ size_t size() const
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < _capacity; i++) count += std::atomic_ref<uint64_t>(_slots[i].tag).load(std::memory_order_relaxed) != _emptyTag;
+
+    std::lock_guard<std::mutex> lock(_overflowMutex);
+    return count + _overflow.size();
+  }
+
+  /**
+   * Gets the number of slots in the table
+   *
+   * @return The table capacity
+   */
+  __JAFFAR_COMMON_INLINE__ size_t capacity() const { return _capacity; }
+
+  /**
+   * Removes all entries
+   *
+   * @note This is not a thread safe operation
+   */
+  __JAFFAR_COMMON_INLINE__ void clear()
+  {
+    memset(_slots, 0, _capacity * sizeof(slot_t));
+    _overflow.clear();
+  }
+
+private:
+  /**
+   * A table slot: the tag (empty, busy or the key's first word), the key's second word, and the value
+   */
+  struct slot_t
+  {
+    uint64_t tag;
+    uint64_t second;
+    Value    value;
+  };
+
+  /**
+   * An entry for a key whose first word collides with a sentinel tag
+   */
+  struct overflowEntry_t
+  {
+    hash::hash_t  key;
+    mutable Value value;
+  };
+
+  /**
+   * Tag of an empty slot
+   */
+  static constexpr uint64_t _emptyTag = 0;
+
+  /**
+   * Tag of a slot whose key and value are being written
+   */
+  static constexpr uint64_t _busyTag = 1;
+
+  /**
+   * Finds a key's value, inserting the key with the initial value if missing
+   *
+   * @param[in] key The key
+   * @return The address of the key's value
+   */
+  __JAFFAR_COMMON_INLINE__ Value* findOrInsert(const hash::hash_t& key)
+  {
+    if (key.first <= _busyTag) return findOrInsertOverflow(key);
+
+    for (size_t probe = 0, idx = key.first & _mask; probe < _capacity; probe++, idx = (idx + 1) & _mask)
+    {
+      std::atomic_ref<uint64_t> tag(_slots[idx].tag);
+      uint64_t                  observed = tag.load(std::memory_order_acquire);
+
+      // Trying to claim an empty slot, and publishing the key along with its initial value
+      if (observed == _emptyTag)
+      {
+        if (tag.compare_exchange_strong(observed, _busyTag, std::memory_order_acquire, std::memory_order_acquire) == true)
+        {
+          std::atomic_ref<uint64_t>(_slots[idx].second).store(key.second, std::memory_order_relaxed);
+          std::atomic_ref<Value>(_slots[idx].value).store(_initialValue, std::memory_order_relaxed);
+          tag.store(key.first, std::memory_order_release);
+          return &_slots[idx].value;
+        }
+      }
+
+      // Another thread is writing this slot: waiting for it to publish its key
+      observed = waitForSlotPublish(tag, observed, _busyTag);
+
+      if (observed == key.first && std::atomic_ref<uint64_t>(_slots[idx].second).load(std::memory_order_relaxed) == key.second) return &_slots[idx].value;
+    }
+
+    JAFFAR_THROW_RUNTIME("Hash map is full (capacity: %lu)", _capacity);
+  }
+
+  /**
+   * Finds a key's value
+   *
+   * @param[in] key The key
+   * @return The address of the key's value, or nullptr if missing
+   */
+  __JAFFAR_COMMON_INLINE__ Value* find(const hash::hash_t& key) const
+  {
+    if (key.first <= _busyTag)
+    {
+      std::lock_guard<std::mutex> lock(_overflowMutex);
+      for (const auto& entry : _overflow)
+        if (entry.key == key) return &entry.value;
+      return nullptr;
+    }
+
+    for (size_t probe = 0, idx = key.first & _mask; probe < _capacity; probe++, idx = (idx + 1) & _mask)
+    {
+      std::atomic_ref<uint64_t> tag(_slots[idx].tag);
+      uint64_t                  observed = tag.load(std::memory_order_acquire);
+      observed = waitForSlotPublish(tag, observed, _busyTag);
+
+      if (observed == _emptyTag) return nullptr;
+      if (observed == key.first && std::atomic_ref<uint64_t>(_slots[idx].second).load(std::memory_order_relaxed) == key.second) return &_slots[idx].value;
+    }
+
+    return nullptr;
+  }
+
+  /**
+   * Finds the value of a key whose first word collides with a sentinel tag, inserting the key if missing
+   *
+   * @param[in] key The key
+   * @return The address of the key's value (stable, since the overflow list never moves its entries)
+   */
+  __JAFFAR_COMMON_INLINE__ Value* findOrInsertOverflow(const hash::hash_t& key)
+  {
+    std::lock_guard<std::mutex> lock(_overflowMutex);
+    for (auto& entry : _overflow)
+      if (entry.key == key) return &entry.value;
+    _overflow.push_back(overflowEntry_t{key, _initialValue});
+    return &_overflow.back().value;
+  }
+
+  /**
+   * The value a key takes when it is first accessed
+   */
+  const Value _initialValue;
+
+  /**
+   * The open-addressing table
+   */
+  slot_t* _slots;
+
+  /**
+   * Number of slots (a power of two)
+   */
+  size_t _capacity;
+
+  /**
+   * Mask turning a key word into a slot index
+   */
+  size_t _mask;
+
+  /**
+   * Entries whose key's first word collides with a sentinel tag
+   */
+  std::deque<overflowEntry_t> _overflow;
+
+  /**
+   * Mutual exclusion for the overflow list
+   */
+  mutable std::mutex _overflowMutex;
+};
+
+/**
+ * A lock-free, insert-only visited set that stores compact fingerprints of the state hashes instead of the full 128 bits
+ *
+ * It follows HashSet's design (preallocated open-addressing table, linear probing from a home slot picked by the first
+ * word of the key, insert-if-absent via CAS), but each slot holds only a fingerprint: the low 32 or 64 bits of the
+ * key's second word, which are independent from the bits that pick the home slot. Because a fingerprint fits in a
+ * single atomic word, claiming a slot and publishing the key are the same CAS, and there is no busy state to wait on.
+ * Consecutive slots share cache lines, so a probe sequence touches few lines.
+ *
+ * Memory per tracked state is sizeof(Fingerprint) divided by the load factor: about 5 bytes (32-bit) or 10 bytes
+ * (64-bit) at 80% load, versus roughly 20 bytes for a HashSet_t<hash_t> entry.
+ *
+ * False-positive bound: a new state is wrongly reported as already present only if its fingerprint equals that of one
+ * of the occupied slots visited by its probe sequence. Each such comparison matches with probability 2^-b (b = bits in
+ * the fingerprint), so the rate per new state is at most (expected probe length) x 2^-b. With linear probing at load
+ * factor a, the expected probe length is about (1 + 1 / (1 - a)^2) / 2 slots: 13 at 80% load, giving about 3e-9 per
+ * new state with 32-bit fingerprints (about a dozen lost states in a 4-billion-state run) and about 7e-19 with 64-bit
+ * ones. Fingerprint value 0 marks an empty slot, so a key whose fingerprint bits are all zero is stored as 1.
+ *
+ * @tparam Fingerprint The fingerprint storage type: uint32_t or uint64_t
+ */
+template <class Fingerprint = uint64_t>
+class FingerprintSet
+{
+  static_assert(std::is_same<Fingerprint, uint32_t>::value || std::is_same<Fingerprint, uint64_t>::value, "Fingerprints must be uint32_t or uint64_t");
+
+public:
+  /**
+   * Constructor for the fingerprint set
+   *
+   * @param[in] capacity The minimum number of slots to preallocate (rounded up to a power of two)
+   */
+  FingerprintSet(const size_t capacity)
+  {
+    if (capacity == 0) JAFFAR_THROW_LOGIC("The fingerprint set capacity must be a positive number");
+    _capacity = 1;
+    while (_capacity < capacity) _capacity *= 2;
+    _mask = _capacity - 1;
+
+    // Zeroed memory means all slots start empty; large tables get their pages on first touch
+    _slots = (Fingerprint*)calloc(_capacity, sizeof(Fingerprint));
+    if (_slots == nullptr) JAFFAR_THROW_RUNTIME("Could not allocate %lu fingerprint set slots", _capacity);
+  }
+
+  ~FingerprintSet() { free(_slots); }
+
+  FingerprintSet(const FingerprintSet&)            = delete;
+  FingerprintSet& operator=(const FingerprintSet&) = delete;
+
+  /**
+   * Inserts a hash's fingerprint into the set, unless already present. Lock-free and thread safe
+   *
+   * @param[in] key The hash to insert
+   * @return True, if the fingerprint was inserted; false, if it was (probably, see the false-positive bound) already present
+   */
+  __JAFFAR_COMMON_INLINE__ bool insert(const hash::hash_t& key)
+  {
+    const Fingerprint fingerprint = getFingerprint(key);
+    for (size_t probe = 0, idx = key.first & _mask; probe < _capacity; probe++, idx = (idx + 1) & _mask)
+    {
+      std::atomic_ref<Fingerprint> slot(_slots[idx]);
+      Fingerprint                  observed = slot.load(std::memory_order_relaxed);
+      if (observed == _emptyFingerprint && slot.compare_exchange_strong(observed, fingerprint, std::memory_order_relaxed) == true) return true;
+      if (observed == fingerprint) return false;
+    }
+
+    JAFFAR_THROW_RUNTIME("Fingerprint set is full (capacity: %lu)", _capacity);
+  }
+
+  /**
+   * Checks whether a hash's fingerprint is in the set. Lock-free and thread safe
+   *
+   * @param[in] key The hash to look for
+   * @return True, if the fingerprint is (probably) present; false, if the hash was definitely never inserted
+   */
+  __JAFFAR_COMMON_INLINE__ bool contains(const hash::hash_t& key) const
+  {
+    const Fingerprint fingerprint = getFingerprint(key);
+    for (size_t probe = 0, idx = key.first & _mask; probe < _capacity; probe++, idx = (idx + 1) & _mask)
+    {
+      const Fingerprint observed = std::atomic_ref<Fingerprint>(_slots[idx]).load(std::memory_order_relaxed);
+      if (observed == fingerprint) return true;
+      if (observed == _emptyFingerprint) return false;
+    }
+
+    return false;
+  }
+
+  /**
+   * Counts the entries in the set
+   *
+   * @note This walks the whole table, and is only exact while there are no concurrent inserts
+   *
+   * @return The number of fingerprints in the set
+   */
+  __JAFFAR_COMMON_INLINE__ size_t size() const
+  {
+    size_t count = 0;
+    for (size_t i = 0; i < _capacity; i++) count += std::atomic_ref<Fingerprint>(_slots[i]).load(std::memory_order_relaxed) != _emptyFingerprint;
+    return count;
+  }
+
+  /**
+   * Gets the number of slots in the table
+   *
+   * @return The table capacity
+   */
+  __JAFFAR_COMMON_INLINE__ size_t capacity() const { return _capacity; }
+
+  /**
+   * Gets the memory used by the table
+   *
+   * @return The table size, in bytes
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getMemoryFootprint() const { return _capacity * sizeof(Fingerprint); }
+
+  /**
+   * Removes all entries
+   *
+   * @note This is not a thread safe operation
+   */
+  __JAFFAR_COMMON_INLINE__ void clear() { memset(_slots, 0, _capacity * sizeof(Fingerprint)); }
+
+private:
+  /**
+   * Value of an empty slot
+   */
+  static constexpr Fingerprint _emptyFingerprint = 0;
+
+  /**
+   * Extracts the fingerprint of a key (bits independent from those that pick the home slot)
+   *
+   * @param[in] key The hash
+   * @return The fingerprint (never the empty value)
+   */
+  static __JAFFAR_COMMON_INLINE__ Fingerprint getFingerprint(const hash::hash_t& key)
+  {
+    const Fingerprint fingerprint = (Fingerprint)key.second;
+    return fingerprint == _emptyFingerprint ? 1 : fingerprint;
+  }
+
+  /**
+   * The open-addressing table
+   */
+  Fingerprint* _slots;
+
+  /**
+   * Number of slots (a power of two)
+   */
+  size_t _capacity;
+
+  /**
+   * Mask turning a key word into a slot index
+   */
+  size_t _mask;
+};
+
+/**
+ * A concurrent hash set of state hashes that only remembers the entries of the last few generations (search steps)
+ *
+ * Duplicate states mostly come from the last few dozen steps, so keeping every hash for the whole run wastes memory.
+ * Here, all entries live in a single HashMap_t that stores, with every hash, the last generation it was inserted in.
+ * An insert is a single locked probe: a missing hash is added with the current generation, and a present one gets its
+ * generation refreshed, so the window counts from the last time a state was seen. A hash whose generation fell out of
+ * the window counts as absent, and inserting it makes it new again, trading a controlled amount of re-exploration for
+ * bounded memory.
+ *
+ * advanceGeneration() only moves the window forward. Expired entries are erased in bulk by a sweep over the submaps
+ * (in parallel), run once half a window's worth of generations has expired since the last one, so the table holds at
+ * most about one and a half windows of entries and the sweep cost is spread over many generations.
+ *
+ * @note insert() and contains() are thread safe with respect to each other. advanceGeneration() and setWindowSize() must
+ *       be called while no other operation is in flight (e.g., between search steps)
+ */
+class GenerationalHashSet
+{
+public:
+  /**
+   * Constructor for the generational hash set
+   *
+   * @param[in] windowSize The number of generations kept alive (including the current one)
+   */
+  GenerationalHashSet(const size_t windowSize) { setWindowSize(windowSize); }
+
+  /**
+   * Inserts a hash into the current generation. Thread safe
+   *
+   * @param[in] key The hash to insert
+   * @return True, if the hash was new; false, if it was already present in a live generation (it is then refreshed into the current one)
+   */
+  __JAFFAR_COMMON_INLINE__ bool insert(const hash::hash_t& key)
+  {
+    bool       expired  = false;
+    const bool inserted = _entries.lazy_emplace_l(
+      key,
+      [this, &expired](size_t& generation) {
+        expired    = generation < _windowStart;
+        generation = _currentGeneration;
+      },
+      [this, &key](const auto& constructor) { constructor(key, _currentGeneration); });
+    return inserted || expired;
+  }
+
+  /**
+   * Checks whether a hash is present in any live generation. Thread safe
+   *
+   * @param[in] key The hash to look for
+   * @return True, if the hash is present; false, otherwise
+   */
+  __JAFFAR_COMMON_INLINE__ bool contains(const hash::hash_t& key) const
+  {
+    bool live = false;
+    _entries.if_contains(key, [this, &live](const size_t& generation) { live = generation >= _windowStart; });
+    return live;
+  }
+
+  /**
+   * Starts a new generation, sweeping out the expired entries if enough generations expired since the last sweep
+   *
+   * @note This is not a thread safe operation
+   */
+  __JAFFAR_COMMON_INLINE__ void advanceGeneration()
+  {
+    _currentGeneration++;
+    updateWindow();
+    if (_windowStart - _sweptWindowStart >= std::max((size_t)1, _windowSize / 2)) sweep();
+  }
+
+  /**
+   * Changes the number of generations kept alive. Shrinking the window sweeps out the expired entries immediately
+   *
+   * @note This is not a thread safe operation
+   *
+   * @param[in] windowSize The number of generations kept alive (including the current one)
+   */
+  __JAFFAR_COMMON_INLINE__ void setWindowSize(const size_t windowSize)
+  {
+    if (windowSize == 0) JAFFAR_THROW_LOGIC("The generation window size must be a positive number");
+    _windowSize = windowSize;
+    updateWindow();
+    if (_windowStart > _sweptWindowStart) sweep();
+  }
+
+  /**
+   * Gets the number of the current generation (the number of times the generation was advanced)
+   *
+   * @return The current generation
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getCurrentGeneration() const { return _currentGeneration; }
+
+  /**
+   * Gets the number of generations currently alive
+   *
+   * @return The number of live generations
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getLiveGenerationCount() const { return _currentGeneration - _windowStart + 1; }
+
+  /**
+   * Gets the number of entries in live generations
+   *
+   * @note This walks the whole table, and is only exact while there are no concurrent inserts
+   *
+   * @return The number of live entries
+   */
+  __JAFFAR_COMMON_INLINE__ size_t size() const
+  {
+    size_t count = 0;
+    _entries.for_each([this, &count](const auto& entry) { count += entry.second >= _windowStart; });
+    return count;
+  }
+
+  /**
+   * Gets the number of expired entries erased by sweeps, since construction
+   *
+   * @return The number of retired entries
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getRetiredEntryCount() const { return _retiredEntryCount; }
+
+  /**
+   * Estimates the memory used by the table: every slot (used or not) plus its control byte
+   *
+   * @return The memory footprint, in bytes
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getMemoryFootprint() const { return sizeof(entryMap_t) + _entries.capacity() * (sizeof(entryMap_t::value_type) + 1); }
+
+private:
+  /**
+   * Map from every remembered hash to the last generation it was inserted in
+   */
+  typedef HashMap_t<hash::hash_t, size_t> entryMap_t;
+
+  /**
+   * Moves the start of the window so that it holds the last windowSize generations
+   */
+  __JAFFAR_COMMON_INLINE__ void updateWindow() { _windowStart = _currentGeneration + 1 > _windowSize ? _currentGeneration + 1 - _windowSize : 0; }
+
+  /**
+   * Erases the entries of the generations before the window, sweeping the submaps in parallel
+   */
+  __JAFFAR_COMMON_INLINE__ void sweep()
+  {
+    std::atomic<size_t> erased = 0;
+    JAFFAR_PARALLEL_FOR
+    for (size_t s = 0; s < _entries.subcnt(); s++)
+      erased.fetch_add(_entries.eraseIfInSubmap(s, [this](const auto& entry) { return entry.second < _windowStart; }), std::memory_order_relaxed);
+
+    _retiredEntryCount += erased.load(std::memory_order_relaxed);
+    _sweptWindowStart = _windowStart;
+  }
+
+  /**
+   * The remembered hashes, with their last generation
+   */
+  entryMap_t _entries;
+
+  /**
+   * Number of generations kept alive
+   */
+  size_t _windowSize;
+
+  /**
+   * The number of the current generation
+   */
+  size_t _currentGeneration = 0;
+
+  /**
+   * The oldest live generation
+   */
+  size_t _windowStart = 0;
+
+  /**
+   * The oldest live generation at the time of the last sweep (no older entries are left)
+   */
+  size_t _sweptWindowStart = 0;
+
+  /**
+   * Number of entries erased by sweeps
+   */
+  size_t _retiredEntryCount = 0;
+};
+
+/**
+ * An immutable, sorted index of state hashes, built from a HashSet_t once its search phase is over
+ *
+ * The keys are kept in one sorted array. Since state hashes are uniformly distributed, the top bits of a key predict its
+ * position well, so instead of a search tree (whose levels would each cost a dependent cache miss) a directory indexed
+ * by those top bits gives the range of keys sharing them, a handful on average. A lookup is thus one directory read
+ * followed by a short scan of one or two cache lines, with no locks. containsBatch() overlaps the misses of many lookups
+ * by prefetching the directory entries and then the key ranges some queries ahead.
+ *
+ * With four to eight keys per directory entry, it takes 17 to 18 bytes per key, without the locks, control bytes and
+ * load-factor slack of the source set. Building it uses all threads: the submaps of the source set are traversed in
+ * parallel, their keys scattered straight into the index array by their top bits (so the keys are copied only once),
+ * the resulting partitions are sorted in parallel, and the directory is filled in parallel.
+ */
+class FrozenHashSet
+{
+public:
+  /**
+   * Constructor for the frozen hash set
+   *
+   * @param[in] set The set to freeze. It must not be modified while the index is being built
+   */
+  template <size_t SubmapBits, class Mutex>
+  FrozenHashSet(const HashSet_t<hash::hash_t, SubmapBits, Mutex>& set)
+  {
+    _keys = sortKeys(set.subcnt(), [&set](const size_t submap, const auto& callback) { set.forEachInSubmap(submap, callback); });
+
+    // Aiming for four to eight keys per directory entry
+    size_t directoryBits = 1;
+    while (((size_t)8 << directoryBits) <= _keys.size()) directoryBits++;
+    _directoryShift = 64 - directoryBits;
+    _directory.resize(((size_t)1 << directoryBits) + 1);
+    buildDirectory();
+  }
+
+  FrozenHashSet(const FrozenHashSet&)            = delete;
+  FrozenHashSet& operator=(const FrozenHashSet&) = delete;
+
+  /**
+   * Checks whether a hash is in the index. Thread safe
+   *
+   * @param[in] key The hash to look for
+   * @return True, if the hash is present; false, otherwise
+   */
+  __JAFFAR_COMMON_INLINE__ bool contains(const hash::hash_t& key) const
+  {
+    const size_t entry = key.first >> _directoryShift;
+    for (size_t i = _directory[entry]; i < _directory[entry + 1]; i++)
+      if (_keys[i] == key) return true;
+    return false;
+  }
+
+  /**
+   * Checks whether each of many hashes is in the index, overlapping the memory accesses of consecutive lookups. Thread safe
+   *
+   * @param[in] keys The hashes to look for
+   * @param[in] count The number of hashes
+   * @param[out] results Storage for the count results (true, if the corresponding hash is present)
+   */
+  __JAFFAR_COMMON_INLINE__ void containsBatch(const hash::hash_t* keys, const size_t count, bool* results) const
+  {
+    // Two lookahead stages: the directory entry of a query is requested first, and its key range once that entry has arrived
+    for (size_t i = 0; i < count; i++)
+    {
+      if (i + 2 * _batchLookahead < count) __builtin_prefetch(&_directory[keys[i + 2 * _batchLookahead].first >> _directoryShift]);
+      if (i + _batchLookahead < count) __builtin_prefetch(&_keys.data()[_directory[keys[i + _batchLookahead].first >> _directoryShift]]);
+      results[i] = contains(keys[i]);
+    }
+  }
+
+  /**
+   * Gets the number of entries in the index
+   *
+   * @return The entry count
+   */
+  __JAFFAR_COMMON_INLINE__ size_t size() const { return _keys.size(); }
+
+  /**
+   * Gets the memory used by the index
+   *
+   * @return The index size, in bytes
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getMemoryFootprint() const { return _keys.size() * sizeof(hash::hash_t) + _directory.size() * sizeof(size_t); }
+
+private:
+  /**
+   * Sorts keys coming from many sources in parallel: they are scattered into buckets by their top bits (hashes are
+   * uniform, so buckets come out balanced) and then every bucket is sorted on its own. The sources are split among the
+   * threads, which count their keys per bucket in a first traversal and scatter them in a second one
+   *
+   * @param[in] sourceCount The number of key sources
+   * @param[in] traverse A function calling a given callback on every key of a given source. Different threads traverse different sources at the same time
+   * @return The sorted keys
+   */
+  template <class Traverse>
+  static __JAFFAR_COMMON_INLINE__ std::vector<hash::hash_t> sortKeys(const size_t sourceCount, const Traverse& traverse)
+  {
+    const size_t              maxThreadCount = parallel::getMaxThreadCount();
+    std::vector<size_t>       offsets(maxThreadCount * _bucketCount, 0);
+    std::vector<size_t>       bucketStarts(_bucketCount + 1, 0);
+    std::vector<hash::hash_t> sorted;
+
+    JAFFAR_PARALLEL
+    {
+      const size_t threadId    = parallel::getThreadId();
+      const size_t threadCount = parallel::getThreadCount();
+      size_t*      histogram   = &offsets[threadId * _bucketCount];
+
+      // Both traversals split the sources the same way (static schedule), so every thread scatters exactly the keys it counted
+      JAFFAR_FOR
+      for (size_t s = 0; s < sourceCount; s++) traverse(s, [histogram](const hash::hash_t& key) { histogram[key.first >> (64 - _bucketBits)]++; });
+
+      // Turning the per-thread histograms into write offsets (bucket-major, so every bucket ends up contiguous)
+      JAFFAR_MASTER
+      {
+        size_t position = 0;
+        for (size_t b = 0; b < _bucketCount; b++)
+        {
+          bucketStarts[b] = position;
+          for (size_t t = 0; t < threadCount; t++)
+          {
+            const size_t count            = offsets[t * _bucketCount + b];
+            offsets[t * _bucketCount + b] = position;
+            position += count;
+          }
+        }
+        bucketStarts[_bucketCount] = position;
+        sorted.resize(position);
+      }
+      JAFFAR_BARRIER
+
+      JAFFAR_FOR
+      for (size_t s = 0; s < sourceCount; s++) traverse(s, [&sorted, histogram](const hash::hash_t& key) { sorted[histogram[key.first >> (64 - _bucketBits)]++] = key; });
+
+      JAFFAR_FOR_DYNAMIC
+      for (size_t b = 0; b < _bucketCount; b++) std::sort(sorted.begin() + bucketStarts[b], sorted.begin() + bucketStarts[b + 1]);
+    }
+
+    return sorted;
+  }
+
+  /**
+   * Fills the directory from the sorted keys. Each key writes its own position as the start of the entries after its
+   * predecessor's, up to its own (none, if they share one), so every entry is written exactly once
+   */
+  __JAFFAR_COMMON_INLINE__ void buildDirectory()
+  {
+    const size_t keyCount   = _keys.size();
+    const size_t entryCount = _directory.size() - 1;
+
+    JAFFAR_PARALLEL_FOR
+    for (size_t i = 0; i <= keyCount; i++)
+    {
+      const size_t firstEntry = i == 0 ? 0 : (_keys[i - 1].first >> _directoryShift) + 1;
+      const size_t lastEntry  = i == keyCount ? entryCount : _keys[i].first >> _directoryShift;
+      for (size_t e = firstEntry; e <= lastEntry; e++) _directory[e] = i;
+    }
+  }
+
+  /**
+   * Number of top key bits used to partition the keys for sorting
+   */
+  static constexpr size_t _bucketBits = 12;
+
+  /**
+   * Number of sorting buckets
+   */
+  static constexpr size_t _bucketCount = (size_t)1 << _bucketBits;
+
+  /**
+   * Number of queries between a batched lookup and the prefetching of its key range (and twice that for its directory entry)
+   */
+  static constexpr size_t _batchLookahead = 8;
+
+  /**
+   * The keys, sorted
+   */
+  std::vector<hash::hash_t> _keys;
+
+  /**
+   * Start of the range of keys for each value of their top bits (with an extra entry marking the end of the array)
+   */
+  std::vector<size_t> _directory;
+
+  /**
+   * Shift that turns the first word of a key into its directory entry
+   */
+  size_t _directoryShift;
+};
+
+/**
+ * Freezes a hash set into an immutable index, for when no more states will be inserted into it
+ *
+ * @param[in] set The set to freeze
+ * @return The frozen index
+ */
+template <size_t SubmapBits, class Mutex>
+__JAFFAR_COMMON_INLINE__ std::unique_ptr<FrozenHashSet> freeze(const HashSet_t<hash::hash_t, SubmapBits, Mutex>& set)
+{
+  return std::make_unique<FrozenHashSet>(set);
+}
+
+/**
+ * A concurrent, cache-blocked Bloom filter for state hashes, meant to sit in front of the visited set
+ *
+ * Most states produced during expansion are new, yet checking them against a HashSet_t takes a submap lock and a probe.
+ * This filter answers "definitely new" with a single cache-line access: the first word of the key selects a 64-byte
+ * block and the second word selects one bit in each of the block's eight 64-bit words (a split-block Bloom filter).
+ * insert() sets the bits with atomic ORs, skipping words whose bit is already set so that duplicates do not dirty the
+ * line. Only when all eight bits were already set ("probably seen") does the caller need to consult the locked set.
+ * Two threads racing to insert the same new key may both get "definitely new"; the visited set settles that race.
+ *
+ * With 16 bits per expected entry the false-positive rate stays around 0.1% at full load (about 2.9% at 8 bits/entry,
+ * since block loads vary around their mean). Counters track the number of queries, definitely-new answers and (as
+ * reported by the caller after checking the set) false positives. They are kept per thread on separate cache lines so
+ * that counting adds no contention. The filter does not time itself: callers derive its throughput by dividing the
+ * query count by the time they measured, and getDefinitelyNewRate() gives the share of queries it kept from the set.
+ */
+class BloomFilter
+{
+public:
+  /**
+   * Constructor for the Bloom filter
+   *
+   * @param[in] expectedEntries The number of distinct hashes the filter is sized for
+   * @param[in] bitsPerEntry The number of filter bits per expected entry
+   */
+  BloomFilter(const size_t expectedEntries, const size_t bitsPerEntry = 16)
+  {
+    if (expectedEntries == 0 || bitsPerEntry == 0) JAFFAR_THROW_LOGIC("The expected entry count and bits per entry must be positive numbers");
+
+    _blockCount = (expectedEntries * bitsPerEntry + _blockBits - 1) / _blockBits;
+    _blocks     = (block_t*)aligned_alloc(sizeof(block_t), _blockCount * sizeof(block_t));
+    if (_blocks == nullptr) JAFFAR_THROW_RUNTIME("Could not allocate %lu Bloom filter blocks", _blockCount);
+
+    _counters.resize(parallel::getMaxThreadCount());
+    clear();
+  }
+
+  ~BloomFilter() { free(_blocks); }
+
+  BloomFilter(const BloomFilter&)            = delete;
+  BloomFilter& operator=(const BloomFilter&) = delete;
+
+  /**
+   * Adds a hash to the filter, telling whether it is definitely new. Lock-free and thread safe
+   *
+   * @param[in] key The hash to add
+   * @return True, if the hash is definitely new; false, if it was probably added before
+   */
+  __JAFFAR_COMMON_INLINE__ bool insert(const hash::hash_t& key)
+  {
+    uint64_t* words           = getBlock(key).words;
+    bool      probablyPresent = true;
+    for (size_t i = 0; i < _wordsPerBlock; i++)
+    {
+      std::atomic_ref<uint64_t> word(words[i]);
+      const uint64_t            bit = getBit(key, i);
+      if ((word.load(std::memory_order_relaxed) & bit) != 0) continue;
+      probablyPresent = (word.fetch_or(bit, std::memory_order_relaxed) & bit) != 0 && probablyPresent;
+    }
+
+    countQuery(probablyPresent);
+    return !probablyPresent;
+  }
+
+  /**
+   * Checks whether a hash may have been added to the filter. Lock-free and thread safe
+   *
+   * @param[in] key The hash to look for
+   * @return False, if the hash was definitely never added; true, if it probably was
+   */
+  __JAFFAR_COMMON_INLINE__ bool contains(const hash::hash_t& key)
+  {
+    uint64_t* words           = getBlock(key).words;
+    bool      probablyPresent = true;
+    for (size_t i = 0; i < _wordsPerBlock; i++)
+      probablyPresent = (std::atomic_ref<uint64_t>(words[i]).load(std::memory_order_relaxed) & getBit(key, i)) != 0 && probablyPresent;
+
+    countQuery(probablyPresent);
+    return probablyPresent;
+  }
+
+  /**
+   * Records that a "probably present" answer turned out to be wrong (the key was not in the visited set)
+   */
+  __JAFFAR_COMMON_INLINE__ void reportFalsePositive() { std::atomic_ref<uint64_t>(getCounters().falsePositives).fetch_add(1, std::memory_order_relaxed); }
+
+  /**
+   * Gets the number of queries (inserts and lookups) answered so far
+   *
+   * @return The number of queries
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getQueryCount() const { return sumCounters(&counters_t::queries); }
+
+  /**
+   * Gets the number of queries answered as definitely new
+   *
+   * @return The number of definitely-new answers
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getDefinitelyNewCount() const { return sumCounters(&counters_t::definitelyNew); }
+
+  /**
+   * Gets the number of false positives reported by the caller
+   *
+   * @return The number of reported false positives
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getFalsePositiveCount() const { return sumCounters(&counters_t::falsePositives); }
+
+  /**
+   * Gets the share of queries answered as definitely new, which never reach the visited set
+   *
+   * @return The definitely-new rate (0 if there were no queries)
+   */
+  __JAFFAR_COMMON_INLINE__ double getDefinitelyNewRate() const
+  {
+    const double queries = (double)getQueryCount();
+    return queries == 0.0 ? 0.0 : (double)getDefinitelyNewCount() / queries;
+  }
+
+  /**
+   * Gets the observed false-positive rate: the share of new keys that were reported as probably present
+   *
+   * @return The observed false-positive rate (0 if no new keys were seen)
+   */
+  __JAFFAR_COMMON_INLINE__ double getObservedFalsePositiveRate() const
+  {
+    const double falsePositives = (double)getFalsePositiveCount();
+    const double newKeys        = falsePositives + (double)getDefinitelyNewCount();
+    return newKeys == 0.0 ? 0.0 : falsePositives / newKeys;
+  }
+
+  /**
+   * Estimates the current false-positive rate from the fraction of set bits (one bit is tested per word)
+   *
+   * @note This walks the whole filter
+   *
+   * @return The estimated probability that a new key is reported as probably present
+   */
+  __JAFFAR_COMMON_INLINE__ double getEstimatedFalsePositiveRate() const
+  {
+    size_t setBits = 0;
+    for (size_t i = 0; i < _blockCount; i++)
+      for (size_t j = 0; j < _wordsPerBlock; j++) setBits += __builtin_popcountll(std::atomic_ref<uint64_t>(_blocks[i].words[j]).load(std::memory_order_relaxed));
+
+    const double fill = (double)setBits / (double)(_blockCount * _blockBits);
+    double       rate = 1.0;
+    for (size_t i = 0; i < _wordsPerBlock; i++) rate *= fill;
+    return rate;
+  }
+
+  /**
+   * Gets the memory used by the filter bits
+   *
+   * @return The filter size, in bytes
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getMemoryFootprint() const { return _blockCount * sizeof(block_t); }
+
+  /**
+   * Empties the filter and resets the counters
+   *
+   * @note This is not a thread safe operation
+   */
+  __JAFFAR_COMMON_INLINE__ void clear()
+  {
+    memset(_blocks, 0, _blockCount * sizeof(block_t));
+    for (auto& counters : _counters) counters = counters_t();
+  }
+
+private:
+  /**
+   * Number of 64-bit words per block
+   */
+  static constexpr size_t _wordsPerBlock = 8;
+
+  /**
+   * Number of bits per block
+   */
+  static constexpr size_t _blockBits = _wordsPerBlock * 64;
+
+  /**
+   * A cache-line sized filter block
+   */
+  struct alignas(64) block_t
+  {
+    uint64_t words[_wordsPerBlock];
+  };
+
+  /**
+   * Per-thread query counters, on their own cache line
+   */
+  struct alignas(64) counters_t
+  {
+    uint64_t queries        = 0;
+    uint64_t definitelyNew  = 0;
+    uint64_t falsePositives = 0;
+  };
+
+  /**
+   * Selects the block for a key (multiply-shift range reduction of the first word, so any block count works)
+   *
+   * @param[in] key The hash
+   * @return The block the key maps to
+   */
+  __JAFFAR_COMMON_INLINE__ block_t& getBlock(const hash::hash_t& key) const { return _blocks[(size_t)(((__uint128_t)key.first * _blockCount) >> 64)]; }
+
+  /**
+   * Selects the bit to test or set in one of the block's words, from the second word of the key
+   *
+   * @param[in] key The hash
+   * @param[in] word The index of the word within the block
+   * @return The bit mask
+   */
+  static __JAFFAR_COMMON_INLINE__ uint64_t getBit(const hash::hash_t& key, const size_t word)
+  {
+    // Odd multipliers taken from split-block Bloom filter implementations; the top 6 bits of each product pick the bit
+    constexpr uint64_t salts[_wordsPerBlock] = {0x47B6137B44974D91ull, 0x8824AD5BA2B7289Dull, 0x705495C72DF1424Bull, 0x9EFC49475C6BFB31ull,
+                                                0x2DF1424B9EFC4947ull, 0x5C6BFB3147B6137Bull, 0x44974D918824AD5Bull, 0xA2B7289D705495C7ull};
+    return 1ull << ((key.second * salts[word]) >> 58);
+  }
+
+  /**
+   * Gets the counters of the calling thread
+   *
+   * @return The calling thread's counters
+   */
+  __JAFFAR_COMMON_INLINE__ counters_t& getCounters() { return _counters[parallel::getThreadId() % _counters.size()]; }
+
+  /**
+   * Updates the calling thread's counters after a query
+   *
+   * @param[in] probablyPresent The answer given
+   */
+  __JAFFAR_COMMON_INLINE__ void countQuery(const bool probablyPresent)
+  {
+    counters_t& counters = getCounters();
+    std::atomic_ref<uint64_t>(counters.queries).fetch_add(1, std::memory_order_relaxed);
+    if (probablyPresent == false) std::atomic_ref<uint64_t>(counters.definitelyNew).fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Adds up one of the counters across threads
+   *
+   * @param[in] counter The counter to add up
+   * @return The total
+   */
+  __JAFFAR_COMMON_INLINE__ size_t sumCounters(uint64_t counters_t::*counter) const
+  {
+    size_t total = 0;
+    for (auto& counters : _counters) total += std::atomic_ref<uint64_t>(counters.*counter).load(std::memory_order_relaxed);
+    return total;
+  }
+
+  /**
+   * The filter blocks
+   */
+  block_t* _blocks;
+
+  /**
+   * Number of filter blocks
+   */
+  size_t _blockCount;
+
+  /**
+   * Per-thread query counters (mutable, since even the const getters read them through atomic references)
+   */
+  mutable std::vector<counters_t> _counters;
+};
+
+/**
+ * A small, thread-private, 2-way set-associative cache of recently seen state hashes
+ *
+ * Sibling expansions often produce the same child states within a short time on the same thread. Remembering the last
+ * few thousand hashes a thread saw in the shared set lets it recognize those repeats without touching shared memory.
+ * Lines are picked by the second word of the key (the shared sets use the first one), and each holds two entries kept
+ * in most-recently-used order, so a new entry evicts the least recently used one. The default size (2048 entries,
+ * 32 KiB) fits in the L1 data cache of most CPUs.
+ *
+ * @note This cache is not thread safe; CachedHashSet gives every thread its own. Every lookup writes its counters, so
+ *       the cache is aligned to (and padded up to) whole 64-byte cache lines, for neighboring caches not to share one
+ */
+class alignas(64) RecentHashCache
+{
+public:
+  /**
+   * Constructor for the recent hash cache
+   *
+   * @param[in] entryCount The minimum number of entries (rounded up to an even power of two)
+   */
+  RecentHashCache(const size_t entryCount = 2048)
+  {
+    if (entryCount == 0) JAFFAR_THROW_LOGIC("The recent hash cache entry count must be a positive number");
+    size_t lineCount = 1;
+    while (2 * lineCount < entryCount) lineCount *= 2;
+    _lineMask = lineCount - 1;
+    _lines.resize(lineCount);
+    clear();
+  }
+
+  /**
+   * Checks whether a hash was recently added, refreshing it if so
+   *
+   * @param[in] key The hash to look for
+   * @return True, if the hash is in the cache; false, otherwise
+   */
+  __JAFFAR_COMMON_INLINE__ bool lookup(const hash::hash_t& key)
+  {
+    increment(_lookupCount);
+
+    // The all-zero hash marks empty entries, so it is never cached and must not match them
+    if (key == _emptyEntry) return false;
+
+    line_t& line = _lines[key.second & _lineMask];
+    if (line.entries[0] == key) return increment(_hitCount), true;
+    if (line.entries[1] == key)
+    {
+      std::swap(line.entries[0], line.entries[1]);
+      return increment(_hitCount), true;
+    }
+    return false;
+  }
+
+  /**
+   * Adds a hash as the most recently used entry of its line, evicting the least recently used one
+   *
+   * @param[in] key The hash to add (the all-zero hash marks empty entries and is never cached)
+   */
+  __JAFFAR_COMMON_INLINE__ void add(const hash::hash_t& key)
+  {
+    if (key == _emptyEntry) return;
+    line_t& line    = _lines[key.second & _lineMask];
+    line.entries[1] = line.entries[0];
+    line.entries[0] = key;
+  }
+
+  /**
+   * Gets the number of lookups performed
+   *
+   * @return The lookup count
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getLookupCount() const { return _lookupCount.load(std::memory_order_relaxed); }
+
+  /**
+   * Gets the number of lookups that found their hash
+   *
+   * @return The hit count
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getHitCount() const { return _hitCount.load(std::memory_order_relaxed); }
+
+  /**
+   * Gets the number of entries the cache can hold
+   *
+   * @return The entry count
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getEntryCount() const { return 2 * _lines.size(); }
+
+  /**
+   * Removes all entries and resets the counters
+   */
+  __JAFFAR_COMMON_INLINE__ void clear()
+  {
+    for (auto& line : _lines) line.entries[0] = line.entries[1] = _emptyEntry;
+    _lookupCount.store(0, std::memory_order_relaxed);
+    _hitCount.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  /**
+   * A cache line with two entries, the most recently used first. Two of them share a 64-byte hardware cache line
+   */
+  struct alignas(32) line_t
+  {
+    hash::hash_t entries[2];
+  };
+
+  /**
+   * Value of an empty entry
+   */
+  static constexpr hash::hash_t _emptyEntry = hash::hash_t(0, 0);
+
+  /**
+   * Adds one to a counter. Only the owning thread writes it, so a plain load and store suffice (other threads may read it)
+   *
+   * @param[in,out] counter The counter
+   */
+  static __JAFFAR_COMMON_INLINE__ void increment(std::atomic<size_t>& counter) { counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+  /**
+   * The cache lines
+   */
+  std::vector<line_t> _lines;
+
+  /**
+   * Mask turning a key word into a line index
+   */
+  size_t _lineMask;
+
+  /**
+   * Number of lookups
+   */
+  std::atomic<size_t> _lookupCount = 0;
+
+  /**
+   * Number of lookups that found their hash
+   */
+  std::atomic<size_t> _hitCount = 0;
+};
+
+/**
+ * Wraps a concurrent set of state hashes with a per-thread cache of recently seen hashes
+ *
+ * insert() and contains() first look in the calling thread's RecentHashCache, and only go to the shared set on a miss;
+ * any hash the shared set reports as present (or just inserted) is then cached. A cache hit means the hash is in the
+ * shared set, so answers are the same as the set's own (for sets that forget entries, like GenerationalHashSet, a hit
+ * may still report a hash evicted from the set moments ago as seen, and does not refresh it into the current
+ * generation). Any set whose insert() returns whether the key was new, either as a bool or as the second member of a
+ * pair (like HashSet_t), can be wrapped.
+ *
+ * @note Every thread needs an id below the maximum thread count at construction time. If the wrapped set is cleared, clear() must be called too
+ *
+ * @tparam Set The wrapped set type
+ */
+template <class Set>
+class CachedHashSet
+{
+public:
+  /**
+   * Constructor for the cached hash set
+   *
+   * @param[in] set The set to wrap
+   * @param[in] entriesPerThread The number of entries in every thread's cache
+   */
+  CachedHashSet(Set& set, const size_t entriesPerThread = 2048)
+    : _set(set)
+  {
+    const size_t threadCount = parallel::getMaxThreadCount();
+    for (size_t i = 0; i < threadCount; i++) _caches.push_back(std::make_unique<RecentHashCache>(entriesPerThread));
+  }
+
+  /**
+   * Inserts a hash into the wrapped set, unless the calling thread recently saw it there. Thread safe
+   *
+   * @param[in] key The hash to insert
+   * @return True, if the hash was inserted; false, if it was already present
+   */
+  __JAFFAR_COMMON_INLINE__ bool insert(const hash::hash_t& key)
+  {
+    RecentHashCache& cache = getCache();
+    if (cache.lookup(key) == true) return false;
+
+    bool inserted;
+    if constexpr (std::is_same<decltype(_set.insert(key)), bool>::value) inserted = _set.insert(key);
+    else inserted = _set.insert(key).second;
+
+    cache.add(key);
+    return inserted;
+  }
+
+  /**
+   * Checks whether a hash is in the wrapped set, looking first in the calling thread's cache. Thread safe
+   *
+   * @param[in] key The hash to look for
+   * @return True, if the hash is present; false, otherwise
+   */
+  __JAFFAR_COMMON_INLINE__ bool contains(const hash::hash_t& key)
+  {
+    RecentHashCache& cache = getCache();
+    if (cache.lookup(key) == true) return true;
+    if (_set.contains(key) == false) return false;
+    cache.add(key);
+    return true;
+  }
+
+  /**
+   * Gets the total number of cache lookups across threads
+   *
+   * @return The lookup count
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getLookupCount() const
+  {
+    size_t count = 0;
+    for (const auto& cache : _caches) count += cache->getLookupCount();
+    return count;
+  }
+
+  /**
+   * Gets the total number of cache hits (lookups answered without the shared set) across threads
+   *
+   * @return The hit count
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getHitCount() const
+  {
+    size_t count = 0;
+    for (const auto& cache : _caches) count += cache->getHitCount();
+    return count;
+  }
+
+  /**
+   * Gets the share of lookups answered by the caches
+   *
+   * @return The hit rate, between 0 and 1 (0 if there were no lookups)
+   */
+  __JAFFAR_COMMON_INLINE__ double getHitRate() const
+  {
+    const size_t lookups = getLookupCount();
+    return lookups == 0 ? 0.0 : (double)getHitCount() / (double)lookups;
+  }
+
+  /**
+   * Empties all caches and resets their counters
+   *
+   * @note This is not a thread safe operation
+   */
+  __JAFFAR_COMMON_INLINE__ void clear()
+  {
+    for (auto& cache : _caches) cache->clear();
+  }
+
+private:
+  /**
+   * Gets the calling thread's cache
+   *
+   * @return The cache
+   */
+  __JAFFAR_COMMON_INLINE__ RecentHashCache& getCache()
+  {
+    const size_t threadId = parallel::getThreadId();
+    if (threadId >= _caches.size()) JAFFAR_THROW_LOGIC("Thread id %lu exceeds the number of recent hash caches (%lu)", threadId, _caches.size());
+    return *_caches[threadId];
+  }
+
+  /**
+   * The wrapped set
+   */
+  Set& _set;
+
+  /**
+   * The per-thread caches (cache-line aligned, so the counters written by one thread do not share a line with another's)
+   */
+  std::vector<std::unique_ptr<RecentHashCache>> _caches;
+};
+
+/**
+ * A work queue that only accepts states whose hash was never pushed before (fused insert-if-absent and enqueue)
+ *
+ * Usually a new state costs two synchronized operations (an insert into the visited set and, if it was new, a push to
+ * a queue), and the queue is a separate contended structure. Here the visited set is a HashSet (no locks) and the
+ * queue is a fixed-capacity array:
+ *
+ * - A push first looks its hash up, so a state seen before (the common case) returns right away without writing any
+ *   shared memory.
+ * - Otherwise it claims a queue position (a CAS on the tail that never goes past the capacity) and only then inserts
+ *   the hash, so a full queue throws before the state is marked as seen. If the insert finds the hash already there
+ *   (another thread pushed it since the lookup), the claimed position is flagged as empty and consumers skip it.
+ * - A new state is written in place and flagged as ready.
+ *
+ * pushBatch() claims the positions of all the batch's unseen states with a single CAS, leaving the hash slot CAS as
+ * the only synchronization per new state. Its new elements take the first claimed positions, and the ones left over
+ * (hashes repeated within the batch or pushed meanwhile by others) are flagged as empty.
+ *
+ * Elements can be popped while others are still being pushed: a consumer claims positions up to the tail and waits
+ * for the (few cycles of) writing still in progress on any of them.
+ *
+ * @note The queue capacity is fixed at construction; clearQueue() empties it (e.g., between search steps) while the
+ *       set keeps remembering every pushed hash. Positions left empty count towards the capacity
+ *
+ * @tparam T The element type (trivially copyable)
+ */
+template <class T>
+class DedupQueue
+{
+  static_assert(std::is_trivially_copyable<T>::value, "Queue elements must be trivially copyable");
+
+public:
+  /**
+   * Constructor for the deduplicating queue
+   *
+   * @param[in] setCapacity The minimum number of slots of the visited set (see HashSet)
+   * @param[in] queueCapacity The maximum number of elements pushed between calls to clearQueue()
+   */
+  DedupQueue(const size_t setCapacity, const size_t queueCapacity)
+    : _set(setCapacity),
+      _queueCapacity(queueCapacity)
+  {
+    if (queueCapacity == 0) JAFFAR_THROW_LOGIC("The queue capacity must be a positive number");
+    _elements = (T*)malloc(queueCapacity * sizeof(T));
+    _ready    = (uint8_t*)calloc(queueCapacity, sizeof(uint8_t));
+    if (_elements == nullptr || _ready == nullptr) JAFFAR_THROW_RUNTIME("Could not allocate a queue of %lu elements", queueCapacity);
+  }
+
+  ~DedupQueue()
+  {
+    free(_elements);
+    free(_ready);
+  }
+
+  DedupQueue(const DedupQueue&)            = delete;
+  DedupQueue& operator=(const DedupQueue&) = delete;
+
+  /**
+   * Enqueues an element, unless its hash was pushed before. Thread safe (may wait on a set slot another thread is still writing)
+   *
+   * @param[in] key The element's hash
+   * @param[in] element The element
+   * @return True, if the element was new and got enqueued; false, if its hash was already seen
+   */
+  __JAFFAR_COMMON_INLINE__ bool push(const hash::hash_t& key, const T& element)
+  {
+    if (_set.contains(key) == true) return false;
+
+    const size_t position = claimPositions(1);
+    bool         inserted;
+    try
+    {
+      inserted = _set.insert(key);
+    }
+    catch (...)
+    {
+      // The set is full: the claimed position must not stay pending, or consumers would wait on it forever
+      storeEmpty(position, 1);
+      throw;
+    }
+
+    if (inserted == false)
+    {
+      storeEmpty(position, 1);
+      return false;
+    }
+
+    store(position, element);
+    return true;
+  }
+
+  /**
+   * Enqueues the elements of a batch whose hashes were never pushed before, claiming all their queue positions at once. Thread safe
+   *
+   * @param[in] keys The elements' hashes
+   * @param[in] elements The elements
+   * @param[in] count The number of elements
+   * @param[out] wasNew Storage for the count results (true, if the corresponding element got enqueued). May be nullptr
+   * @return The number of elements enqueued
+   */
+  __JAFFAR_COMMON_INLINE__ size_t pushBatch(const hash::hash_t* keys, const T* elements, const size_t count, bool* wasNew = nullptr)
+  {
+    // Scratch space for the unseen elements' indices, kept across calls so that batches do not allocate
+    thread_local std::vector<size_t> unseenIndices;
+    unseenIndices.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+      if (_set.contains(keys[i]) == false) unseenIndices.push_back(i);
+      if (wasNew != nullptr) wasNew[i] = false;
+    }
+
+    if (unseenIndices.empty()) return 0;
+    const size_t position = claimPositions(unseenIndices.size());
+    size_t       newCount = 0;
+    try
+    {
+      for (const size_t i : unseenIndices)
+        if (_set.insert(keys[i]) == true)
+        {
+          store(position + newCount++, elements[i]);
+          if (wasNew != nullptr) wasNew[i] = true;
+        }
+    }
+    catch (...)
+    {
+      // The set is full: the positions not written must not stay pending, or consumers would wait on them forever
+      storeEmpty(position + newCount, unseenIndices.size() - newCount);
+      throw;
+    }
+
+    if (newCount < unseenIndices.size()) storeEmpty(position + newCount, unseenIndices.size() - newCount);
+    return newCount;
+  }
+
+  /**
+   * Claims up to maxCount elements from the front of the queue, in push order. Thread safe (may wait on positions still being pushed)
+   *
+   * @param[out] elements Destination buffer; room for at least maxCount elements
+   * @param[in] maxCount Maximum number of elements to claim
+   * @return The number of elements actually claimed (0 if empty)
+   */
+  __JAFFAR_COMMON_INLINE__ size_t pop_front_get_batch(T* elements, const size_t maxCount)
+  {
+    // Claiming again as long as empty positions keep the batch short
+    size_t popped = 0;
+    while (popped < maxCount)
+    {
+      size_t head = _head.load(std::memory_order_relaxed);
+      size_t take;
+      do {
+        const size_t tail = _tail.load(std::memory_order_acquire);
+        if (head >= tail) return popped;
+        take = std::min(maxCount - popped, tail - head);
+      } while (_head.compare_exchange_weak(head, head + take, std::memory_order_relaxed) == false);
+
+      // Waiting for pushes that claimed these positions but are still writing them (pausing, then yielding, in case
+      // a pusher was preempted)
+      for (size_t i = 0; i < take; i++)
+      {
+        std::atomic_ref<uint8_t> ready(_ready[head + i]);
+        uint8_t                  state;
+        for (size_t spins = 0; (state = ready.load(std::memory_order_acquire)) == _pendingState; spins++)
+        {
+          if (spins < 64)
+          {
+#if defined(__x86_64__)
+            __builtin_ia32_pause();
+#endif
+          }
+          else std::this_thread::yield();
+        }
+        if (state == _readyState) elements[popped++] = _elements[head + i];
+      }
+    }
+    return popped;
+  }
+
+  /**
+   * Claims a single element from the front of the queue. Thread safe (may wait on a position still being pushed)
+   *
+   * @param[out] element Storage for the claimed element
+   * @return True if an element was claimed; false if empty
+   */
+  __JAFFAR_COMMON_INLINE__ bool pop_front_get(T& element) { return pop_front_get_batch(&element, 1) == 1; }
+
+  /**
+   * Checks whether a hash was ever pushed. Thread safe (may wait on a set slot another thread is still writing)
+   *
+   * @param[in] key The hash to look for
+   * @return True, if the hash was pushed; false, otherwise
+   */
+  __JAFFAR_COMMON_INLINE__ bool contains(const hash::hash_t& key) const { return _set.contains(key); }
+
+  /**
+   * Number of positions not yet claimed, at the time of checking. Safe to call concurrently
+   *
+   * @return The number of positions not yet claimed at the moment of the call (including any left empty)
+   */
+  __JAFFAR_COMMON_INLINE__ size_t wasSize() const
+  {
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    const size_t head = _head.load(std::memory_order_relaxed);
+    return head >= tail ? 0 : tail - head;
+  }
+
+  /**
+   * Number of elements enqueued since the last clearQueue()
+   *
+   * @return The number of enqueued elements
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getEnqueuedCount() const { return _tail.load(std::memory_order_relaxed) - _emptyCount.load(std::memory_order_relaxed); }
+
+  /**
+   * Empties the queue, keeping the set of seen hashes
+   *
+   * @note This is not a thread safe operation
+   */
+  __JAFFAR_COMMON_INLINE__ void clearQueue()
+  {
+    memset(_ready, _pendingState, _tail.load(std::memory_order_relaxed) * sizeof(uint8_t));
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+    _emptyCount.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  /**
+   * Position state: claimed (or not yet), but not written
+   */
+  static constexpr uint8_t _pendingState = 0;
+
+  /**
+   * Position state: holds an element
+   */
+  static constexpr uint8_t _readyState = 1;
+
+  /**
+   * Position state: left empty, to be skipped by consumers
+   */
+  static constexpr uint8_t _emptyState = 2;
+
+  /**
+   * Claims consecutive queue positions, only if they all fit in the capacity
+   *
+   * @param[in] count The number of positions
+   * @return The first claimed position
+   */
+  __JAFFAR_COMMON_INLINE__ size_t claimPositions(const size_t count)
+  {
+    size_t position = _tail.load(std::memory_order_relaxed);
+    do {
+      if (position + count > _queueCapacity) JAFFAR_THROW_RUNTIME("Deduplicating queue is full (capacity: %lu)", _queueCapacity);
+    } while (_tail.compare_exchange_weak(position, position + count, std::memory_order_relaxed, std::memory_order_relaxed) == false);
+    return position;
+  }
+
+  /**
+   * Writes an element at a claimed position and flags it as ready for consumers
+   *
+   * @param[in] position The claimed position
+   * @param[in] element The element
+   */
+  __JAFFAR_COMMON_INLINE__ void store(const size_t position, const T& element)
+  {
+    _elements[position] = element;
+    std::atomic_ref<uint8_t>(_ready[position]).store(_readyState, std::memory_order_release);
+  }
+
+  /**
+   * Flags claimed positions as empty, for consumers to skip
+   *
+   * @param[in] position The first claimed position
+   * @param[in] count The number of positions
+   */
+  __JAFFAR_COMMON_INLINE__ void storeEmpty(const size_t position, const size_t count)
+  {
+    _emptyCount.fetch_add(count, std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) std::atomic_ref<uint8_t>(_ready[position + i]).store(_emptyState, std::memory_order_release);
+  }
+
+  /**
+   * The set of every hash ever pushed
+   */
+  HashSet _set;
+
+  /**
+   * Maximum number of elements between calls to clearQueue()
+   */
+  const size_t _queueCapacity;
+
+  /**
+   * The queued elements, in claim order
+   */
+  T* _elements;
+
+  /**
+   * Per-position states telling whether the element has been written, or the position was left empty
+   */
+  uint8_t* _ready;
+
+  /**
+   * Next position to pop
+   */
+  std::atomic<size_t> _head = 0;
+
+  /**
+   * Next position to claim for a push (never beyond the capacity)
+   */
+  std::atomic<size_t> _tail = 0;
+
+  /**
+   * Number of claimed positions left empty since the last clearQueue()
+   */
+  std::atomic<size_t> _emptyCount = 0;
+};
+
+/**
+ * Definition for a concurrent multimap. It enables concurrent inserts and queries
+ */
+template <class K, class V, class C = std::greater<K>>
+using concurrentMultimap_t = oneapi::tbb::concurrent_multimap<K, V, C>;
+
+/**
+ * A relaxed concurrent priority queue (MultiQueue), for best-first extraction that scales with the number of threads
+ *
+ * concurrentMultimap_t keeps a single ordered skip list, so every pop from its front contends on the same nodes, and
+ * every insert allocates a node. Here the elements are spread over c x threads sequential binary heaps (flat vectors),
+ * each behind its own spin lock:
+ *
+ * - An insert goes to a random heap (another one, if that heap is locked).
+ * - A pop looks at the tops of two random heaps (cached outside their locks) and takes the better one.
+ *
+ * A pop may therefore not return the very best element, but one close to it: the expected rank error grows linearly
+ * with the number of heaps, so the relaxation factor c trades ordering quality for lower contention. A batched pop
+ * takes several elements from the chosen heap under one lock, which is cheaper still but relaxes the order further.
+ *
+ * @tparam K The priority (key) type; must be trivially copyable, as the heap tops are read without locking
+ * @tparam V The element type
+ * @tparam C The ordering: keys that come first in it are popped first (as with concurrentMultimap_t, the greatest key by default)
+ */
+template <class K, class V, class C = std::greater<K>>
+class MultiQueue
+{
+public:
+  /**
+   * Constructor for the MultiQueue
+   *
+   * @param[in] relaxationFactor The number of heaps per thread (c). Higher values lower contention but loosen the ordering
+   * @param[in] threadCount The number of threads expected to use the queue
+   */
+  MultiQueue(const size_t relaxationFactor = 2, const size_t threadCount = parallel::getMaxThreadCount())
+    : _heaps(std::max((size_t)1, relaxationFactor * threadCount))
+  {
+    if (relaxationFactor == 0) JAFFAR_THROW_LOGIC("The MultiQueue relaxation factor must be at least 1");
+  }
+
+  MultiQueue(const MultiQueue&)            = delete;
+  MultiQueue& operator=(const MultiQueue&) = delete;
+
+  /**
+   * Inserts an element
+   *
+   * @note This is a thread safe operation
+   *
+   * @param[in] key The element's priority
+   * @param[in] value The element
+   */
+  __JAFFAR_COMMON_INLINE__ void push(const K& key, const V& value)
+  {
+    // Trying random heaps until one is free, then waiting on the last one picked
+    size_t index  = random() % _heaps.size();
+    bool   locked = _heaps[index].lock.try_lock();
+    for (size_t attempt = 1; attempt < _heaps.size() && locked == false; attempt++)
+    {
+      index  = random() % _heaps.size();
+      locked = _heaps[index].lock.try_lock();
+    }
+    if (locked == false) _heaps[index].lock.lock();
+
+    auto& heap = _heaps[index];
+    heap.elements.emplace_back(key, value);
+    std::push_heap(heap.elements.begin(), heap.elements.end(), _heapCompare);
+    publishTop(heap);
+    heap.lock.unlock();
+  }
+
+  /**
+   * Pops a high-priority element: the better of the tops of two random heaps
+   *
+   * @note This is a thread safe operation
+   *
+   * @param[out] key The priority of the element popped
+   * @param[out] value The element popped
+   * @return True, if an element was popped; false, if the queue was found empty
+   */
+  __JAFFAR_COMMON_INLINE__ bool pop(K& key, V& value) { return pop_batch(&key, &value, 1) == 1; }
+
+  /**
+   * Pops up to maxCount high-priority elements in a row from the better of two random heaps, under a single lock
+   *
+   * @note This is a thread safe operation
+   *
+   * @param[out] keys Storage for the priorities of the popped elements (in popping order)
+   * @param[out] values Storage for the popped elements
+   * @param[in] maxCount The maximum number of elements to pop
+   * @return The number of elements popped (0 if the queue was found empty)
+   */
+  __JAFFAR_COMMON_INLINE__ size_t pop_batch(K* keys, V* values, const size_t maxCount)
+  {
+    if (maxCount == 0) return 0;
+
+    size_t emptyRounds = 0;
+    while (true)
+    {
+      // Choosing the better top among two random heaps
+      size_t       index         = random() % _heaps.size();
+      const size_t other         = random() % _heaps.size();
+      bool         isFull        = _heaps[index].size.load(std::memory_order_relaxed) > 0;
+      const bool   isOtherFull   = _heaps[other].size.load(std::memory_order_relaxed) > 0;
+      const bool   isOtherBetter = isFull == false || _compare(_heaps[other].top.load(std::memory_order_relaxed), _heaps[index].top.load(std::memory_order_relaxed));
+      if (isOtherFull && isOtherBetter) index = other, isFull = true;
+
+      // After a few empty picks, looking for any non-empty heap, and giving up if there is none
+      if (isFull == false)
+      {
+        if (++emptyRounds < _emptyRoundsBeforeScan) continue;
+        emptyRounds = 0;
+        index       = findNonEmptyHeap();
+        if (index == _heaps.size()) return 0;
+      }
+
+      auto& heap = _heaps[index];
+      if (heap.lock.try_lock() == false) continue;
+
+      size_t count = 0;
+      for (; count < maxCount && heap.elements.empty() == false; count++)
+      {
+        std::pop_heap(heap.elements.begin(), heap.elements.end(), _heapCompare);
+        keys[count]   = heap.elements.back().first;
+        values[count] = heap.elements.back().second;
+        heap.elements.pop_back();
+      }
+      publishTop(heap);
+      heap.lock.unlock();
+
+      if (count > 0) return count;
+    }
+  }
+
+  /**
+   * Retrieves the number of elements in the queue at the time of checking
+   *
+   * @note Safe to call concurrently (the result may be momentarily stale)
+   * @return The number of elements
+   */
+  __JAFFAR_COMMON_INLINE__ size_t wasSize() const
+  {
+    size_t size = 0;
+    for (const auto& heap : _heaps) size += heap.size.load(std::memory_order_relaxed);
+    return size;
+  }
+
+  /**
+   * Gets the number of heaps the elements are spread over
+   *
+   * @return The heap count
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getHeapCount() const { return _heaps.size(); }
+
+private:
+  static_assert(std::is_trivially_copyable_v<K>, "The MultiQueue key type must be trivially copyable");
+
+  /**
+   * A sequential heap, with its size and top key published for lock-free peeking, on its own cache lines
+   */
+  struct alignas(64) heap_t
+  {
+    SpinLock                     lock;
+    std::vector<std::pair<K, V>> elements;
+    std::atomic<size_t>          size = 0;
+    std::atomic<K>               top{};
+  };
+
+  /**
+   * Number of picks that found two empty heaps before scanning all of them
+   */
+  static constexpr size_t _emptyRoundsBeforeScan = 4;
+
+  /**
+   * Publishes a heap's size and top key, after a change. Must be called with the heap locked
+   *
+   * @param[in] heap The heap
+   */
+  __JAFFAR_COMMON_INLINE__ void publishTop(heap_t& heap)
+  {
+    if (heap.elements.empty() == false) heap.top.store(heap.elements.front().first, std::memory_order_relaxed);
+    heap.size.store(heap.elements.size(), std::memory_order_relaxed);
+  }
+
+  /**
+   * Looks for a non-empty heap, starting at a random one
+   *
+   * @return The heap's index, or the heap count if all were empty
+   */
+  __JAFFAR_COMMON_INLINE__ size_t findNonEmptyHeap()
+  {
+    const size_t start = random() % _heaps.size();
+    for (size_t i = 0; i < _heaps.size(); i++)
+    {
+      const size_t index = (start + i) % _heaps.size();
+      if (_heaps[index].size.load(std::memory_order_relaxed) > 0) return index;
+    }
+    return _heaps.size();
+  }
+
+  /**
+   * Per-thread xorshift64* generator for picking heaps
+   *
+   * @return A random number
+   */
+  static __JAFFAR_COMMON_INLINE__ uint64_t random()
+  {
+    static thread_local uint64_t state = 0x9E3779B97F4A7C15ull ^ (uint64_t)(uintptr_t)&state;
+    state ^= state >> 12, state ^= state << 25, state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1Dull;
+  }
+
+  /**
+   * The heap ordering derived from the key ordering, so that a heap's top is its key that comes first
+   */
+  struct heapCompare_t
+  {
+    C    compare;
+    bool operator()(const std::pair<K, V>& a, const std::pair<K, V>& b) const { return compare(b.first, a.first); }
+  };
+
+  /**
+   * The key ordering
+   */
+  C _compare;
+
+  /**
+   * The heap ordering
+   */
+  heapCompare_t _heapCompare;
+
+  /**
+   * The heaps
+   */
+  std::vector<heap_t> _heaps;
+};
+
+/**
+ * A concurrent bucket queue, for elements whose priority is an integer in a bounded range (e.g., quantized rewards)
+ *
+ * A comparison-based container pays for a full ordering of the elements. Here, every priority has its own bucket,
+ * so a push costs a fetch_add on the bucket's tail and a pop a CAS on its head, and finding the highest non-empty
+ * bucket does not depend on the number of elements:
+ *
+ * - Buckets are lock-free append arrays. Their storage is a list of segments of doubling sizes, installed on demand,
+ *   so memory follows the number of elements pushed. Every slot carries the epoch (see clear()) in which it was
+ *   written, which tells a pop whether the push that claimed the slot has finished writing it.
+ * - In the default mode, a two-level atomic bitmap tracks the non-empty buckets: the top is found with two
+ *   count-leading-zeros on its summary word and on the word it points to (one summary word covers 4096 buckets).
+ *   A bit may stay set for an empty bucket (the pop that finds it empty clears it), but is never missing for a
+ *   non-empty one: both pushes and the pops that clear bits re-check the other side afterwards.
+ * - In monotone mode, meant for searches where pushes rarely go above the priority being popped, the bitmap is not
+ *   kept: pops walk a cursor down from the highest priority pushed, and a push only touches the cursor when it goes
+ *   above it. Pushes above the cursor remain correct, just slower.
+ *
+ * Within a bucket, elements come out in the order their pushes were claimed.
+ *
+ * @note Storage is only given back by release(); clear() keeps the segments for the next use
+ */
+template <class T>
+class BucketQueue
+{
+public:
+  /**
+   * Constructor for the bucket queue
+   *
+   * @param[in] bucketCount The number of priorities: valid priorities go from 0 to bucketCount - 1 (highest, popped first)
+   * @param[in] monotone Whether to use the cursor (monotone mode) instead of the bitmap to find the highest non-empty bucket
+   */
+  BucketQueue(const size_t bucketCount, const bool monotone = false)
+    : _buckets(bucketCount),
+      _bitmap((bucketCount + 63) / 64),
+      _summary((_bitmap.size() + 63) / 64),
+      _monotone(monotone)
+  {
+    if (bucketCount == 0) JAFFAR_THROW_LOGIC("The bucket queue needs at least one bucket");
+  }
+
+  ~BucketQueue() { release(); }
+
+  BucketQueue(const BucketQueue&)            = delete;
+  BucketQueue& operator=(const BucketQueue&) = delete;
+
+  /**
+   * Pushes an element with a given priority
+   *
+   * @note This is a lock-free, thread safe operation
+   *
+   * @param[in] priority The element's priority (0 to bucketCount - 1)
+   * @param[in] element The element
+   */
+  __JAFFAR_COMMON_INLINE__ void push(const size_t priority, const T& element)
+  {
+    if (priority >= _buckets.size()) JAFFAR_THROW_LOGIC("Priority %lu is out of the bucket queue's range (0 to %lu)", priority, _buckets.size() - 1);
+
+    auto&        bucket   = _buckets[priority];
+    const size_t position = bucket.tail.fetch_add(1, std::memory_order_seq_cst);
+    slot_t&      slot     = getSlot(bucket, position, true);
+    slot.element          = element;
+    std::atomic_ref<uint32_t>(slot.epoch).store(_epoch, std::memory_order_release);
+
+    // Announcing the bucket after the tail increment, so a pop that has just found it empty either sees the element or gets announced to
+    if (_monotone == true) raiseCursor(priority);
+    else markNonEmpty(priority);
+  }
+
+  /**
+   * Pops an element from the highest non-empty priority
+   *
+   * @note This is a lock-free, thread safe operation
+   *
+   * @param[out] element The element popped
+   * @param[out] priority The priority of the element popped
+   * @return True, if an element was popped; false, if the queue was found empty
+   */
+  __JAFFAR_COMMON_INLINE__ bool pop(T& element, size_t& priority) { return pop_batch(&element, 1, priority) == 1; }
+
+  /**
+   * Pops up to maxCount elements from the highest non-empty priority with a single claim, copying them into the
+   * provided buffer (all of them have the same priority)
+   *
+   * @note This is a lock-free, thread safe operation
+   *
+   * @param[out] elements Destination buffer; must have room for at least maxCount elements
+   * @param[in] maxCount Maximum number of elements to pop
+   * @param[out] priority The priority of the elements popped
+   * @return The number of elements popped (0 if the queue was found empty)
+   */
+  __JAFFAR_COMMON_INLINE__ size_t pop_batch(T* elements, const size_t maxCount, size_t& priority)
+  {
+    if (maxCount == 0) return 0;
+
+    while (true)
+    {
+      const size_t top = _monotone ? _cursor.load(std::memory_order_seq_cst) : findTop();
+      if (top == _noBucket) return 0;
+
+      const size_t count = popFromBucket(top, elements, maxCount);
+      if (count > 0)
+      {
+        priority = top;
+        return count;
+      }
+
+      // The bucket was empty: moving on to the next one down
+      if (_monotone == true)
+      {
+        if (top == 0) return 0;
+        size_t expected = top;
+        if (_cursor.compare_exchange_strong(expected, top - 1, std::memory_order_seq_cst) == true && isNonEmpty(_buckets[top])) raiseCursor(top);
+      }
+      else
+        markEmpty(top);
+    }
+  }
+
+  /**
+   * Retrieves the number of elements in the queue at the time of checking
+   *
+   * @note Safe to call concurrently (the result may be momentarily stale)
+   * @return The number of elements
+   */
+  __JAFFAR_COMMON_INLINE__ size_t wasSize() const
+  {
+    size_t size = 0;
+    for (const auto& bucket : _buckets)
+    {
+      const size_t head = bucket.head.load(std::memory_order_relaxed);
+      const size_t tail = bucket.tail.load(std::memory_order_relaxed);
+      size += tail > head ? tail - head : 0;
+    }
+    return size;
+  }
+
+  /**
+   * Gets the number of priorities
+   *
+   * @return The bucket count
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getBucketCount() const { return _buckets.size(); }
+
+  /**
+   * Empties the queue, keeping its storage for reuse
+   *
+   * @note This function is not thread safe and must not be called while the queue is in use
+   */
+  __JAFFAR_COMMON_INLINE__ void clear()
+  {
+    for (auto& bucket : _buckets)
+    {
+      bucket.head.store(0, std::memory_order_relaxed);
+      bucket.tail.store(0, std::memory_order_relaxed);
+    }
+    for (auto& word : _bitmap) word.store(0, std::memory_order_relaxed);
+    for (auto& word : _summary) word.store(0, std::memory_order_relaxed);
+    _cursor.store(0, std::memory_order_relaxed);
+
+    // Slots written before now no longer look ready; when the epoch counter wraps around, the slots must be zeroed instead
+    if (++_epoch == 0)
+    {
+      for (auto& bucket : _buckets)
+        for (size_t s = 0; s < _maxSegmentCount; s++)
+          if (bucket.segments[s] != nullptr) memset((void*)bucket.segments[s], 0, getSegmentSize(s) * sizeof(slot_t));
+      _epoch = 1;
+    }
+  }
+
+  /**
+   * Empties the queue and frees its storage
+   *
+   * @note This function is not thread safe and must not be called while the queue is in use
+   */
+  __JAFFAR_COMMON_INLINE__ void release()
+  {
+    clear();
+    for (auto& bucket : _buckets)
+      for (size_t s = 0; s < _maxSegmentCount; s++)
+      {
+        free(bucket.segments[s]);
+        bucket.segments[s] = nullptr;
+      }
+  }
+
+private:
+  static_assert(std::is_trivially_copyable_v<T>, "The bucket queue element type must be trivially copyable (slots are zero-allocated)");
+
+  /**
+   * A slot of a bucket: the element and the epoch in which it was written (0 = never)
+   */
+  struct slot_t
+  {
+    T        element;
+    uint32_t epoch;
+  };
+
+  /**
+   * Segment s holds 2^s times the first segment's elements, so a few dozen segments cover any bucket size
+   */
+  static constexpr size_t _firstSegmentBits = 6;
+  static constexpr size_t _maxSegmentCount  = 64 - _firstSegmentBits;
+
+  /**
+   * A bucket: claim counters on their own cache line, then the segment list
+   */
+  struct alignas(64) bucket_t
+  {
+    std::atomic<size_t> tail                       = 0;
+    std::atomic<size_t> head                       = 0;
+    slot_t*             segments[_maxSegmentCount] = {};
+  };
+
+  /**
+   * Marks the absence of a non-empty bucket
+   */
+  static constexpr size_t _noBucket = SIZE_MAX;
+
+  static __JAFFAR_COMMON_INLINE__ size_t getSegmentSize(const size_t segment) { return (size_t)1 << (_firstSegmentBits + segment); }
+
+  /**
+   * Finds the slot of a position in a bucket
+   *
+   * @param[in] bucket The bucket
+   * @param[in] position The position
+   * @param[in] install Whether to install the position's segment if it is not there yet (pushes); otherwise, waits for it (pops)
+   * @return The slot
+   */
+  __JAFFAR_COMMON_INLINE__ slot_t& getSlot(bucket_t& bucket, const size_t position, const bool install)
+  {
+    const size_t             segment = 63 - __builtin_clzll((position >> _firstSegmentBits) + 1);
+    const size_t             offset  = position - ((((size_t)1 << segment) - 1) << _firstSegmentBits);
+    std::atomic_ref<slot_t*> entry(bucket.segments[segment]);
+
+    slot_t* slots = entry.load(std::memory_order_acquire);
+    while (slots == nullptr && install == false)
+    {
+#if defined(__x86_64__)
+      __builtin_ia32_pause();
+#endif
+      slots = entry.load(std::memory_order_acquire);
+    }
+
+    if (slots == nullptr)
+    {
+      slot_t* fresh = (slot_t*)calloc(getSegmentSize(segment), sizeof(slot_t));
+      if (fresh == nullptr) JAFFAR_THROW_RUNTIME("Could not allocate a bucket segment of %lu elements", getSegmentSize(segment));
+      if (entry.compare_exchange_strong(slots, fresh, std::memory_order_acq_rel, std::memory_order_acquire) == true) slots = fresh;
+      else free(fresh);
+    }
+
+    return slots[offset];
+  }
+
+  /**
+   * Checks whether a bucket holds elements not yet claimed by a pop
+   *
+   * @param[in] bucket The bucket
+   * @return True, if it is non-empty; false, otherwise
+   */
+  static __JAFFAR_COMMON_INLINE__ bool isNonEmpty(const bucket_t& bucket)
+  {
+    return bucket.tail.load(std::memory_order_seq_cst) > bucket.head.load(std::memory_order_seq_cst);
+  }
+
+  /**
+   * Claims up to maxCount elements from a bucket and copies them out, waiting for pushes still writing them
+   *
+   * @param[in] priority The bucket
+   * @param[out] elements Destination buffer
+   * @param[in] maxCount Maximum number of elements to claim
+   * @return The number of elements popped (0 if the bucket was empty)
+   */
+  __JAFFAR_COMMON_INLINE__ size_t popFromBucket(const size_t priority, T* elements, const size_t maxCount)
+  {
+    auto&  bucket = _buckets[priority];
+    size_t head   = bucket.head.load(std::memory_order_relaxed);
+    size_t take;
+    do {
+      const size_t tail = bucket.tail.load(std::memory_order_acquire);
+      if (head >= tail) return 0;
+      take = std::min(maxCount, tail - head);
+    } while (bucket.head.compare_exchange_weak(head, head + take, std::memory_order_acq_rel, std::memory_order_relaxed) == false);
+
+    for (size_t i = 0; i < take; i++)
+    {
+      slot_t&                   slot = getSlot(bucket, head + i, false);
+      std::atomic_ref<uint32_t> epoch(slot.epoch);
+      while (epoch.load(std::memory_order_acquire) != _epoch)
+      {
+#if defined(__x86_64__)
+        __builtin_ia32_pause();
+#endif
+      }
+      elements[i] = slot.element;
+    }
+    return take;
+  }
+
+  /**
+   * Sets a bucket's bit (and its word's summary bit), unless already set
+   *
+   * @param[in] priority The bucket
+   */
+  __JAFFAR_COMMON_INLINE__ void markNonEmpty(const size_t priority)
+  {
+    const size_t   word = priority / 64;
+    const uint64_t bit  = (uint64_t)1 << (priority % 64);
+    if ((_bitmap[word].load(std::memory_order_seq_cst) & bit) == 0) _bitmap[word].fetch_or(bit, std::memory_order_seq_cst);
+
+    const uint64_t summaryBit = (uint64_t)1 << (word % 64);
+    if ((_summary[word / 64].load(std::memory_order_seq_cst) & summaryBit) == 0) _summary[word / 64].fetch_or(summaryBit, std::memory_order_seq_cst);
+  }
+
+  /**
+   * Clears the bit of a bucket found empty, then sets it back if a push got in meanwhile
+   *
+   * @param[in] priority The bucket
+   */
+  __JAFFAR_COMMON_INLINE__ void markEmpty(const size_t priority)
+  {
+    _bitmap[priority / 64].fetch_and(~((uint64_t)1 << (priority % 64)), std::memory_order_seq_cst);
+    if (isNonEmpty(_buckets[priority])) markNonEmpty(priority);
+  }
+
+  /**
+   * Finds the highest bucket marked as non-empty, clearing the summary bits of words found all clear on the way
+   *
+   * @return The bucket, or _noBucket if none is marked
+   */
+  __JAFFAR_COMMON_INLINE__ size_t findTop()
+  {
+    for (size_t s = _summary.size(); s-- > 0;)
+    {
+      uint64_t summary = _summary[s].load(std::memory_order_seq_cst);
+      while (summary != 0)
+      {
+        const size_t   word = s * 64 + 63 - __builtin_clzll(summary);
+        const uint64_t bits = _bitmap[word].load(std::memory_order_seq_cst);
+        if (bits != 0) return word * 64 + 63 - __builtin_clzll(bits);
+
+        // Clearing the stale summary bit, then setting it back if a bucket of the word got marked meanwhile
+        const uint64_t summaryBit = (uint64_t)1 << (word % 64);
+        _summary[s].fetch_and(~summaryBit, std::memory_order_seq_cst);
+        if (_bitmap[word].load(std::memory_order_seq_cst) != 0) _summary[s].fetch_or(summaryBit, std::memory_order_seq_cst);
+        summary &= ~summaryBit;
+      }
+    }
+    return _noBucket;
+  }
+
+  /**
+   * Raises the cursor to a priority, if it is below it (monotone mode)
+   *
+   * @param[in] priority The priority
+   */
+  __JAFFAR_COMMON_INLINE__ void raiseCursor(const size_t priority)
+  {
+    size_t cursor = _cursor.load(std::memory_order_seq_cst);
+    while (cursor < priority && _cursor.compare_exchange_weak(cursor, priority, std::memory_order_seq_cst) == false);
+  }
+
+  /**
+   * The buckets, one per priority
+   */
+  std::vector<bucket_t> _buckets;
+
+  /**
+   * One bit per bucket, set if it may be non-empty (default mode)
+   */
+  std::vector<std::atomic<uint64_t>> _bitmap;
+
+  /**
+   * One bit per bitmap word, set if it may be non-zero (default mode)
+   */
+  std::vector<std::atomic<uint64_t>> _summary;
+
+  /**
+   * Whether the queue works in monotone mode
+   */
+  const bool _monotone;
+
+  /**
+   * Upper bound of the highest non-empty bucket (monotone mode)
+   */
+  alignas(64) std::atomic<size_t> _cursor = 0;
+
+  /**
+   * Current epoch: slots written in an earlier one are not ready
+   */
+  uint32_t _epoch = 1;
+};
+
+/**
+ * This implementation of a concurrent doble-ended queue class was created specifically for Jaffar's engine
+ * It allows for lock-free front and back push, pop, and pop_get operations
+ * It uses a single mutex to coordinate access. This could theoretically be improved, but for the time being seems to suffice
+ */
+template <class T>
+class Deque
+{
+public:
+  Deque()  = default;
+  ~Deque() = default;
+
+  /**
+   * Gets access to the internal Deque storage
+   * @return A reference to the internal Deque storage
+   */
+  __JAFFAR_COMMON_INLINE__ auto& getInternalStorage() { return _internalDeque; }
+
+  /**
+   * Pushes an element to the back of the deque without any locking protection
+   *
+   * @note This is not a thread safe operation
+   *
+   * @param[in] element The input element to push
+   */
+  __JAFFAR_COMMON_INLINE__ void push_back_no_lock(T element)
+  {
+    _internalDeque.push_back(element);
+    _size.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Pushes an element to the back of the deque with locking protection
+   *
+   * @note This is a thread safe operation
+   *
+   * @param[in] element The input element to push
+   */
+  __JAFFAR_COMMON_INLINE__ void push_back(T element)
+  {
+    _mutex.lock();
+    _internalDeque.push_back(element);
+    _size.fetch_add(1, std::memory_order_relaxed);
+    _mutex.unlock();
+  }
+
+  /**
+   * Pushes an element to the front of the deque without any locking protection
+   *
+   * @note This is not a thread safe operation
+   *
+   * @param[in] element The input element to push
+   */
+  __JAFFAR_COMMON_INLINE__ void push_front_no_lock(T element)
+  {
+    _internalDeque.push_front(element);
+    _size.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Pushes an element to the front of the deque with locking protection
+   *
+   * @note This is a thread safe operation
+   *
+   * @param[in] element The input element to push
+   */
+  __JAFFAR_COMMON_INLINE__ void push_front(T element)
+  {
+    _mutex.lock();
+    _internalDeque.push_front(element);
+    _size.fetch_add(1, std::memory_order_relaxed);
+    _mutex.unlock();
+  }
+
+  /**
+   * Gets the element at the front of the Deque
+   *
+   * @note This is not a thread safe operation
+   * @note This operation does not check for an empty container and might produce unexpected behaviour if ran with an empty container
+   *
+   * @return The element at the front of the Deque
+   */
+  __JAFFAR_COMMON_INLINE__ T front() const { return _internalDeque.front(); }
+
+  /**
+   * Gets the element at the back of the Deque
+   *
+   * @note This is not a thread safe operation
+   * @note This operation does not check for an empty container and might produce unexpected behaviour if ran with an empty container
+   *
+   * @return The element at the back of the Deque
+   */
+  __JAFFAR_COMMON_INLINE__ T back() const { return _internalDeque.back(); }
+
+  /**
+   * Pops (removes) the element at the front of the Deque
+   *
+   * @note This is a thread safe operation
+   * @note This operation does not check for an empty container and might produce unexpected behaviour if ran with an empty container
+   */
+  __JAFFAR_COMMON_INLINE__ void pop_front()
+  {
+    _mutex.lock();
+    _internalDeque.pop_front();
+    _size.fetch_sub(1, std::memory_order_relaxed);
+    _mutex.unlock();
+  }
+
+  /**
+   * Pops (removes) the element at the back of the Deque
+   *
+   * @note This is a thread safe operation
+   * @note This operation does not check for an empty container and might produce unexpected behaviour if ran with an empty container
+   */
+  __JAFFAR_COMMON_INLINE__ void pop_back()
+  {
+    _mutex.lock();
+    _internalDeque.pop_back();
+    _size.fetch_sub(1, std::memory_order_relaxed);
+    _mutex.unlock();
+  }
+
+  /**
+   * Pops (removes) the element at the back of the Deque and retrieves it
+   *
+   * @note This is a thread safe operation
+   * @param[out] element A reference to the storage to save the element into
+   * @return True, if the operation was successful; false, if the Deque was empty
+   */
+  __JAFFAR_COMMON_INLINE__ bool pop_back_get(T& element)
+  {
+    _mutex.lock();
+
+    if (_internalDeque.empty())
+    {
+      _mutex.unlock();
+      return false;
+    }
+
+    element = _internalDeque.back();
+    _internalDeque.pop_back();
+    _size.fetch_sub(1, std::memory_order_relaxed);
+
+    _mutex.unlock();
+    return true;
+  }
+
+  /**
+   * Pops (removes) the element at the front of the Deque and retrieves it
+   *
+   * @note This is a thread safe operation
+   * @param[out] element A reference to the storage to save the element into
+   * @return True, if the operation was successful; false, if the Deque was empty
+   */
+  __JAFFAR_COMMON_INLINE__ bool pop_front_get(T& element)
+  {
+    _mutex.lock();
+
+    if (_internalDeque.empty())
+    {
+      _mutex.unlock();
+      return false;
+    }
+
+    element = _internalDeque.front();
+    _internalDeque.pop_front();
+    _size.fetch_sub(1, std::memory_order_relaxed);
+
+    _mutex.unlock();
+    return true;
+  }
+
+  /**
+   * Pops (removes) up to maxCount elements from the front of the Deque under a single lock
+   * acquisition, copying them into the provided buffer in front-to-back order.
+   *
+   * @note This is a thread safe operation.
+   *
+   * Batching amortizes the mutex cost across many elements. Under heavy multi-consumer contention
+   * (dozens of threads each pulling one element at a time, as the Jaffar engine does when the
+   * per-element work is cheap) the lock/unlock pair -- not the pop itself -- dominates wall time.
+   * Grabbing a run of elements per lock cuts lock-acquisition traffic by up to maxCount.
+   *
+   * @param[out] elements Destination buffer; must have room for at least maxCount elements
+   * @param[in] maxCount Maximum number of elements to pop
+   * @return The number of elements actually popped (0 if the Deque was empty)
+   */
+  __JAFFAR_COMMON_INLINE__ size_t pop_front_get_batch(T* elements, const size_t maxCount)
+  {
+    _mutex.lock();
+
+    size_t count = 0;
     while (count < maxCount && _internalDeque.empty() == false)
     {
-      elements[count++] = _internalDeque.front();
-      _internalDeque.pop_front();
+      elements[count++] = _internalDeque.front();
+      _internalDeque.pop_front();
+    }
+    if (count > 0) _size.fetch_sub(count, std::memory_order_relaxed);
+
+    _mutex.unlock();
+    return count;
+  }
+
+  /**
+   * Retrieves the size of the container at the time of checking
+   *
+   * @note Reads an atomic counter rather than std::deque::size(), so it is safe to call
+   *       concurrently with pushes/pops (the size may be momentarily stale, but it will not
+   *       crash by walking deque internals that another thread is mutating).
+   * @return The current size of the Deque at the time of checking
+   */
+  __JAFFAR_COMMON_INLINE__ size_t wasSize() const { return _size.load(std::memory_order_relaxed); }
+
+private:
+  /**
+   * Internal mutual exclusion mechanism
+   */
+  std::mutex _mutex;
+
+  /**
+   * Element count, maintained atomically alongside every push/pop so that wasSize() can be read
+   * concurrently without touching the (non-thread-safe) std::deque internals.
+   */
+  std::atomic<size_t> _size{0};
+
+  /**
+   * Internal storage for the Deque
+   */
+  std::deque<T> _internalDeque;
+};
+
+/**
+ * A lock-free, growable double-ended queue with the same concurrent interface as Deque
+ *
+ * Deque serializes every operation on one mutex, which dominates when the per-element work is cheap and many threads
+ * push and pop. Here both ends are claimed with a single CAS on a 64-bit state word holding the head and tail
+ * positions, the log2 of the current capacity and a resize flag, so operations on either end never block each other
+ * (unlike Chase-Lev deques, every thread may use both ends). Elements live in a circular array:
+ *
+ * - A claimed slot is written or read after the CAS, so every slot has its own state (empty, writing, full, reading).
+ *   A pop waits for a push that claimed the same position but is still writing it, and a push waits for a pop still
+ *   copying out the previous element of the same slot. Each wait only lasts for the other side's copy.
+ * - Every operation is counted in a per-thread pending counter (on its own cache line) from before its claim until
+ *   its copy is done. A push that finds the array full sets the resize flag, which makes further claims fail, waits
+ *   for all pending counters to drop to zero, moves the live range into an array of twice the size, and publishes
+ *   the new capacity with the flag cleared.
+ *
+ * Elements popped concurrently from the same end may come out in slightly different order than pushed, but every
+ * element is popped exactly once.
+ *
+ * @note Capacity is limited to 2^28 elements (the positions are 29-bit fields of the state word)
+ */
+template <class T>
+class LockFreeDeque
+{
+public:
+  /**
+   * Constructor for the lock-free deque
+   *
+   * @param[in] initialCapacity The initial number of slots (rounded up to a power of two), doubled whenever the deque fills up
+   */
+  LockFreeDeque(const size_t initialCapacity = 1024)
+    : _pendingCounters(parallel::getMaxThreadCount())
+  {
+    uint64_t exponent = 1;
+    while (((size_t)1 << exponent) < initialCapacity) exponent++;
+    if (exponent > _maxExponent) JAFFAR_THROW_LOGIC("The deque capacity cannot exceed %lu elements", (size_t)1 << _maxExponent);
+
+    _array.reset(new slot_t[(size_t)1 << exponent]);
+    _state.store(exponent << _exponentShift, std::memory_order_relaxed);
+  }
+
+  ~LockFreeDeque() = default;
+
+  LockFreeDeque(const LockFreeDeque&)            = delete;
+  LockFreeDeque& operator=(const LockFreeDeque&) = delete;
+
+  /**
+   * Pushes an element to the back of the deque
+   *
+   * @note This is a lock-free, thread safe operation (except while the array grows)
+   *
+   * @param[in] element The input element to push
+   */
+  __JAFFAR_COMMON_INLINE__ void push_back(T element) { push(element, true); }
+
+  /**
+   * Pushes an element to the front of the deque
+   *
+   * @note This is a lock-free, thread safe operation (except while the array grows)
+   *
+   * @param[in] element The input element to push
+   */
+  __JAFFAR_COMMON_INLINE__ void push_front(T element) { push(element, false); }
+
+  /**
+   * Pushes an element to the back of the deque (same as push_back, kept for compatibility with Deque)
+   *
+   * @param[in] element The input element to push
+   */
+  __JAFFAR_COMMON_INLINE__ void push_back_no_lock(T element) { push(element, true); }
+
+  /**
+   * Pushes an element to the front of the deque (same as push_front, kept for compatibility with Deque)
+   *
+   * @param[in] element The input element to push
+   */
+  __JAFFAR_COMMON_INLINE__ void push_front_no_lock(T element) { push(element, false); }
+
+  /**
+   * Pops (removes) the element at the back of the deque and retrieves it
+   *
+   * @note This is a lock-free, thread safe operation (except while the array grows)
+   * @param[out] element A reference to the storage to save the element into
+   * @return True, if the operation was successful; false, if the deque was empty
+   */
+  __JAFFAR_COMMON_INLINE__ bool pop_back_get(T& element)
+  {
+    auto&    pending = enter();
+    uint64_t state   = _state.load(std::memory_order_acquire);
+    while (true)
+    {
+      if (isResizing(state) == true)
+      {
+        state = waitForResize(pending);
+        continue;
+      }
+      if (getSize(state) == 0) return leave(pending, false);
+      if (_state.compare_exchange_weak(state, withTail(state, getTail(state) - 1), std::memory_order_acq_rel, std::memory_order_acquire) == true) break;
     }
-    if (count > 0) _size.fetch_sub(count, std::memory_order_relaxed);
 
-    _mutex.unlock();
-    return count;
+    element = read(state, getTail(state) - 1);
+    return leave(pending, true);
+  }
+
+  /**
+   * Pops (removes) the element at the front of the deque and retrieves it
+   *
+   * @note This is a lock-free, thread safe operation (except while the array grows)
+   * @param[out] element A reference to the storage to save the element into
+   * @return True, if the operation was successful; false, if the deque was empty
+   */
+  __JAFFAR_COMMON_INLINE__ bool pop_front_get(T& element) { return pop_front_get_batch(&element, 1) == 1; }
+
+  /**
+   * Pops (removes) up to maxCount elements from the front of the deque with a single claim, copying them into the
+   * provided buffer in front-to-back order
+   *
+   * @note This is a lock-free, thread safe operation (except while the array grows)
+   *
+   * @param[out] elements Destination buffer; must have room for at least maxCount elements
+   * @param[in] maxCount Maximum number of elements to pop
+   * @return The number of elements actually popped (0 if the deque was empty)
+   */
+  __JAFFAR_COMMON_INLINE__ size_t pop_front_get_batch(T* elements, const size_t maxCount)
+  {
+    auto&    pending = enter();
+    uint64_t state   = _state.load(std::memory_order_acquire);
+    size_t   take;
+    while (true)
+    {
+      if (isResizing(state) == true)
+      {
+        state = waitForResize(pending);
+        continue;
+      }
+      take = std::min(maxCount, getSize(state));
+      if (take == 0) return leave(pending, (size_t)0);
+      if (_state.compare_exchange_weak(state, withHead(state, getHead(state) + take), std::memory_order_acq_rel, std::memory_order_acquire) == true) break;
+    }
+
+    for (size_t i = 0; i < take; i++) elements[i] = read(state, getHead(state) + i);
+    return leave(pending, take);
   }
 
   /**
    * Retrieves the size of the container at the time of checking
    *
-   * @note Reads an atomic counter rather than std::deque::size(), so it is safe to call
-   *       concurrently with pushes/pops (the size may be momentarily stale, but it will not
-   *       crash by walking deque internals that another thread is mutating).
-   * @return The current size of the Deque at the time of checking
+   * @note Safe to call concurrently with pushes and pops (the size may be momentarily stale)
+   * @return The current size of the deque at the time of checking
    */
-  __JAFFAR_COMMON_INLINE__ size_t wasSize() const { return _size.load(std::memory_order_relaxed); }
+  __JAFFAR_COMMON_INLINE__ size_t wasSize() const { return getSize(_state.load(std::memory_order_relaxed)); }
+
+  /**
+   * Gets the current number of slots
+   *
+   * @return The capacity before the next growth
+   */
+  __JAFFAR_COMMON_INLINE__ size_t capacity() const { return getCapacity(_state.load(std::memory_order_relaxed)); }
 
 private:
   /**
-   * Internal mutual exclusion mechanism
+   * A slot of the circular array: its state and the element
    */
-  std::mutex _mutex;
+  struct slot_t
+  {
+    uint8_t state = _emptySlot;
+    T       element;
+  };
 
   /**
-   * Element count, maintained atomically alongside every push/pop so that wasSize() can be read
-   * concurrently without touching the (non-thread-safe) std::deque internals.
+   * A per-thread count of operations between their claim and the end of their copy, on its own cache line
    */
-  std::atomic<size_t> _size{0};
+  struct alignas(64) pendingCounter_t
+  {
+    std::atomic<size_t> count = 0;
+  };
 
   /**
-   * Internal storage for the Deque
+   * Slot states
    */
-  std::deque<T> _internalDeque;
+  static constexpr uint8_t _emptySlot   = 0;
+  static constexpr uint8_t _writingSlot = 1;
+  static constexpr uint8_t _fullSlot    = 2;
+  static constexpr uint8_t _readingSlot = 3;
+
+  /**
+   * Layout of the state word: head position (bits 0-28), tail position (bits 29-57), log2 of the capacity (bits 58-62) and the resize flag (bit 63)
+   */
+  static constexpr uint64_t _positionBits  = 29;
+  static constexpr uint64_t _positionMask  = ((uint64_t)1 << _positionBits) - 1;
+  static constexpr uint64_t _tailShift     = _positionBits;
+  static constexpr uint64_t _exponentShift = 2 * _positionBits;
+  static constexpr uint64_t _exponentMask  = (uint64_t)0x1F << _exponentShift;
+  static constexpr uint64_t _resizingFlag  = (uint64_t)1 << 63;
+
+  /**
+   * Largest log2 of the capacity: positions wrap around at 2^29, so the size must stay below that
+   */
+  static constexpr uint64_t _maxExponent = _positionBits - 1;
+
+  static __JAFFAR_COMMON_INLINE__ uint64_t getHead(const uint64_t state) { return state & _positionMask; }
+  static __JAFFAR_COMMON_INLINE__ uint64_t getTail(const uint64_t state) { return (state >> _tailShift) & _positionMask; }
+  static __JAFFAR_COMMON_INLINE__ uint64_t getExponent(const uint64_t state) { return (state & _exponentMask) >> _exponentShift; }
+  static __JAFFAR_COMMON_INLINE__ size_t   getCapacity(const uint64_t state) { return (size_t)1 << getExponent(state); }
+  static __JAFFAR_COMMON_INLINE__ size_t   getSize(const uint64_t state) { return (getTail(state) - getHead(state)) & _positionMask; }
+  static __JAFFAR_COMMON_INLINE__ bool     isResizing(const uint64_t state) { return (state & _resizingFlag) != 0; }
+  static __JAFFAR_COMMON_INLINE__ uint64_t withHead(const uint64_t state, const uint64_t head) { return (state & ~_positionMask) | (head & _positionMask); }
+  static __JAFFAR_COMMON_INLINE__ uint64_t withTail(const uint64_t state, const uint64_t tail)
+  {
+    return (state & ~(_positionMask << _tailShift)) | ((tail & _positionMask) << _tailShift);
+  }
+
+  static __JAFFAR_COMMON_INLINE__ void pause()
+  {
+#if defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+  }
+
+  /**
+   * Registers an operation in the calling thread's pending counter. The claim CAS that follows publishes it to any resizer
+   *
+   * @return The counter to pass on to leave()
+   */
+  __JAFFAR_COMMON_INLINE__ std::atomic<size_t>& enter()
+  {
+    auto& pending = _pendingCounters[parallel::getThreadId() % _pendingCounters.size()].count;
+    pending.fetch_add(1, std::memory_order_relaxed);
+    return pending;
+  }
+
+  /**
+   * Unregisters an operation, making its slot accesses visible to a resizer
+   *
+   * @param[in] pending The counter returned by enter()
+   * @param[in] result The value to return
+   * @return The result
+   */
+  template <class R>
+  __JAFFAR_COMMON_INLINE__ R leave(std::atomic<size_t>& pending, const R result)
+  {
+    pending.fetch_sub(1, std::memory_order_release);
+    return result;
+  }
+
+  /**
+   * Steps out of the pending count while a resize is going on, so the resizer does not wait on the calling thread
+   *
+   * @param[in] pending The counter returned by enter()
+   * @return The state word after the resize
+   */
+  __JAFFAR_COMMON_INLINE__ uint64_t waitForResize(std::atomic<size_t>& pending)
+  {
+    pending.fetch_sub(1, std::memory_order_release);
+    uint64_t state = _state.load(std::memory_order_acquire);
+    while (isResizing(state) == true)
+    {
+      pause();
+      state = _state.load(std::memory_order_acquire);
+    }
+    pending.fetch_add(1, std::memory_order_relaxed);
+    return _state.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Claims a position at one end and writes the element into it, growing the array if it is full
+   *
+   * @param[in] element The element
+   * @param[in] atBack Whether to push at the back (otherwise, at the front)
+   */
+  __JAFFAR_COMMON_INLINE__ void push(const T& element, const bool atBack)
+  {
+    auto&    pending = enter();
+    uint64_t state   = _state.load(std::memory_order_acquire);
+    while (true)
+    {
+      if (isResizing(state) == true)
+      {
+        state = waitForResize(pending);
+        continue;
+      }
+      if (getSize(state) == getCapacity(state))
+      {
+        pending.fetch_sub(1, std::memory_order_release);
+        grow(state);
+        pending.fetch_add(1, std::memory_order_relaxed);
+        state = _state.load(std::memory_order_acquire);
+        continue;
+      }
+      const uint64_t desired = atBack ? withTail(state, getTail(state) + 1) : withHead(state, getHead(state) - 1);
+      if (_state.compare_exchange_weak(state, desired, std::memory_order_acq_rel, std::memory_order_acquire) == true) break;
+    }
+
+    write(state, atBack ? getTail(state) : getHead(state) - 1, element);
+    leave(pending, true);
+  }
+
+  /**
+   * Doubles the array, unless another thread changed the state first. Must be called outside the pending count
+   *
+   * @param[in] state The state word in which the array was found full
+   */
+  __JAFFAR_COMMON_INLINE__ void grow(uint64_t state)
+  {
+    const uint64_t exponent = getExponent(state);
+    if (exponent == _maxExponent) JAFFAR_THROW_RUNTIME("Lock-free deque is full (capacity: %lu)", getCapacity(state));
+    if (_state.compare_exchange_strong(state, state | _resizingFlag, std::memory_order_acq_rel, std::memory_order_acquire) == false) return;
+
+    // Claims now fail; once the operations that claimed earlier are done, every slot in the live range is full and no other is in use
+    for (auto& counter : _pendingCounters)
+      while (counter.count.load(std::memory_order_acquire) != 0) pause();
+
+    const size_t oldMask  = getCapacity(state) - 1;
+    const size_t newMask  = 2 * getCapacity(state) - 1;
+    slot_t*      newArray = new slot_t[newMask + 1];
+    for (uint64_t i = 0, position = getHead(state); i < getSize(state); i++, position++)
+    {
+      newArray[position & newMask].element = _array[position & oldMask].element;
+      newArray[position & newMask].state   = _fullSlot;
+    }
+    _array.reset(newArray);
+
+    _state.store((state & ~_exponentMask) | ((exponent + 1) << _exponentShift), std::memory_order_release);
+  }
+
+  /**
+   * Writes an element at a claimed position, once the slot's previous element (if any) has been read
+   *
+   * @param[in] state The state word the position was claimed on
+   * @param[in] position The claimed position
+   * @param[in] element The element
+   */
+  __JAFFAR_COMMON_INLINE__ void write(const uint64_t state, const uint64_t position, const T& element)
+  {
+    slot_t&                  slot = _array[position & (getCapacity(state) - 1)];
+    std::atomic_ref<uint8_t> slotState(slot.state);
+    uint8_t                  expected = _emptySlot;
+    while (slotState.compare_exchange_weak(expected, _writingSlot, std::memory_order_acquire, std::memory_order_relaxed) == false)
+    {
+      expected = _emptySlot;
+      pause();
+    }
+    slot.element = element;
+    slotState.store(_fullSlot, std::memory_order_release);
+  }
+
+  /**
+   * Reads the element at a claimed position, once it has been written
+   *
+   * @param[in] state The state word the position was claimed on
+   * @param[in] position The claimed position
+   * @return The element
+   */
+  __JAFFAR_COMMON_INLINE__ T read(const uint64_t state, const uint64_t position)
+  {
+    slot_t&                  slot = _array[position & (getCapacity(state) - 1)];
+    std::atomic_ref<uint8_t> slotState(slot.state);
+    uint8_t                  expected = _fullSlot;
+    while (slotState.compare_exchange_weak(expected, _readingSlot, std::memory_order_acquire, std::memory_order_relaxed) == false)
+    {
+      expected = _fullSlot;
+      pause();
+    }
+    const T element = slot.element;
+    slotState.store(_emptySlot, std::memory_order_release);
+    return element;
+  }
+
+  /**
+   * The state word: head and tail positions, log2 of the capacity, and resize flag
+   */
+  alignas(64) std::atomic<uint64_t> _state;
+
+  /**
+   * The circular array (only replaced while no operation is pending)
+   */
+  std::unique_ptr<slot_t[]> _array;
+
+  /**
+   * Per-thread counts of operations in progress, waited on by a resize
+   */
+  std::vector<pendingCounter_t> _pendingCounters;
+};
+
+/**
+ * A work-stealing scheduler for draining a frontier of elements (e.g., the states of a step) in parallel
+ *
+ * Instead of every thread taking work from one shared container, each thread owns a local deque, seeded with a
+ * contiguous slice of the initial elements, into which it also pushes the elements it produces while working. A
+ * thread takes work from the back of its own deque (the most recently pushed elements, still in its cache). When it
+ * runs out, it steals the older half of a victim's deque from the front, so a whole chunk of work moves at once and
+ * steals stay rare. Each deque has its own spin lock, which its owner takes uncontended except during a steal.
+ *
+ * A thread leaves the run once it finds nothing to steal and no thread is busy. Since threads only push into their own
+ * deque and only leave with it empty, no element can be left behind; the busy count (which a thief raises while
+ * holding the victim's lock) just keeps idle threads around while work may still come up to steal.
+ *
+ * Per-thread counters (processed elements, steals, stolen elements and idle time) are kept for profiling the load balance.
+ */
+template <class T>
+class WorkStealingScheduler
+{
+public:
+  /**
+   * Constructor for the work-stealing scheduler
+   *
+   * @param[in] threadCount The maximum number of threads that will take part in run()
+   */
+  WorkStealingScheduler(const size_t threadCount = parallel::getMaxThreadCount())
+    : _workers(threadCount)
+  {
+    if (threadCount == 0) JAFFAR_THROW_LOGIC("The work-stealing scheduler needs at least one thread");
+  }
+
+  WorkStealingScheduler(const WorkStealingScheduler&)            = delete;
+  WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+  /**
+   * Distributes elements among the local deques, every thread receiving a contiguous slice (in order)
+   *
+   * @note This function is not thread safe and must not be called during run()
+   *
+   * @param[in] elements The elements to distribute
+   * @param[in] count The number of elements
+   */
+  __JAFFAR_COMMON_INLINE__ void seed(const T* elements, const size_t count)
+  {
+    const size_t workerCount = _workers.size();
+    for (size_t w = 0; w < workerCount; w++)
+    {
+      auto& worker = _workers[w];
+      worker.elements.insert(worker.elements.end(), elements + count * w / workerCount, elements + count * (w + 1) / workerCount);
+      worker.size.store(worker.elements.size(), std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Pushes an element into the calling thread's local deque
+   *
+   * @note Meant to be called from within the processing function given to run(), by the thread processing an element
+   *
+   * @param[in] element The element to push
+   */
+  __JAFFAR_COMMON_INLINE__ void push(const T& element)
+  {
+    auto& worker = _workers[parallel::getThreadId()];
+    worker.lock.lock();
+    worker.elements.push_back(element);
+    worker.size.store(worker.elements.size(), std::memory_order_relaxed);
+    worker.lock.unlock();
+  }
+
+  /**
+   * Processes all seeded elements, and all elements pushed while processing, in parallel
+   *
+   * The seeded slices of threads beyond the current thread count are handed to the running threads first.
+   *
+   * @param[in] process The function to call for every element. It may call push() to add more elements
+   */
+  __JAFFAR_COMMON_INLINE__ void run(const std::function<void(const T&)>& process)
+  {
+    if (parallel::getMaxThreadCount() > _workers.size())
+      JAFFAR_THROW_LOGIC("Running the work-stealing scheduler with up to %lu threads, but it was created for %lu", parallel::getMaxThreadCount(), _workers.size());
+
+    JAFFAR_PARALLEL
+    {
+      const size_t threadId = parallel::getThreadId();
+
+      // Handing the slices of the threads that did not join over to those that did
+      JAFFAR_MASTER
+      {
+        const size_t threadCount = parallel::getThreadCount();
+        for (size_t w = threadCount; w < _workers.size(); w++)
+        {
+          auto& orphan = _workers[w];
+          auto& heir   = _workers[w % threadCount];
+          heir.elements.insert(heir.elements.end(), orphan.elements.begin(), orphan.elements.end());
+          heir.size.store(heir.elements.size(), std::memory_order_relaxed);
+          orphan.elements.clear();
+          orphan.size.store(0, std::memory_order_relaxed);
+        }
+        _busyCount.store(threadCount, std::memory_order_relaxed);
+      }
+      JAFFAR_BARRIER
+
+      auto&  worker = _workers[threadId];
+      T      element;
+      size_t processedCount = 0;
+      while (popLocal(worker, element) || findWork(threadId, element))
+      {
+        process(element);
+        processedCount++;
+      }
+      worker.processedCount.store(worker.processedCount.load(std::memory_order_relaxed) + processedCount, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Gets the number of elements processed by a thread
+   *
+   * @param[in] threadId The thread
+   * @return The number of elements it processed
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getProcessedCount(const size_t threadId) const { return _workers[threadId].processedCount.load(std::memory_order_relaxed); }
+
+  /**
+   * Gets the number of successful steals made by a thread
+   *
+   * @param[in] threadId The thread
+   * @return The number of steals
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getStealCount(const size_t threadId) const { return _workers[threadId].stealCount.load(std::memory_order_relaxed); }
+
+  /**
+   * Gets the number of elements a thread took from other threads
+   *
+   * @param[in] threadId The thread
+   * @return The number of stolen elements
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getStolenElementCount(const size_t threadId) const { return _workers[threadId].stolenElementCount.load(std::memory_order_relaxed); }
+
+  /**
+   * Gets the time a thread spent looking for work after running out of it
+   *
+   * @param[in] threadId The thread
+   * @return The idle time, in seconds
+   */
+  __JAFFAR_COMMON_INLINE__ double getIdleSeconds(const size_t threadId) const { return (double)_workers[threadId].idleNanoseconds.load(std::memory_order_relaxed) * 1.0e-9; }
+
+  /**
+   * Gets the number of threads the scheduler was created for
+   *
+   * @return The thread count
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getThreadCount() const { return _workers.size(); }
+
+  /**
+   * Resets the per-thread counters
+   *
+   * @note This function is not thread safe and must not be called during run()
+   */
+  __JAFFAR_COMMON_INLINE__ void resetStats()
+  {
+    for (auto& worker : _workers)
+    {
+      worker.processedCount.store(0, std::memory_order_relaxed);
+      worker.stealCount.store(0, std::memory_order_relaxed);
+      worker.stolenElementCount.store(0, std::memory_order_relaxed);
+      worker.idleNanoseconds.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  /**
+   * A thread's local deque and counters, on their own cache lines
+   */
+  struct alignas(64) worker_t
+  {
+    SpinLock            lock;
+    std::deque<T>       elements;
+    std::atomic<size_t> size               = 0;
+    std::atomic<size_t> processedCount     = 0;
+    std::atomic<size_t> stealCount         = 0;
+    std::atomic<size_t> stolenElementCount = 0;
+    std::atomic<size_t> idleNanoseconds    = 0;
+  };
+
+  /**
+   * Takes the most recently pushed element from a thread's own deque
+   *
+   * @param[in] worker The calling thread's worker
+   * @param[out] element The element taken
+   * @return True, if an element was taken; false, if the deque was empty
+   */
+  __JAFFAR_COMMON_INLINE__ bool popLocal(worker_t& worker, T& element)
+  {
+    if (worker.size.load(std::memory_order_relaxed) == 0) return false;
+
+    worker.lock.lock();
+    const bool found = worker.elements.empty() == false;
+    if (found)
+    {
+      element = worker.elements.back();
+      worker.elements.pop_back();
+      worker.size.store(worker.elements.size(), std::memory_order_relaxed);
+    }
+    worker.lock.unlock();
+    return found;
+  }
+
+  /**
+   * Steals the older half of a victim's deque into the thief's own deque, returning one of the stolen elements
+   *
+   * @param[in] thief The calling thread's worker
+   * @param[in] victim The worker to steal from
+   * @param[out] element One of the stolen elements, to process right away
+   * @return True, if anything was stolen; false, if the victim's deque was empty
+   */
+  __JAFFAR_COMMON_INLINE__ bool steal(worker_t& thief, worker_t& victim, T& element)
+  {
+    if (victim.size.load(std::memory_order_relaxed) == 0) return false;
+
+    victim.lock.lock();
+    const size_t stolenCount = (victim.elements.size() + 1) / 2;
+    if (stolenCount == 0)
+    {
+      victim.lock.unlock();
+      return false;
+    }
+
+    // Registering as busy while the elements cannot be seen anywhere else, so the other threads cannot all be found idle
+    _busyCount.fetch_add(1, std::memory_order_acq_rel);
+
+    thief.lock.lock();
+    thief.elements.insert(thief.elements.end(), victim.elements.begin(), victim.elements.begin() + stolenCount);
+    element = thief.elements.back();
+    thief.elements.pop_back();
+    thief.size.store(thief.elements.size(), std::memory_order_relaxed);
+    thief.lock.unlock();
+
+    victim.elements.erase(victim.elements.begin(), victim.elements.begin() + stolenCount);
+    victim.size.store(victim.elements.size(), std::memory_order_relaxed);
+    victim.lock.unlock();
+
+    thief.stealCount.store(thief.stealCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    thief.stolenElementCount.store(thief.stolenElementCount.load(std::memory_order_relaxed) + stolenCount, std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * Looks for work in the other threads' deques once the calling thread's own is empty, until either something is
+   * stolen or every thread is idle
+   *
+   * @param[in] threadId The calling thread
+   * @param[out] element The element to process next
+   * @return True, if an element was found; false, if all work is done
+   */
+  __JAFFAR_COMMON_INLINE__ bool findWork(const size_t threadId, T& element)
+  {
+    auto&        thief       = _workers[threadId];
+    const size_t workerCount = _workers.size();
+    const auto   t0          = timing::now();
+    _busyCount.fetch_sub(1, std::memory_order_acq_rel);
+
+    // Visiting victims from a per-thread rotating start, so idle threads do not all line up behind the same one
+    bool found = false;
+    for (size_t round = threadId; found == false; round++)
+    {
+      for (size_t i = 1; i <= workerCount && found == false; i++)
+      {
+        auto& victim = _workers[(threadId + round + i) % workerCount];
+        if (&victim != &thief) found = steal(thief, victim, element);
+      }
+      if (found == false && _busyCount.load(std::memory_order_acquire) == 0) break;
+      if (found == false) std::this_thread::yield();
+    }
+
+    thief.idleNanoseconds.store(thief.idleNanoseconds.load(std::memory_order_relaxed) + timing::timeDeltaNanoseconds(timing::now(), t0), std::memory_order_relaxed);
+    return found;
+  }
+
+  /**
+   * The per-thread deques and counters
+   */
+  std::vector<worker_t> _workers;
+
+  /**
+   * Number of threads currently processing elements or holding work in their deques
+   */
+  alignas(64) std::atomic<size_t> _busyCount = 0;
 };
 
 } // namespace concurrent
@@ -0,0 +1,275 @@
+#pragma once
+
+/**
+ * @file dedup.hpp
+ * @brief Contains a parallel radix sort for state hashes and a sort-based batch deduplication
+ */
+
+#include "exceptions.hpp"
+#include "hash.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace jaffarCommon
+{
+
+namespace dedup
+{
+
+/**
+ * Number of key bits sorted by each radix pass (a per-thread histogram of 2^11 counters fits in the L1 cache)
+ */
+inline constexpr size_t radixBits = 11;
+
+/**
+ * Number of buckets per radix pass
+ */
+inline constexpr size_t radixBucketCount = (size_t)1 << radixBits;
+
+/**
+ * Number of radix passes needed to cover the 64 bits of a key's first word
+ */
+inline constexpr size_t radixPassCount = (64 + radixBits - 1) / radixBits;
+
+static_assert(radixPassCount % 2 == 0, "An even number of passes is needed for the sorted keys to end up back in the input array");
+
+/**
+ * Sorts state hashes (and, optionally, a payload attached to each) in ascending order with a parallel LSD radix sort
+ *
+ * Each pass distributes the keys by 11 bits of their first word: every thread counts the digits of its share of the
+ * input, the counts are turned into per-thread write offsets, and every thread scatters its share to a scratch array.
+ * The sort is stable, so the first word alone orders all keys except those sharing it (duplicates, in practice); the
+ * few runs of equal first words are then ordered by their second word, keeping equal keys in their input order.
+ *
+ * @param[in,out] keys The keys to sort
+ * @param[in,out] payloads The payloads, moved along with their keys. If nullptr, only keys are sorted
+ * @param[in] count The number of keys
+ */
+template <class Payload>
+__JAFFAR_COMMON_INLINE__ void radixSort(hash::hash_t* keys, Payload* payloads, const size_t count)
+{
+  if (count < 2) return;
+
+  const size_t              maxThreadCount = parallel::getMaxThreadCount();
+  std::vector<size_t>       offsets(maxThreadCount * radixBucketCount);
+  std::vector<hash::hash_t> keyScratch(count);
+  std::vector<Payload>      payloadScratch(payloads != nullptr ? count : 0);
+
+  JAFFAR_PARALLEL
+  {
+    const size_t threadId    = parallel::getThreadId();
+    const size_t threadCount = parallel::getThreadCount();
+    const size_t begin       = count * threadId / threadCount;
+    const size_t end         = count * (threadId + 1) / threadCount;
+    size_t*      histogram   = &offsets[threadId * radixBucketCount];
+
+    hash::hash_t* source             = keys;
+    hash::hash_t* destination        = keyScratch.data();
+    Payload*      sourcePayload      = payloads;
+    Payload*      destinationPayload = payloadScratch.data();
+
+    for (size_t pass = 0; pass < radixPassCount; pass++)
+    {
+      const size_t shift = pass * radixBits;
+      std::fill(histogram, histogram + radixBucketCount, 0);
+      for (size_t i = begin; i < end; i++) histogram[(source[i].first >> shift) & (radixBucketCount - 1)]++;
+      JAFFAR_BARRIER
+
+      // Turning the per-thread counts into write offsets (digit-major, thread-minor, which keeps the sort stable)
+      JAFFAR_MASTER
+      {
+        size_t position = 0;
+        for (size_t b = 0; b < radixBucketCount; b++)
+          for (size_t t = 0; t < threadCount; t++)
+          {
+            const size_t bucketCount          = offsets[t * radixBucketCount + b];
+            offsets[t * radixBucketCount + b] = position;
+            position += bucketCount;
+          }
+      }
+      JAFFAR_BARRIER
+
+      for (size_t i = begin; i < end; i++)
+      {
+        const size_t position = histogram[(source[i].first >> shift) & (radixBucketCount - 1)]++;
+        destination[position] = source[i];
+        if (payloads != nullptr) destinationPayload[position] = sourcePayload[i];
+      }
+      JAFFAR_BARRIER
+
+      std::swap(source, destination);
+      std::swap(sourcePayload, destinationPayload);
+    }
+
+    // Ordering runs of equal first words by their second word. Only second words and payloads move, so threads looking
+    // at the first words around their own runs do not race with this
+    JAFFAR_FOR
+    for (size_t i = 0; i < count - 1; i++)
+    {
+      const bool isRunStart = keys[i].first == keys[i + 1].first && (i == 0 || keys[i - 1].first != keys[i].first);
+      if (isRunStart == false) continue;
+
+      size_t runEnd = i + 1;
+      while (runEnd < count && keys[runEnd].first == keys[i].first) runEnd++;
+
+      // Insertion sort: runs are short, and runs of identical keys are already in order
+      for (size_t j = i + 1; j < runEnd; j++)
+      {
+        const uint64_t second = keys[j].second;
+        Payload        payload{};
+        if (payloads != nullptr) payload = payloads[j];
+
+        size_t k = j;
+        for (; k > i && keys[k - 1].second > second; k--)
+        {
+          keys[k].second = keys[k - 1].second;
+          if (payloads != nullptr) payloads[k] = payloads[k - 1];
+        }
+
+        keys[k].second = second;
+        if (payloads != nullptr) payloads[k] = payload;
+      }
+    }
+  }
+}
+
+/**
+ * Sorts state hashes in ascending order with a parallel LSD radix sort
+ *
+ * @param[in,out] keys The keys to sort
+ */
+__JAFFAR_COMMON_INLINE__ void radixSort(std::vector<hash::hash_t>& keys) { radixSort<uint8_t>(keys.data(), nullptr, keys.size()); }
+
+/**
+ * Sorts state hashes in ascending order with a parallel LSD radix sort, along with a payload attached to each
+ *
+ * @param[in,out] keys The keys to sort
+ * @param[in,out] payloads The payloads (one per key), moved along with their keys
+ */
+template <class Payload>
+__JAFFAR_COMMON_INLINE__ void radixSort(std::vector<hash::hash_t>& keys, std::vector<Payload>& payloads)
+{
+  if (payloads.size() != keys.size()) JAFFAR_THROW_LOGIC("The number of payloads (%lu) does not match the number of keys (%lu)", payloads.size(), keys.size());
+  radixSort<Payload>(keys.data(), payloads.data(), keys.size());
+}
+
+/**
+ * Advances a cursor over a sorted run up to the first element not smaller than a key, with an exponential search
+ * followed by a binary search, so that the cost depends on the distance covered rather than on the run size
+ *
+ * @param[in] run The sorted run
+ * @param[in,out] cursor The position to start from (all elements before it must be smaller than the key)
+ * @param[in] key The key to look for
+ * @return True, if the key is present in the run; false, otherwise
+ */
+__JAFFAR_COMMON_INLINE__ bool gallopTo(const std::vector<hash::hash_t>& run, size_t& cursor, const hash::hash_t& key)
+{
+  size_t low  = cursor;
+  size_t high = cursor;
+  for (size_t step = 1; high < run.size() && run[high] < key; step *= 2) low = high + 1, high += step;
+
+  cursor = std::lower_bound(run.begin() + low, run.begin() + std::min(high, run.size()), key) - run.begin();
+  return cursor < run.size() && run[cursor] == key;
+}
+
+/**
+ * Removes from a sorted batch of state hashes (and, optionally, their payloads) the repeated keys and the keys present
+ * in any of the sorted runs of a history
+ *
+ * Every thread walks its share of the batch and merges it against each run, moving a per-run cursor forward, so no
+ * shared mutable structure is involved. The history typically holds the deduplicated batches of earlier steps.
+ *
+ * @param[in,out] batch The batch, sorted (e.g., by radixSort). On return, only its new, distinct keys remain, still sorted
+ * @param[in,out] payloads The payloads of the batch keys, filtered along with them (for repeated keys, the first one's is kept). If nullptr, only keys are filtered
+ * @param[in] sortedHistory The sorted runs to check against
+ * @return The number of keys kept
+ */
+template <class Payload>
+__JAFFAR_COMMON_INLINE__ size_t dedupAgainst(std::vector<hash::hash_t>& batch, std::vector<Payload>* payloads, const std::vector<std::vector<hash::hash_t>>& sortedHistory)
+{
+  const size_t count = batch.size();
+  if (payloads != nullptr && payloads->size() != count)
+    JAFFAR_THROW_LOGIC("The number of payloads (%lu) does not match the number of keys (%lu)", payloads->size(), count);
+
+  const size_t              maxThreadCount = parallel::getMaxThreadCount();
+  std::vector<uint8_t>      keep(count);
+  std::vector<size_t>       keptOffsets(maxThreadCount + 1, 0);
+  std::vector<hash::hash_t> keptKeys;
+  std::vector<Payload>      keptPayloads;
+
+  JAFFAR_PARALLEL
+  {
+    const size_t threadId    = parallel::getThreadId();
+    const size_t threadCount = parallel::getThreadCount();
+    const size_t begin       = count * threadId / threadCount;
+    const size_t end         = count * (threadId + 1) / threadCount;
+
+    // Marking the keys to keep
+    std::vector<size_t> cursors(sortedHistory.size(), 0);
+    size_t              keptCount = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+      bool isNew = i == 0 || batch[i - 1] != batch[i];
+      for (size_t r = 0; r < sortedHistory.size() && isNew; r++) isNew = gallopTo(sortedHistory[r], cursors[r], batch[i]) == false;
+      keep[i]    = isNew;
+      keptCount += isNew;
+    }
+    keptOffsets[threadId + 1] = keptCount;
+    JAFFAR_BARRIER
+
+    JAFFAR_MASTER
+    {
+      for (size_t t = 0; t < threadCount; t++) keptOffsets[t + 1] += keptOffsets[t];
+      keptKeys.resize(keptOffsets[threadCount]);
+      if (payloads != nullptr) keptPayloads.resize(keptOffsets[threadCount]);
+    }
+    JAFFAR_BARRIER
+
+    // Compacting into the output, every thread at its own offset
+    for (size_t i = begin, position = keptOffsets[threadId]; i < end; i++)
+      if (keep[i])
+      {
+        keptKeys[position] = batch[i];
+        if (payloads != nullptr) keptPayloads[position] = (*payloads)[i];
+        position++;
+      }
+  }
+
+  batch.swap(keptKeys);
+  if (payloads != nullptr) payloads->swap(keptPayloads);
+  return batch.size();
+}
+
+/**
+ * Removes from a sorted batch of state hashes the repeated keys and the keys present in any of the sorted runs of a history
+ *
+ * @param[in,out] batch The batch, sorted (e.g., by radixSort). On return, only its new, distinct keys remain, still sorted
+ * @param[in] sortedHistory The sorted runs to check against
+ * @return The number of keys kept
+ */
+__JAFFAR_COMMON_INLINE__ size_t dedupAgainst(std::vector<hash::hash_t>& batch, const std::vector<std::vector<hash::hash_t>>& sortedHistory)
+{
+  return dedupAgainst<uint8_t>(batch, nullptr, sortedHistory);
+}
+
+/**
+ * Removes from a sorted batch of state hashes and their payloads the repeated keys and the keys present in any of the
+ * sorted runs of a history
+ *
+ * @param[in,out] batch The batch, sorted (e.g., by radixSort). On return, only its new, distinct keys remain, still sorted
+ * @param[in,out] payloads The payloads of the batch keys, filtered along with them (for repeated keys, the first one's is kept)
+ * @param[in] sortedHistory The sorted runs to check against
+ * @return The number of keys kept
+ */
+template <class Payload>
+__JAFFAR_COMMON_INLINE__ size_t dedupAgainst(std::vector<hash::hash_t>& batch, std::vector<Payload>& payloads, const std::vector<std::vector<hash::hash_t>>& sortedHistory)
+{
+  return dedupAgainst<Payload>(batch, &payloads, sortedHistory);
+}
+
+} // namespace dedup
+
+} // namespace jaffarCommon
\ No newline at end of file
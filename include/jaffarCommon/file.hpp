@@ -5,14 +5,21 @@
  * @brief Contains common functions related to file manipulation
  */
 
+#include "hash.hpp"
+#include <cerrno>
 #include <cstdio>
 #include <cstring>
+#include <fcntl.h>
 #include <fstream>
 #include <functional>
 #include <map>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 
 namespace jaffarCommon
 {
@@ -77,6 +84,107 @@ static __JAFFAR_COMMON_INLINE__ bool saveStringToFile(const std::string& src, co
   return false;
 }
 
+/**
+ * Reads a file sequentially in large blocks, passing each one to a callback, without loading the whole file in memory
+ *
+ * Regular files are memory-mapped and each block is released from the mapping once consumed, so even multi-GB files
+ * are processed at I/O speed with a bounded footprint. Other files (e.g., pipes) are read block by block instead.
+ *
+ * @param[in] fileName The name of the file to read
+ * @param[in] callback The function receiving each block (pointer and size), in file order
+ * @param[in] blockSize The maximum size of each block
+ * @return Whether the read operation succeded (true) or failed (fail)
+ */
+static __JAFFAR_COMMON_INLINE__ bool processFileBlocks(const std::string& fileName, const std::function<void(const uint8_t*, const size_t)>& callback,
+                                                       const size_t blockSize = 16 * 1024 * 1024)
+{
+  if (blockSize == 0) JAFFAR_THROW_LOGIC("The block size must be a positive number");
+
+  // Releases the descriptor and the mapping on every exit path, including a throwing callback
+  struct fileGuard_t
+  {
+    int    fd          = -1;
+    void*  mapping     = MAP_FAILED;
+    size_t mappingSize = 0;
+    ~fileGuard_t()
+    {
+      if (mapping != MAP_FAILED) munmap(mapping, mappingSize);
+      if (fd >= 0) close(fd);
+    }
+  } guard;
+
+  guard.fd = open(fileName.c_str(), O_RDONLY);
+  if (guard.fd < 0) return false;
+
+  struct stat fileStat;
+  if (fstat(guard.fd, &fileStat) != 0) return false;
+
+  // Memory-mapped path for (non-empty) regular files
+  const size_t fileSize = (size_t)fileStat.st_size;
+  if (S_ISREG(fileStat.st_mode) && fileSize > 0) guard.mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, guard.fd, 0);
+  if (guard.mapping != MAP_FAILED)
+  {
+    guard.mappingSize = fileSize;
+    madvise(guard.mapping, fileSize, MADV_SEQUENTIAL);
+    const uint8_t* data = (const uint8_t*)guard.mapping;
+
+    // Block size is kept a multiple of the page size so that consumed blocks can be dropped from the mapping
+    const size_t pageSize     = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t alignedBlock = blockSize < pageSize ? pageSize : blockSize - blockSize % pageSize;
+    for (size_t pos = 0; pos < fileSize; pos += alignedBlock)
+    {
+      const size_t size = std::min(alignedBlock, fileSize - pos);
+      callback(&data[pos], size);
+      madvise((void*)&data[pos], size, MADV_DONTNEED);
+    }
+
+    return true;
+  }
+
+  // Fallback: reading block by block into a reusable buffer, retrying reads interrupted by a signal
+  std::vector<uint8_t> buffer(blockSize);
+  while (true)
+  {
+    const ssize_t bytesRead = read(guard.fd, buffer.data(), buffer.size());
+    if (bytesRead < 0 && errno == EINTR) continue;
+    if (bytesRead < 0) return false;
+    if (bytesRead == 0) return true;
+    callback(buffer.data(), (size_t)bytesRead);
+  }
+}
+
+/**
+ * Calculates the SHA1 sum of a file, streaming it rather than loading it whole
+ *
+ * @param[out] dst The SHA1 string of the file (same format as hash::getSHA1String)
+ * @param[in] fileName The name of the file to hash
+ * @return Whether the hash operation succeded (true) or failed (fail)
+ */
+static __JAFFAR_COMMON_INLINE__ bool getFileSHA1String(std::string& dst, const std::string& fileName)
+{
+  hash::SHA1Hasher hasher;
+  if (processFileBlocks(fileName, [&](const uint8_t* data, const size_t size) { hasher.update(data, size); }) == false) return false;
+  dst = hasher.finalize();
+  return true;
+}
+
+/**
+ * Calculates the 128-bit hash of a file, streaming it rather than loading it whole
+ *
+ * @tparam Hasher The hashing backend to use (MetroHash128 by default). The result equals the backend's hash of the file contents
+ * @param[out] dst The hash of the file
+ * @param[in] fileName The name of the file to hash
+ * @return Whether the hash operation succeded (true) or failed (fail)
+ */
+template <class Hasher = hash::MetroHash128Hasher>
+static __JAFFAR_COMMON_INLINE__ bool getFileHash(hash::hash_t& dst, const std::string& fileName)
+{
+  Hasher hasher;
+  if (processFileBlocks(fileName, [&](const uint8_t* data, const size_t size) { hasher.update(data, size); }) == false) return false;
+  dst = hasher.finalize();
+  return true;
+}
+
 class MemoryFileDirectory;
 
 /**
@@ -5,10 +5,21 @@
  * @brief Contains common function related to hashing
  */
 
+#include "exceptions.hpp"
+#include "hashers/sha1.hpp"
+#include "parallel.hpp"
+#include <algorithm>
 #include <metrohash128/metrohash128.h>
-#include <sha1/sha1.hpp>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 namespace jaffarCommon
 {
@@ -27,7 +38,16 @@ typedef _uint128_t hash_t;
  * @param[in] string The input string
  * @return The SHA1 string of the input string
  */
-__JAFFAR_COMMON_INLINE__ std::string getSHA1String(const std::string& string) { return sha1::SHA1::GetHash((const uint8_t*)string.data(), string.size()); }
+__JAFFAR_COMMON_INLINE__ std::string getSHA1String(const std::string& string) { return SHA1Hasher::calculate(string.data(), string.size()); }
+
+/**
+ * Calculates the SHA1 sum of a given buffer and returns it as a stylized (string)
+ *
+ * @param[in] data The input buffer
+ * @param[in] size The size of the input buffer
+ * @return The SHA1 string of the input buffer
+ */
+__JAFFAR_COMMON_INLINE__ std::string getSHA1String(const void* data, const size_t size) { return SHA1Hasher::calculate(data, size); }
 
 /**
  * Calculates the 128 bit Metrohash of a given buffer
@@ -45,6 +65,657 @@ __JAFFAR_COMMON_INLINE__ hash_t calculateMetroHash(const void* data, size_t size
   return result;
 }
 
+/**
+ * The MetroHash128 multiplication constants (k0, k1, k2, k3). They are replicated here so that the batched kernels can
+ * reproduce its bulk loop exactly and stay bit-identical to calculateMetroHash
+ */
+inline constexpr uint64_t metroHashConstants[4] = {0xC83A91E1, 0x8648DBDB, 0x7BDEC03B, 0x2F5870A5};
+
+/**
+ * Maximum number of buffers hashed side by side by a single batched kernel invocation (the AVX-512 width)
+ */
+inline constexpr size_t metroHashBatchWidth = 8;
+
+/**
+ * Rotate-right idiom used by MetroHash128 (recognized by the compiler as a single instruction)
+ *
+ * @param[in] value The value to rotate
+ * @param[in] bits The number of bits to rotate by (1..63)
+ * @return The rotated value
+ */
+__JAFFAR_COMMON_INLINE__ uint64_t metroHashRotateRight(const uint64_t value, const unsigned bits) { return (value >> bits) | (value << (64 - bits)); }
+
+/**
+ * Reads an unaligned little-endian word of the given size (1, 2, 4 or 8 bytes) from a buffer
+ *
+ * @param[in] ptr The position to read from
+ * @param[in] bytes The number of bytes to read
+ * @return The value read, zero-extended to 64 bits
+ */
+__JAFFAR_COMMON_INLINE__ uint64_t metroHashRead(const uint8_t* ptr, const size_t bytes)
+{
+  uint64_t value = 0;
+  memcpy(&value, ptr, bytes);
+  return value;
+}
+
+/**
+ * Initializes the four MetroHash128 state registers for a zero seed, as calculateMetroHash does
+ *
+ * @param[out] v The state registers to initialize
+ */
+__JAFFAR_COMMON_INLINE__ void metroHashInitialize(uint64_t v[4])
+{
+  const uint64_t* k = metroHashConstants;
+  v[0]              = (0 - k[0]) * k[3];
+  v[1]              = (0 + k[1]) * k[2];
+  v[2]              = (0 + k[0]) * k[2];
+  v[3]              = (0 - k[1]) * k[3];
+}
+
+/**
+ * Runs the MetroHash128 bulk loop over a number of whole 32-byte blocks
+ *
+ * @param[in,out] v The state registers
+ * @param[in] ptr The start of the blocks to hash
+ * @param[in] blockCount The number of 32-byte blocks to process
+ */
+__JAFFAR_COMMON_INLINE__ void metroHashBulk(uint64_t v[4], const uint8_t* ptr, const size_t blockCount)
+{
+  const uint64_t* k = metroHashConstants;
+  for (size_t i = 0; i < blockCount; i++, ptr += 32)
+  {
+    v[0] += metroHashRead(ptr + 0, 8) * k[0], v[0] = metroHashRotateRight(v[0], 29) + v[2];
+    v[1] += metroHashRead(ptr + 8, 8) * k[1], v[1] = metroHashRotateRight(v[1], 29) + v[3];
+    v[2] += metroHashRead(ptr + 16, 8) * k[2], v[2] = metroHashRotateRight(v[2], 29) + v[0];
+    v[3] += metroHashRead(ptr + 24, 8) * k[3], v[3] = metroHashRotateRight(v[3], 29) + v[1];
+  }
+}
+
+/**
+ * Finalizes a MetroHash128 computation: mixes the bulk state (if the bulk loop ran) and absorbs the trailing bytes
+ *
+ * @param[in,out] v The state registers, as left by metroHashBulk
+ * @param[in] tail The trailing bytes not covered by whole 32-byte blocks
+ * @param[in] tailSize The number of trailing bytes (less than 32)
+ * @param[in] bulkUsed Whether the total input was at least 32 bytes long (i.e., whether the bulk loop ran)
+ * @return The final 128-bit hash
+ */
+__JAFFAR_COMMON_INLINE__ hash_t metroHashFinalize(uint64_t v[4], const uint8_t* tail, size_t tailSize, const bool bulkUsed)
+{
+  const uint64_t* k = metroHashConstants;
+
+  if (bulkUsed == true)
+  {
+    v[2] ^= metroHashRotateRight(((v[0] + v[3]) * k[0]) + v[1], 21) * k[1];
+    v[3] ^= metroHashRotateRight(((v[1] + v[2]) * k[1]) + v[0], 21) * k[0];
+    v[0] ^= metroHashRotateRight(((v[0] + v[2]) * k[0]) + v[3], 21) * k[1];
+    v[1] ^= metroHashRotateRight(((v[1] + v[3]) * k[1]) + v[2], 21) * k[0];
+  }
+
+  if (tailSize >= 16)
+  {
+    v[0] += metroHashRead(tail, 8) * k[2], v[0] = metroHashRotateRight(v[0], 33) * k[3];
+    v[1] += metroHashRead(tail + 8, 8) * k[2], v[1] = metroHashRotateRight(v[1], 33) * k[3];
+    v[0] ^= metroHashRotateRight((v[0] * k[2]) + v[1], 45) * k[1];
+    v[1] ^= metroHashRotateRight((v[1] * k[3]) + v[0], 45) * k[0];
+    tail += 16, tailSize -= 16;
+  }
+
+  if (tailSize >= 8)
+  {
+    v[0] += metroHashRead(tail, 8) * k[2], v[0] = metroHashRotateRight(v[0], 33) * k[3];
+    v[0] ^= metroHashRotateRight((v[0] * k[2]) + v[1], 27) * k[1];
+    tail += 8, tailSize -= 8;
+  }
+
+  if (tailSize >= 4)
+  {
+    v[1] += metroHashRead(tail, 4) * k[2], v[1] = metroHashRotateRight(v[1], 33) * k[3];
+    v[1] ^= metroHashRotateRight((v[1] * k[3]) + v[0], 46) * k[0];
+    tail += 4, tailSize -= 4;
+  }
+
+  if (tailSize >= 2)
+  {
+    v[0] += metroHashRead(tail, 2) * k[2], v[0] = metroHashRotateRight(v[0], 33) * k[3];
+    v[0] ^= metroHashRotateRight((v[0] * k[2]) + v[1], 22) * k[1];
+    tail += 2, tailSize -= 2;
+  }
+
+  if (tailSize >= 1)
+  {
+    v[1] += metroHashRead(tail, 1) * k[2], v[1] = metroHashRotateRight(v[1], 33) * k[3];
+    v[1] ^= metroHashRotateRight((v[1] * k[3]) + v[0], 58) * k[0];
+  }
+
+  v[0] += metroHashRotateRight((v[0] * k[0]) + v[1], 13);
+  v[1] += metroHashRotateRight((v[1] * k[1]) + v[0], 37);
+  v[0] += metroHashRotateRight((v[0] * k[2]) + v[1], 13);
+  v[1] += metroHashRotateRight((v[1] * k[3]) + v[0], 37);
+
+  return hash_t(v[0], v[1]);
+}
+
+/**
+ * Hashes a group of same-sized buffers one after the other (portable fallback for the batched API)
+ *
+ * @param[in] buffers The buffers to hash
+ * @param[in] count The number of buffers in the group (at most metroHashBatchWidth)
+ * @param[in] size The size of every buffer
+ * @param[out] hashes Storage for the count resulting hashes
+ */
+__JAFFAR_COMMON_INLINE__ void metroHashBatchScalar(const uint8_t* const* buffers, const size_t count, const size_t size, hash_t* hashes)
+{
+  const size_t blockCount = size / 32;
+  for (size_t i = 0; i < count; i++)
+  {
+    uint64_t v[4];
+    metroHashInitialize(v);
+    metroHashBulk(v, buffers[i], blockCount);
+    hashes[i] = metroHashFinalize(v, buffers[i] + blockCount * 32, size % 32, blockCount > 0);
+  }
+}
+
+#if defined(__x86_64__)
+
+/**
+ * Multiplies each 64-bit lane by a constant that fits in 32 bits (AVX2 has no 64-bit low multiply)
+ *
+ * @param[in] x The lanes to multiply
+ * @param[in] k The broadcast 32-bit constant
+ * @return The lane-wise product, modulo 2^64
+ */
+__attribute__((target("avx2"))) __JAFFAR_COMMON_INLINE__ __m256i metroHashMultiplyAVX2(const __m256i x, const __m256i k)
+{
+  return _mm256_add_epi64(_mm256_mul_epu32(x, k), _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), k), 32));
+}
+
+/**
+ * Hashes up to four same-sized buffers at once, running their independent MetroHash128 bulk loops in the four 64-bit
+ * lanes of AVX2 registers. Finalization is done in scalar code per buffer.
+ *
+ * @param[in] buffers The buffers to hash
+ * @param[in] count The number of buffers in the group (at most 4)
+ * @param[in] size The size of every buffer
+ * @param[out] hashes Storage for the count resulting hashes
+ */
+__attribute__((target("avx2"))) __JAFFAR_COMMON_INLINE__ void metroHashBatchAVX2(const uint8_t* const* buffers, const size_t count, const size_t size, hash_t* hashes)
+{
+  const size_t blockCount = size / 32;
+
+  // Filling unused lanes with a valid pointer; their results are discarded
+  const uint8_t* p[4];
+  for (size_t i = 0; i < 4; i++) p[i] = buffers[i < count ? i : 0];
+
+  uint64_t v[4];
+  metroHashInitialize(v);
+  __m256i V0 = _mm256_set1_epi64x((long long)v[0]);
+  __m256i V1 = _mm256_set1_epi64x((long long)v[1]);
+  __m256i V2 = _mm256_set1_epi64x((long long)v[2]);
+  __m256i V3 = _mm256_set1_epi64x((long long)v[3]);
+
+  const __m256i K0 = _mm256_set1_epi64x((long long)metroHashConstants[0]);
+  const __m256i K1 = _mm256_set1_epi64x((long long)metroHashConstants[1]);
+  const __m256i K2 = _mm256_set1_epi64x((long long)metroHashConstants[2]);
+  const __m256i K3 = _mm256_set1_epi64x((long long)metroHashConstants[3]);
+
+  for (size_t b = 0, offset = 0; b < blockCount; b++, offset += 32)
+  {
+    // Loading one block from each buffer and transposing so that Wj holds word j of every buffer
+    const __m256i a0 = _mm256_loadu_si256((const __m256i*)(p[0] + offset));
+    const __m256i a1 = _mm256_loadu_si256((const __m256i*)(p[1] + offset));
+    const __m256i a2 = _mm256_loadu_si256((const __m256i*)(p[2] + offset));
+    const __m256i a3 = _mm256_loadu_si256((const __m256i*)(p[3] + offset));
+    const __m256i t0 = _mm256_unpacklo_epi64(a0, a1);
+    const __m256i t1 = _mm256_unpackhi_epi64(a0, a1);
+    const __m256i t2 = _mm256_unpacklo_epi64(a2, a3);
+    const __m256i t3 = _mm256_unpackhi_epi64(a2, a3);
+    const __m256i W0 = _mm256_permute2x128_si256(t0, t2, 0x20);
+    const __m256i W1 = _mm256_permute2x128_si256(t1, t3, 0x20);
+    const __m256i W2 = _mm256_permute2x128_si256(t0, t2, 0x31);
+    const __m256i W3 = _mm256_permute2x128_si256(t1, t3, 0x31);
+
+    // Same round as metroHashBulk, one buffer per lane
+    V0 = _mm256_add_epi64(V0, metroHashMultiplyAVX2(W0, K0));
+    V0 = _mm256_add_epi64(_mm256_or_si256(_mm256_srli_epi64(V0, 29), _mm256_slli_epi64(V0, 35)), V2);
+    V1 = _mm256_add_epi64(V1, metroHashMultiplyAVX2(W1, K1));
+    V1 = _mm256_add_epi64(_mm256_or_si256(_mm256_srli_epi64(V1, 29), _mm256_slli_epi64(V1, 35)), V3);
+    V2 = _mm256_add_epi64(V2, metroHashMultiplyAVX2(W2, K2));
+    V2 = _mm256_add_epi64(_mm256_or_si256(_mm256_srli_epi64(V2, 29), _mm256_slli_epi64(V2, 35)), V0);
+    V3 = _mm256_add_epi64(V3, metroHashMultiplyAVX2(W3, K3));
+    V3 = _mm256_add_epi64(_mm256_or_si256(_mm256_srli_epi64(V3, 29), _mm256_slli_epi64(V3, 35)), V1);
+  }
+
+  uint64_t lanes[4][4];
+  _mm256_storeu_si256((__m256i*)lanes[0], V0);
+  _mm256_storeu_si256((__m256i*)lanes[1], V1);
+  _mm256_storeu_si256((__m256i*)lanes[2], V2);
+  _mm256_storeu_si256((__m256i*)lanes[3], V3);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    uint64_t state[4] = {lanes[0][i], lanes[1][i], lanes[2][i], lanes[3][i]};
+    hashes[i]         = metroHashFinalize(state, p[i] + blockCount * 32, size % 32, blockCount > 0);
+  }
+}
+
+// GCC 12 flags the _mm512_undefined_epi32() placeholders inside its own AVX-512 intrinsics as uninitialized (GCC PR 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+/**
+ * Multiplies each 64-bit lane by a constant that fits in 32 bits (avoids requiring AVX-512DQ)
+ *
+ * @param[in] x The lanes to multiply
+ * @param[in] k The broadcast 32-bit constant
+ * @return The lane-wise product, modulo 2^64
+ */
+__attribute__((target("avx512f"))) __JAFFAR_COMMON_INLINE__ __m512i metroHashMultiplyAVX512(const __m512i x, const __m512i k)
+{
+  return _mm512_add_epi64(_mm512_mul_epu32(x, k), _mm512_slli_epi64(_mm512_mul_epu32(_mm512_srli_epi64(x, 32), k), 32));
+}
+
+/**
+ * Hashes up to eight same-sized buffers at once, running their independent MetroHash128 bulk loops in the eight 64-bit
+ * lanes of AVX-512 registers. Finalization is done in scalar code per buffer.
+ *
+ * @param[in] buffers The buffers to hash
+ * @param[in] count The number of buffers in the group (at most 8)
+ * @param[in] size The size of every buffer
+ * @param[out] hashes Storage for the count resulting hashes
+ */
+__attribute__((target("avx512f"))) __JAFFAR_COMMON_INLINE__ void metroHashBatchAVX512(const uint8_t* const* buffers, const size_t count, const size_t size, hash_t* hashes)
+{
+  const size_t blockCount = size / 32;
+
+  // The transpose below leaves buffer i in lane laneOf[i]
+  constexpr size_t laneOf[8] = {0, 1, 4, 5, 2, 3, 6, 7};
+
+  // Filling unused lanes with a valid pointer; their results are discarded
+  const uint8_t* p[8];
+  for (size_t i = 0; i < 8; i++) p[i] = buffers[i < count ? i : 0];
+
+  uint64_t v[4];
+  metroHashInitialize(v);
+  __m512i V0 = _mm512_set1_epi64((long long)v[0]);
+  __m512i V1 = _mm512_set1_epi64((long long)v[1]);
+  __m512i V2 = _mm512_set1_epi64((long long)v[2]);
+  __m512i V3 = _mm512_set1_epi64((long long)v[3]);
+
+  const __m512i K0 = _mm512_set1_epi64((long long)metroHashConstants[0]);
+  const __m512i K1 = _mm512_set1_epi64((long long)metroHashConstants[1]);
+  const __m512i K2 = _mm512_set1_epi64((long long)metroHashConstants[2]);
+  const __m512i K3 = _mm512_set1_epi64((long long)metroHashConstants[3]);
+
+  for (size_t b = 0, offset = 0; b < blockCount; b++, offset += 32)
+  {
+    // Loading one block from each buffer (two buffers per register) and transposing so that Wj holds word j of every buffer
+    const __m512i a0 = _mm512_mask_broadcast_i64x4(_mm512_maskz_loadu_epi64(0x0F, p[0] + offset), 0xF0, _mm256_loadu_si256((const __m256i*)(p[4] + offset)));
+    const __m512i a1 = _mm512_mask_broadcast_i64x4(_mm512_maskz_loadu_epi64(0x0F, p[1] + offset), 0xF0, _mm256_loadu_si256((const __m256i*)(p[5] + offset)));
+    const __m512i a2 = _mm512_mask_broadcast_i64x4(_mm512_maskz_loadu_epi64(0x0F, p[2] + offset), 0xF0, _mm256_loadu_si256((const __m256i*)(p[6] + offset)));
+    const __m512i a3 = _mm512_mask_broadcast_i64x4(_mm512_maskz_loadu_epi64(0x0F, p[3] + offset), 0xF0, _mm256_loadu_si256((const __m256i*)(p[7] + offset)));
+    const __m512i t0 = _mm512_unpacklo_epi64(a0, a1);
+    const __m512i t1 = _mm512_unpackhi_epi64(a0, a1);
+    const __m512i t2 = _mm512_unpacklo_epi64(a2, a3);
+    const __m512i t3 = _mm512_unpackhi_epi64(a2, a3);
+    const __m512i W0 = _mm512_shuffle_i64x2(t0, t2, 0x88);
+    const __m512i W1 = _mm512_shuffle_i64x2(t1, t3, 0x88);
+    const __m512i W2 = _mm512_shuffle_i64x2(t0, t2, 0xDD);
+    const __m512i W3 = _mm512_shuffle_i64x2(t1, t3, 0xDD);
+
+    // Same round as metroHashBulk, one buffer per lane
+    V0 = _mm512_add_epi64(_mm512_ror_epi64(_mm512_add_epi64(V0, metroHashMultiplyAVX512(W0, K0)), 29), V2);
+    V1 = _mm512_add_epi64(_mm512_ror_epi64(_mm512_add_epi64(V1, metroHashMultiplyAVX512(W1, K1)), 29), V3);
+    V2 = _mm512_add_epi64(_mm512_ror_epi64(_mm512_add_epi64(V2, metroHashMultiplyAVX512(W2, K2)), 29), V0);
+    V3 = _mm512_add_epi64(_mm512_ror_epi64(_mm512_add_epi64(V3, metroHashMultiplyAVX512(W3, K3)), 29), V1);
+  }
+
+  uint64_t lanes[4][8];
+  _mm512_storeu_si512((void*)lanes[0], V0);
+  _mm512_storeu_si512((void*)lanes[1], V1);
+  _mm512_storeu_si512((void*)lanes[2], V2);
+  _mm512_storeu_si512((void*)lanes[3], V3);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    const size_t lane     = laneOf[i];
+    uint64_t     state[4] = {lanes[0][lane], lanes[1][lane], lanes[2][lane], lanes[3][lane]};
+    hashes[i]             = metroHashFinalize(state, p[i] + blockCount * 32, size % 32, blockCount > 0);
+  }
+}
+
+#pragma GCC diagnostic pop
+
+#endif // __x86_64__
+
+/**
+ * Type of the group kernels used by the batched hashing API
+ */
+typedef void (*metroHashBatchKernel_t)(const uint8_t* const* buffers, const size_t count, const size_t size, hash_t* hashes);
+
+/**
+ * Selects the widest batched kernel supported by the running CPU. The check is done once and cached.
+ *
+ * @param[out] width The number of buffers the selected kernel processes per call
+ * @return The selected kernel
+ */
+__JAFFAR_COMMON_INLINE__ metroHashBatchKernel_t getMetroHashBatchKernel(size_t& width)
+{
+#if defined(__x86_64__)
+  static const bool hasAVX512 = __builtin_cpu_supports("avx512f");
+  static const bool hasAVX2   = __builtin_cpu_supports("avx2");
+  if (hasAVX512)
+  {
+    width = 8;
+    return metroHashBatchAVX512;
+  }
+  if (hasAVX2)
+  {
+    width = 4;
+    return metroHashBatchAVX2;
+  }
+#endif
+  width = metroHashBatchWidth;
+  return metroHashBatchScalar;
+}
+
+/**
+ * Calculates the 128-bit Metrohash of many same-sized buffers in one call
+ *
+ * Independent buffers are hashed side by side in SIMD lanes (AVX-512 or AVX2, selected at runtime) with a scalar
+ * fallback. Each result is bit-identical to calling calculateMetroHash on the corresponding buffer.
+ *
+ * @param[in] buffers Array of count pointers to the buffers to hash
+ * @param[in] count The number of buffers to hash
+ * @param[in] size The size of every buffer
+ * @param[out] hashes Storage for the count resulting hashes
+ */
+__JAFFAR_COMMON_INLINE__ void calculateMetroHashBatch(const void* const* buffers, const size_t count, const size_t size, hash_t* hashes)
+{
+  size_t     width  = 0;
+  const auto kernel = getMetroHashBatchKernel(width);
+  for (size_t i = 0; i < count; i += width) kernel((const uint8_t* const*)&buffers[i], count - i < width ? count - i : width, size, &hashes[i]);
+}
+
+/**
+ * Calculates the 128-bit Metrohash of many same-sized buffers laid out in a single strided arena
+ *
+ * @param[in] arena The start of the arena; buffer i starts at arena + i * stride
+ * @param[in] stride The distance (in bytes) between the starts of consecutive buffers
+ * @param[in] count The number of buffers to hash
+ * @param[in] size The size of every buffer (at most stride)
+ * @param[out] hashes Storage for the count resulting hashes
+ */
+__JAFFAR_COMMON_INLINE__ void calculateMetroHashStrided(const void* arena, const size_t stride, const size_t count, const size_t size, hash_t* hashes)
+{
+  size_t         width  = 0;
+  const auto     kernel = getMetroHashBatchKernel(width);
+  const uint8_t* base   = (const uint8_t*)arena;
+  const uint8_t* buffers[metroHashBatchWidth];
+  for (size_t i = 0; i < count; i += width)
+  {
+    const size_t groupSize = count - i < width ? count - i : width;
+    for (size_t j = 0; j < groupSize; j++) buffers[j] = base + (i + j) * stride;
+    kernel(buffers, groupSize, size, &hashes[i]);
+  }
+}
+
+/**
+ * MetroHash128 hashing backend (the default)
+ *
+ * Hashing backends are compile-time policies used wherever the hash function is a template parameter (e.g., calculateHash,
+ * IncrementalHasher). Every backend produces a 128-bit hash_t and exposes the same interface:
+ *
+ *  - A streaming context: update() any number of times, then finalize(), which also resets the context for reuse
+ *  - static calculate(): one-shot hash of a single buffer
+ *  - static calculateBatch(): one-shot hash of many same-sized buffers
+ *  - static name: a human-readable identifier (used by the benchmarks)
+ *
+ * Other backends can be found under hashers/.
+ */
+class MetroHash128Hasher
+{
+public:
+  /**
+   * Human-readable name of the backend
+   */
+  static constexpr const char* name = "MetroHash128";
+
+  /**
+   * Feeds bytes into the streaming context
+   *
+   * @param[in] data The input bytes
+   * @param[in] size The number of input bytes
+   */
+  __JAFFAR_COMMON_INLINE__ void update(const void* data, const size_t size) { _context.Update(data, size); }
+
+  /**
+   * Produces the hash of all bytes fed so far and resets the context
+   *
+   * @return The 128-bit hash
+   */
+  __JAFFAR_COMMON_INLINE__ hash_t finalize()
+  {
+    hash_t result;
+    _context.Finalize(reinterpret_cast<uint8_t*>(&result));
+    _context.Initialize();
+    return result;
+  }
+
+  /**
+   * Hashes a single buffer
+   *
+   * @param[in] data The input buffer to hash
+   * @param[in] size The size of the buffer to hash
+   * @return The 128-bit hash
+   */
+  static __JAFFAR_COMMON_INLINE__ hash_t calculate(const void* data, const size_t size) { return calculateMetroHash(data, size); }
+
+  /**
+   * Hashes many same-sized buffers
+   *
+   * @param[in] buffers Array of count pointers to the buffers to hash
+   * @param[in] count The number of buffers to hash
+   * @param[in] size The size of every buffer
+   * @param[out] hashes Storage for the count resulting hashes
+   */
+  static __JAFFAR_COMMON_INLINE__ void calculateBatch(const void* const* buffers, const size_t count, const size_t size, hash_t* hashes)
+  {
+    calculateMetroHashBatch(buffers, count, size, hashes);
+  }
+
+private:
+  /**
+   * Internal MetroHash128 streaming context
+   */
+  MetroHash128 _context;
+};
+
+/**
+ * Calculates the 128-bit hash of a given buffer with the selected backend
+ *
+ * @tparam Hasher The hashing backend to use (MetroHash128 by default)
+ * @param[in] data The input buffer to hash
+ * @param[in] size The size of the buffer to hash
+ * @return The calculated 128-bit hash
+ */
+template <class Hasher = MetroHash128Hasher>
+__JAFFAR_COMMON_INLINE__ hash_t calculateHash(const void* data, const size_t size)
+{
+  return Hasher::calculate(data, size);
+}
+
+/**
+ * Calculates the 128-bit tree hash of a (very large) buffer, hashing fixed-size chunks concurrently
+ *
+ * The chunks are distributed among the OpenMP thread team, and the resulting list of chunk digests, followed by the
+ * buffer size and the chunk size (as 64-bit integers), is hashed again into the final result. The result therefore
+ * only depends on the contents and the chunk size: it is the same for any number of threads.
+ *
+ * @note The result is not equal to calculateHash() of the same buffer
+ *
+ * @tparam Hasher The hashing backend to use (MetroHash128 by default)
+ * @param[in] data The input buffer to hash
+ * @param[in] size The size of the buffer to hash
+ * @param[in] chunkSize The size of each chunk. Larger chunks reduce overhead; smaller chunks balance better across threads
+ * @return The calculated 128-bit hash
+ */
+template <class Hasher = MetroHash128Hasher>
+__JAFFAR_COMMON_INLINE__ hash_t calculateParallelHash(const void* data, const size_t size, const size_t chunkSize = 4 * 1024 * 1024)
+{
+  if (chunkSize == 0) JAFFAR_THROW_LOGIC("The chunk size must be a positive number");
+
+  const uint8_t*      ptr        = (const uint8_t*)data;
+  const size_t        chunkCount = size == 0 ? 1 : (size + chunkSize - 1) / chunkSize;
+  std::vector<hash_t> digests(chunkCount);
+
+  // Each chunk's digest goes to its own slot, so the scheduling does not affect the result
+  JAFFAR_PARALLEL_FOR
+  for (size_t i = 0; i < chunkCount; i++) digests[i] = Hasher::calculate(&ptr[i * chunkSize], std::min(chunkSize, size - i * chunkSize));
+
+  const uint64_t sizes[2] = {(uint64_t)size, (uint64_t)chunkSize};
+  Hasher         hasher;
+  hasher.update(digests.data(), chunkCount * sizeof(hash_t));
+  hasher.update(sizes, sizeof(sizes));
+  return hasher.finalize();
+}
+
+/**
+ * Precompiled list of byte ranges to skip when hashing fixed-size buffers
+ *
+ * States often contain volatile regions (frame counters, RNG scratch, timers) that should not tell two states apart.
+ * Instead of copying the state and zeroing those regions, the exclusions are compiled once into a sorted list of the
+ * byte segments that remain, which calculateMaskedHash() then streams directly from the original buffer.
+ *
+ * @note The masked hash is the hash of the kept bytes concatenated together. It is not equal to the hash of the
+ *       buffer with the excluded ranges zeroed.
+ */
+class HashMask
+{
+public:
+  /**
+   * Builds a mask from a list of excluded byte ranges. Ranges may be unsorted, overlapping or empty
+   *
+   * @param[in] bufferSize The size of the buffers the mask applies to
+   * @param[in] excludedRanges The excluded ranges, as (offset, size) pairs
+   */
+  HashMask(const size_t bufferSize, const std::vector<std::pair<size_t, size_t>>& excludedRanges) : _bufferSize(bufferSize)
+  {
+    for (const auto& range : excludedRanges)
+      if (range.first > _bufferSize || range.second > _bufferSize - range.first)
+        JAFFAR_THROW_LOGIC("Excluded range (%lu + %lu) exceeds the buffer size (%lu)", range.first, range.second, _bufferSize);
+
+    compile(excludedRanges);
+  }
+
+  /**
+   * Builds a mask from a per-byte bitmap
+   *
+   * @param[in] excludedBytes One entry per buffer byte, true if the byte is to be excluded. Its size determines the buffer size
+   */
+  HashMask(const std::vector<bool>& excludedBytes) : _bufferSize(excludedBytes.size())
+  {
+    // Converting runs of excluded bytes into ranges
+    std::vector<std::pair<size_t, size_t>> excludedRanges;
+    for (size_t i = 0; i < _bufferSize; i++)
+    {
+      if (excludedBytes[i] == false) continue;
+      const size_t start = i;
+      while (i < _bufferSize && excludedBytes[i] == true) i++;
+      excludedRanges.push_back({start, i - start});
+    }
+
+    compile(excludedRanges);
+  }
+
+  /**
+   * Gets the size of the buffers this mask applies to
+   *
+   * @return The buffer size
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getBufferSize() const { return _bufferSize; }
+
+  /**
+   * Gets the number of bytes that are actually hashed
+   *
+   * @return The number of bytes outside the excluded ranges
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getHashedSize() const { return _hashedSize; }
+
+  /**
+   * Gets the compiled list of hashed segments
+   *
+   * @return The sorted, non-overlapping and non-adjacent hashed segments, as (offset, size) pairs
+   */
+  __JAFFAR_COMMON_INLINE__ const std::vector<std::pair<size_t, size_t>>& getSegments() const { return _segments; }
+
+private:
+  /**
+   * Turns a list of excluded ranges into the complementary list of hashed segments
+   *
+   * @param[in] excludedRanges The (already validated) excluded ranges, as (offset, size) pairs
+   */
+  __JAFFAR_COMMON_INLINE__ void compile(std::vector<std::pair<size_t, size_t>> excludedRanges)
+  {
+    std::sort(excludedRanges.begin(), excludedRanges.end());
+
+    // Walking the excluded ranges in order; the gaps between them are the hashed segments
+    size_t position = 0;
+    for (const auto& range : excludedRanges)
+    {
+      if (range.second == 0) continue;
+      if (range.first > position) _segments.push_back({position, range.first - position});
+      position = std::max(position, range.first + range.second);
+    }
+    if (position < _bufferSize) _segments.push_back({position, _bufferSize - position});
+
+    _hashedSize = 0;
+    for (const auto& segment : _segments) _hashedSize += segment.second;
+  }
+
+  /**
+   * The size of the buffers this mask applies to
+   */
+  size_t _bufferSize;
+
+  /**
+   * The number of bytes outside the excluded ranges
+   */
+  size_t _hashedSize;
+
+  /**
+   * The hashed segments, as (offset, size) pairs
+   */
+  std::vector<std::pair<size_t, size_t>> _segments;
+};
+
+/**
+ * Calculates the 128-bit hash of a buffer, skipping the byte ranges excluded by a mask, in a single pass and without copying
+ *
+ * @tparam Hasher The hashing backend to use (MetroHash128 by default)
+ * @param[in] data The input buffer to hash
+ * @param[in] size The size of the buffer to hash. It must match the size the mask was built for
+ * @param[in] mask The precompiled exclusion mask
+ * @return The calculated 128-bit hash
+ */
+template <class Hasher = MetroHash128Hasher>
+__JAFFAR_COMMON_INLINE__ hash_t calculateMaskedHash(const void* data, const size_t size, const HashMask& mask)
+{
+  if (size != mask.getBufferSize()) JAFFAR_THROW_LOGIC("Buffer size (%lu) does not match the mask's buffer size (%lu)", size, mask.getBufferSize());
+
+  const uint8_t* ptr      = (const uint8_t*)data;
+  const auto&    segments = mask.getSegments();
+
+  // A single contiguous segment goes through the faster one-shot path
+  if (segments.size() == 1) return Hasher::calculate(ptr + segments[0].first, segments[0].second);
+
+  Hasher hasher;
+  for (const auto& segment : segments) hasher.update(ptr + segment.first, segment.second);
+  return hasher.finalize();
+}
+
 /**
  * Produces an output string given a 128-bit hash
  *
@@ -0,0 +1,292 @@
+#pragma once
+
+/**
+ * @file crc32c.hpp
+ * @brief Contains a hardware-assisted hashing backend based on folded CRC32C lanes
+ */
+
+#include "../hash.hpp"
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace jaffarCommon
+{
+
+namespace hash
+{
+
+/**
+ * Byte-wise lookup table for the software CRC32C path (reflected Castagnoli polynomial 0x82F63B78)
+ */
+inline constexpr std::array<uint32_t, 256> crc32cTable = []() {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    uint32_t crc = i;
+    for (size_t j = 0; j < 8; j++) crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78u : 0u);
+    table[i] = crc;
+  }
+  return table;
+}();
+
+/**
+ * CRC32C-based hashing backend
+ *
+ * The input is consumed in 32-byte blocks by four CRC32C lanes (one per 8-byte word), which keeps the CPU's CRC unit
+ * busy despite its latency. Before being absorbed, each word is XOR-ed with the state of the neighbouring lane (see
+ * spread()), so a change confined to one lane reaches all four within four blocks (and through four extra mixing
+ * rounds at the end); without this, a localized change would only ever reach 32 bits of state. The four 32-bit lane
+ * states and the input length are folded into a 128-bit hash_t through a bijective 64-bit mixer. The SSE4.2 crc32
+ * instruction is used when the running CPU supports it (checked once at runtime); otherwise a bit-identical
+ * table-driven implementation is used.
+ *
+ * @note The lane update is linear over GF(2), so inputs can be crafted to collide. This is irrelevant for emulator
+ *       states, but MetroHash128Hasher should be preferred where adversarial inputs are possible.
+ */
+class CRC32CHasher
+{
+public:
+  /**
+   * Human-readable name of the backend
+   */
+  static constexpr const char* name = "CRC32C-Fold";
+
+  CRC32CHasher() { reset(); }
+
+  /**
+   * Feeds bytes into the streaming context
+   *
+   * @param[in] data The input bytes
+   * @param[in] size The number of input bytes
+   */
+  __JAFFAR_COMMON_INLINE__ void update(const void* data, const size_t size)
+  {
+    const uint8_t* ptr       = (const uint8_t*)data;
+    size_t         remaining = size;
+    _length += size;
+
+    // Completing a partially filled block first
+    if (_pending > 0)
+    {
+      const size_t fill = remaining < 32 - _pending ? remaining : 32 - _pending;
+      memcpy(&_block[_pending], ptr, fill);
+      _pending += fill, ptr += fill, remaining -= fill;
+      if (_pending < 32) return;
+      processBlocks(_lanes, _block, 1);
+      _pending = 0;
+    }
+
+    // Bulk processing directly from the source
+    const size_t blockCount = remaining / 32;
+    processBlocks(_lanes, ptr, blockCount);
+    ptr += blockCount * 32, remaining -= blockCount * 32;
+
+    // Storing the remaining bytes for later
+    memcpy(_block, ptr, remaining);
+    _pending = remaining;
+  }
+
+  /**
+   * Produces the hash of all bytes fed so far and resets the context
+   *
+   * @return The 128-bit hash
+   */
+  __JAFFAR_COMMON_INLINE__ hash_t finalize()
+  {
+    // The trailing partial block is zero-padded; the length, mixed in below, tells it apart from real zeroes
+    if (_pending > 0)
+    {
+      memset(&_block[_pending], 0, 32 - _pending);
+      processBlocks(_lanes, _block, 1);
+    }
+
+    // Spreading the last blocks' changes across all lanes
+    const uint8_t zeros[32] = {0};
+    for (size_t i = 0; i < 4; i++) processBlocks(_lanes, zeros, 1);
+
+    const hash_t result = fold(_lanes, _length);
+    reset();
+    return result;
+  }
+
+  /**
+   * Hashes a single buffer
+   *
+   * @param[in] data The input buffer to hash
+   * @param[in] size The size of the buffer to hash
+   * @return The 128-bit hash
+   */
+  static __JAFFAR_COMMON_INLINE__ hash_t calculate(const void* data, const size_t size)
+  {
+    CRC32CHasher hasher;
+    hasher.update(data, size);
+    return hasher.finalize();
+  }
+
+  /**
+   * Hashes many same-sized buffers
+   *
+   * @param[in] buffers Array of count pointers to the buffers to hash
+   * @param[in] count The number of buffers to hash
+   * @param[in] size The size of every buffer
+   * @param[out] hashes Storage for the count resulting hashes
+   */
+  static __JAFFAR_COMMON_INLINE__ void calculateBatch(const void* const* buffers, const size_t count, const size_t size, hash_t* hashes)
+  {
+    for (size_t i = 0; i < count; i++) hashes[i] = calculate(buffers[i], size);
+  }
+
+  /**
+   * Software CRC32C (Castagnoli, reflected polynomial 0x82F63B78) of a single 64-bit word, matching the SSE4.2 crc32 instruction
+   *
+   * @param[in] crc The running CRC value
+   * @param[in] word The word to absorb (little-endian byte order)
+   * @return The updated CRC value
+   */
+  static __JAFFAR_COMMON_INLINE__ uint32_t crc32cSoftware(uint32_t crc, uint64_t word)
+  {
+    for (size_t i = 0; i < 8; i++, word >>= 8) crc = crc32cTable[(crc ^ (uint8_t)word) & 0xFF] ^ (crc >> 8);
+    return crc;
+  }
+
+private:
+  /**
+   * Resets the context to its initial state
+   */
+  __JAFFAR_COMMON_INLINE__ void reset()
+  {
+    for (size_t i = 0; i < 4; i++) _lanes[i] = 0xFFFFFFFFu ^ (uint32_t)(i * 0x9E3779B9u);
+    _length  = 0;
+    _pending = 0;
+  }
+
+  /**
+   * Expands a lane state into the 64-bit value XOR-ed into the neighbouring lane's input word
+   *
+   * The state goes into the low half as is and into the high half rotated by 16 bits. The rotation matters: CRC updates
+   * are multiplications modulo the CRC polynomial, and injecting the plain state (which commutes with them) lets lane
+   * differences cancel out after a few blocks. With the rotation, the per-block state transition stays invertible
+   * (no two lane states map to the same successor) and every lane influences every other one.
+   *
+   * @param[in] lane The lane state
+   * @return The value to XOR into the neighbouring input word
+   */
+  static __JAFFAR_COMMON_INLINE__ uint64_t spread(const uint32_t lane) { return ((uint64_t)((lane << 16) | (lane >> 16)) << 32) | lane; }
+
+  /**
+   * Absorbs whole 32-byte blocks, one 8-byte word per lane, with the software implementation
+   *
+   * @param[in,out] lanes The four lane states
+   * @param[in] ptr The blocks to absorb
+   * @param[in] blockCount The number of blocks
+   */
+  static __JAFFAR_COMMON_INLINE__ void processBlocksSoftware(uint32_t lanes[4], const uint8_t* ptr, const size_t blockCount)
+  {
+    for (size_t b = 0; b < blockCount; b++, ptr += 32)
+    {
+      const uint32_t l0 = crc32cSoftware(lanes[0], metroHashRead(ptr + 0, 8) ^ spread(lanes[1]));
+      const uint32_t l1 = crc32cSoftware(lanes[1], metroHashRead(ptr + 8, 8) ^ spread(lanes[2]));
+      const uint32_t l2 = crc32cSoftware(lanes[2], metroHashRead(ptr + 16, 8) ^ spread(lanes[3]));
+      const uint32_t l3 = crc32cSoftware(lanes[3], metroHashRead(ptr + 24, 8) ^ spread(lanes[0]));
+      lanes[0] = l0, lanes[1] = l1, lanes[2] = l2, lanes[3] = l3;
+    }
+  }
+
+#if defined(__x86_64__)
+  /**
+   * Absorbs whole 32-byte blocks, one 8-byte word per lane, with the SSE4.2 crc32 instruction
+   *
+   * @param[in,out] lanes The four lane states
+   * @param[in] ptr The blocks to absorb
+   * @param[in] blockCount The number of blocks
+   */
+  __attribute__((target("sse4.2"))) static __JAFFAR_COMMON_INLINE__ void processBlocksHardware(uint32_t lanes[4], const uint8_t* ptr, const size_t blockCount)
+  {
+    uint32_t l0 = lanes[0], l1 = lanes[1], l2 = lanes[2], l3 = lanes[3];
+    for (size_t b = 0; b < blockCount; b++, ptr += 32)
+    {
+      const uint32_t n0 = (uint32_t)_mm_crc32_u64(l0, metroHashRead(ptr + 0, 8) ^ spread(l1));
+      const uint32_t n1 = (uint32_t)_mm_crc32_u64(l1, metroHashRead(ptr + 8, 8) ^ spread(l2));
+      const uint32_t n2 = (uint32_t)_mm_crc32_u64(l2, metroHashRead(ptr + 16, 8) ^ spread(l3));
+      const uint32_t n3 = (uint32_t)_mm_crc32_u64(l3, metroHashRead(ptr + 24, 8) ^ spread(l0));
+      l0 = n0, l1 = n1, l2 = n2, l3 = n3;
+    }
+    lanes[0] = l0, lanes[1] = l1, lanes[2] = l2, lanes[3] = l3;
+  }
+#endif
+
+  /**
+   * Absorbs whole 32-byte blocks using the fastest implementation available
+   *
+   * @param[in,out] lanes The four lane states
+   * @param[in] ptr The blocks to absorb
+   * @param[in] blockCount The number of blocks
+   */
+  static __JAFFAR_COMMON_INLINE__ void processBlocks(uint32_t lanes[4], const uint8_t* ptr, const size_t blockCount)
+  {
+#if defined(__x86_64__)
+    static const bool hasSSE42 = __builtin_cpu_supports("sse4.2");
+    if (hasSSE42) return processBlocksHardware(lanes, ptr, blockCount);
+#endif
+    processBlocksSoftware(lanes, ptr, blockCount);
+  }
+
+  /**
+   * Bijective 64-bit finalization mixer (MurmurHash3 fmix64)
+   *
+   * @param[in] x The value to mix
+   * @return The mixed value
+   */
+  static __JAFFAR_COMMON_INLINE__ uint64_t mix(uint64_t x)
+  {
+    x ^= x >> 33, x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33, x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+  }
+
+  /**
+   * Folds the four lane states and the input length into a 128-bit hash
+   *
+   * @param[in] lanes The four lane states
+   * @param[in] length The total number of bytes absorbed
+   * @return The 128-bit hash
+   */
+  static __JAFFAR_COMMON_INLINE__ hash_t fold(const uint32_t lanes[4], const uint64_t length)
+  {
+    const uint64_t a      = ((uint64_t)lanes[0] << 32) | lanes[1];
+    const uint64_t b      = ((uint64_t)lanes[2] << 32) | lanes[3];
+    const uint64_t first  = mix(a ^ (length * 0x9E3779B97F4A7C15ull));
+    const uint64_t second = mix(b ^ first);
+    return hash_t(first, second);
+  }
+
+  /**
+   * The four CRC32C lane states
+   */
+  uint32_t _lanes[4];
+
+  /**
+   * Total number of bytes absorbed
+   */
+  uint64_t _length;
+
+  /**
+   * Bytes waiting for a full block
+   */
+  uint8_t _block[32];
+
+  /**
+   * Number of bytes waiting in _block
+   */
+  size_t _pending;
+};
+
+} // namespace hash
+
+} // namespace jaffarCommon
\ No newline at end of file
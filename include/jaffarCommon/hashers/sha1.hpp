@@ -0,0 +1,268 @@
+#pragma once
+
+/**
+ * @file sha1.hpp
+ * @brief Contains a streaming SHA1 implementation with a runtime-selected SHA-NI accelerated path
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace jaffarCommon
+{
+
+namespace hash
+{
+
+#if defined(__x86_64__)
+/**
+ * Runs one group of four SHA1 rounds with the SHA-NI instructions, along with its share of the message schedule
+ *
+ * The 80 rounds are 20 such groups. The two E registers alternate roles from one group to the next, and the four
+ * message registers rotate, so every group is a compile-time instance; they chain into each other up to group 19.
+ *
+ * @tparam Group The index of the group (0 to 19)
+ * @param[in,out] abcd The A, B, C and D working variables
+ * @param[in,out] e0 The first E register
+ * @param[in,out] e1 The second E register
+ * @param[in,out] message The four message schedule registers
+ * @param[in] block The 64-byte block being processed
+ * @param[in] byteSwapMask The shuffle mask that turns little-endian input into SHA1's big-endian words
+ */
+template <int Group>
+__attribute__((target("sha,ssse3,sse4.1"))) __JAFFAR_COMMON_INLINE__ void sha1RoundGroupSHANI(__m128i& abcd, __m128i& e0, __m128i& e1, __m128i message[4], const uint8_t* block,
+                                                                                               const __m128i byteSwapMask)
+{
+  __m128i& current = Group % 2 == 0 ? e0 : e1;
+  __m128i& next    = Group % 2 == 0 ? e1 : e0;
+
+  // The first four groups consume the block itself; later ones use the expanded schedule
+  if constexpr (Group < 4) message[Group] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(block + 16 * Group)), byteSwapMask);
+  if constexpr (Group == 0) current = _mm_add_epi32(current, message[0]);
+  if constexpr (Group > 0) current = _mm_sha1nexte_epu32(current, message[Group % 4]);
+
+  next = abcd;
+  if constexpr (Group >= 3 && Group <= 18) message[(Group + 1) % 4] = _mm_sha1msg2_epu32(message[(Group + 1) % 4], message[Group % 4]);
+  abcd = _mm_sha1rnds4_epu32(abcd, current, Group / 5);
+  if constexpr (Group >= 1 && Group <= 16) message[(Group + 3) % 4] = _mm_sha1msg1_epu32(message[(Group + 3) % 4], message[Group % 4]);
+  if constexpr (Group >= 2 && Group <= 17) message[(Group + 2) % 4] = _mm_xor_si128(message[(Group + 2) % 4], message[Group % 4]);
+
+  if constexpr (Group < 19) sha1RoundGroupSHANI<Group + 1>(abcd, e0, e1, message, block, byteSwapMask);
+}
+
+/**
+ * Absorbs whole 64-byte blocks into a SHA1 state with the SHA-NI instructions
+ *
+ * @param[in,out] state The five SHA1 state words
+ * @param[in] data The blocks to absorb
+ * @param[in] blockCount The number of blocks
+ */
+__attribute__((target("sha,ssse3,sse4.1"))) __JAFFAR_COMMON_INLINE__ void sha1ProcessBlocksSHANI(uint32_t state[5], const uint8_t* data, const size_t blockCount)
+{
+  const __m128i byteSwapMask = _mm_set_epi64x(0x0001020304050607ull, 0x08090A0B0C0D0E0Full);
+
+  // The instructions expect A in the highest lane and E in the highest lane of its own register
+  __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+  __m128i e0   = _mm_set_epi32((int)state[4], 0, 0, 0);
+  __m128i e1;
+  __m128i message[4];
+
+  for (size_t i = 0; i < blockCount; i++, data += 64)
+  {
+    const __m128i abcdSaved = abcd;
+    const __m128i eSaved    = e0;
+    sha1RoundGroupSHANI<0>(abcd, e0, e1, message, data, byteSwapMask);
+    e0   = _mm_sha1nexte_epu32(e0, eSaved);
+    abcd = _mm_add_epi32(abcd, abcdSaved);
+  }
+
+  _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+  state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+#endif
+
+/**
+ * Absorbs whole 64-byte blocks into a SHA1 state (portable implementation)
+ *
+ * @param[in,out] state The five SHA1 state words
+ * @param[in] data The blocks to absorb
+ * @param[in] blockCount The number of blocks
+ */
+__JAFFAR_COMMON_INLINE__ void sha1ProcessBlocksScalar(uint32_t state[5], const uint8_t* data, const size_t blockCount)
+{
+  const auto rotateLeft = [](const uint32_t value, const unsigned bits) { return (value << bits) | (value >> (32 - bits)); };
+
+  for (size_t i = 0; i < blockCount; i++, data += 64)
+  {
+    uint32_t w[80];
+    for (size_t j = 0; j < 16; j++) w[j] = ((uint32_t)data[4 * j] << 24) | ((uint32_t)data[4 * j + 1] << 16) | ((uint32_t)data[4 * j + 2] << 8) | (uint32_t)data[4 * j + 3];
+    for (size_t j = 16; j < 80; j++) w[j] = rotateLeft(w[j - 3] ^ w[j - 8] ^ w[j - 14] ^ w[j - 16], 1);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (size_t j = 0; j < 80; j++)
+    {
+      uint32_t f, k;
+      if (j < 20) f = (b & c) | (~b & d), k = 0x5A827999;
+      else if (j < 40) f = b ^ c ^ d, k = 0x6ED9EBA1;
+      else if (j < 60) f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+      else f = b ^ c ^ d, k = 0xCA62C1D6;
+
+      const uint32_t t = rotateLeft(a, 5) + f + e + k + w[j];
+      e                = d;
+      d                = c;
+      c                = rotateLeft(b, 30);
+      b                = a;
+      a                = t;
+    }
+
+    state[0] += a, state[1] += b, state[2] += c, state[3] += d, state[4] += e;
+  }
+}
+
+/**
+ * Streaming SHA1 hasher
+ *
+ * Unlike sha1::SHA1 (which goes through std::string and stringstream buffers), this one absorbs input directly from
+ * the caller's memory, so large files can be fed block by block without extra copies. The SHA-NI instructions are
+ * used when the running CPU supports them (checked once at runtime).
+ */
+class SHA1Hasher
+{
+public:
+  SHA1Hasher() { reset(); }
+
+  /**
+   * Feeds bytes into the streaming context
+   *
+   * @param[in] data The input bytes
+   * @param[in] size The number of input bytes
+   */
+  __JAFFAR_COMMON_INLINE__ void update(const void* data, const size_t size)
+  {
+    const uint8_t* ptr       = (const uint8_t*)data;
+    size_t         remaining = size;
+    _length += size;
+
+    // Completing a partially filled block first
+    if (_pending > 0)
+    {
+      const size_t fill = remaining < 64 - _pending ? remaining : 64 - _pending;
+      memcpy(&_block[_pending], ptr, fill);
+      _pending += fill, ptr += fill, remaining -= fill;
+      if (_pending < 64) return;
+      processBlocks(_state, _block, 1);
+      _pending = 0;
+    }
+
+    // Bulk processing directly from the source
+    const size_t blockCount = remaining / 64;
+    processBlocks(_state, ptr, blockCount);
+    ptr += blockCount * 64, remaining -= blockCount * 64;
+
+    // Storing the remaining bytes for later
+    memcpy(_block, ptr, remaining);
+    _pending = remaining;
+  }
+
+  /**
+   * Produces the SHA1 digest of all bytes fed so far and resets the context
+   *
+   * @return The digest, formatted as upper case hexadecimal (same format as getSHA1String)
+   */
+  __JAFFAR_COMMON_INLINE__ std::string finalize()
+  {
+    // Padding: a one bit, zeroes up to 8 bytes before the block end, and the message length in bits (big-endian)
+    const uint64_t bitLength = _length * 8;
+    _block[_pending++]       = 0x80;
+    if (_pending > 56)
+    {
+      memset(&_block[_pending], 0, 64 - _pending);
+      processBlocks(_state, _block, 1);
+      _pending = 0;
+    }
+    memset(&_block[_pending], 0, 56 - _pending);
+    for (size_t i = 0; i < 8; i++) _block[56 + i] = (uint8_t)(bitLength >> (56 - 8 * i));
+    processBlocks(_state, _block, 1);
+
+    char digest[41];
+    for (size_t i = 0; i < 5; i++) snprintf(&digest[8 * i], 9, "%08X", _state[i]);
+
+    reset();
+    return std::string(digest);
+  }
+
+  /**
+   * Calculates the SHA1 digest of a single buffer
+   *
+   * @param[in] data The input buffer to hash
+   * @param[in] size The size of the buffer to hash
+   * @return The digest, formatted as upper case hexadecimal
+   */
+  static __JAFFAR_COMMON_INLINE__ std::string calculate(const void* data, const size_t size)
+  {
+    SHA1Hasher hasher;
+    hasher.update(data, size);
+    return hasher.finalize();
+  }
+
+private:
+  /**
+   * Resets the context to its initial state
+   */
+  __JAFFAR_COMMON_INLINE__ void reset()
+  {
+    _state[0] = 0x67452301;
+    _state[1] = 0xEFCDAB89;
+    _state[2] = 0x98BADCFE;
+    _state[3] = 0x10325476;
+    _state[4] = 0xC3D2E1F0;
+    _length   = 0;
+    _pending  = 0;
+  }
+
+  /**
+   * Absorbs whole 64-byte blocks using the fastest implementation available
+   *
+   * @param[in,out] state The five SHA1 state words
+   * @param[in] data The blocks to absorb
+   * @param[in] blockCount The number of blocks
+   */
+  static __JAFFAR_COMMON_INLINE__ void processBlocks(uint32_t state[5], const uint8_t* data, const size_t blockCount)
+  {
+#if defined(__x86_64__)
+    static const bool hasSHA = __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+    if (hasSHA) return sha1ProcessBlocksSHANI(state, data, blockCount);
+#endif
+    sha1ProcessBlocksScalar(state, data, blockCount);
+  }
+
+  /**
+   * The five SHA1 state words
+   */
+  uint32_t _state[5];
+
+  /**
+   * Total number of bytes absorbed
+   */
+  uint64_t _length;
+
+  /**
+   * Bytes waiting for a full block
+   */
+  uint8_t _block[64];
+
+  /**
+   * Number of bytes waiting in _block
+   */
+  size_t _pending;
+};
+
+} // namespace hash
+
+} // namespace jaffarCommon
\ No newline at end of file
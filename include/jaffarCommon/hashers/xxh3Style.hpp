@@ -0,0 +1,288 @@
+#pragma once
+
+/**
+ * @file xxh3Style.hpp
+ * @brief Contains a high-throughput hashing backend modelled after XXH3's accumulation loop
+ */
+
+#include "../hash.hpp"
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace jaffarCommon
+{
+
+namespace hash
+{
+
+/**
+ * XXH3-style hashing backend
+ *
+ * Follows the structure of XXH3-128's long-input loop: eight 64-bit accumulators absorb 64-byte stripes, each word being
+ * keyed with a secret and folded in through a 32x32->64 multiplication (plus the raw word into the neighbouring lane);
+ * after every 16 stripes the accumulators are scrambled. The final 128 bits are obtained by folding accumulator pairs
+ * through 64x64->128 multiplications and an avalanche step. Pairs of accumulators are processed with SSE2 where
+ * available (always on x86-64), with a bit-identical scalar fallback otherwise.
+ *
+ * @note This is not XXH3: the secret, short-input handling and finalization differ, so its outputs do not match xxHash's.
+ */
+class XXH3StyleHasher
+{
+public:
+  /**
+   * Human-readable name of the backend
+   */
+  static constexpr const char* name = "XXH3-Style";
+
+  XXH3StyleHasher() { reset(); }
+
+  /**
+   * Feeds bytes into the streaming context
+   *
+   * @param[in] data The input bytes
+   * @param[in] size The number of input bytes
+   */
+  __JAFFAR_COMMON_INLINE__ void update(const void* data, const size_t size)
+  {
+    const uint8_t* ptr       = (const uint8_t*)data;
+    size_t         remaining = size;
+    _length += size;
+
+    // Completing a partially filled stripe first
+    if (_pending > 0)
+    {
+      const size_t fill = remaining < stripeSize - _pending ? remaining : stripeSize - _pending;
+      memcpy(&_stripe[_pending], ptr, fill);
+      _pending += fill, ptr += fill, remaining -= fill;
+      if (_pending < stripeSize) return;
+      processStripe(_stripe);
+      _pending = 0;
+    }
+
+    // Bulk processing directly from the source
+    while (remaining >= stripeSize)
+    {
+      processStripe(ptr);
+      ptr += stripeSize, remaining -= stripeSize;
+    }
+
+    // Storing the remaining bytes for later
+    memcpy(_stripe, ptr, remaining);
+    _pending = remaining;
+  }
+
+  /**
+   * Produces the hash of all bytes fed so far and resets the context
+   *
+   * @return The 128-bit hash
+   */
+  __JAFFAR_COMMON_INLINE__ hash_t finalize()
+  {
+    // The trailing partial stripe is zero-padded; the length, mixed in below, tells it apart from real zeroes
+    if (_pending > 0)
+    {
+      memset(&_stripe[_pending], 0, stripeSize - _pending);
+      processStripe(_stripe);
+    }
+
+    uint64_t low  = _length * 0x9E3779B185EBCA87ull;
+    uint64_t high = ~(_length * 0xC2B2AE3D27D4EB4Full);
+    for (size_t i = 0; i < 4; i++)
+    {
+      low += multiplyFold(_acc[2 * i] ^ xxh3StyleSecret[2 * i], _acc[2 * i + 1] ^ xxh3StyleSecret[2 * i + 1]);
+      high += multiplyFold(_acc[2 * i] ^ xxh3StyleSecret[2 * i + 9], _acc[2 * i + 1] ^ xxh3StyleSecret[2 * i + 10]);
+    }
+
+    const hash_t result(avalanche(low), avalanche(high));
+    reset();
+    return result;
+  }
+
+  /**
+   * Hashes a single buffer
+   *
+   * @param[in] data The input buffer to hash
+   * @param[in] size The size of the buffer to hash
+   * @return The 128-bit hash
+   */
+  static __JAFFAR_COMMON_INLINE__ hash_t calculate(const void* data, const size_t size)
+  {
+    XXH3StyleHasher hasher;
+    hasher.update(data, size);
+    return hasher.finalize();
+  }
+
+  /**
+   * Hashes many same-sized buffers
+   *
+   * @param[in] buffers Array of count pointers to the buffers to hash
+   * @param[in] count The number of buffers to hash
+   * @param[in] size The size of every buffer
+   * @param[out] hashes Storage for the count resulting hashes
+   */
+  static __JAFFAR_COMMON_INLINE__ void calculateBatch(const void* const* buffers, const size_t count, const size_t size, hash_t* hashes)
+  {
+    for (size_t i = 0; i < count; i++) hashes[i] = calculate(buffers[i], size);
+  }
+
+private:
+  /**
+   * Number of bytes absorbed per stripe (one 64-bit word per accumulator)
+   */
+  static constexpr size_t stripeSize = 64;
+
+  /**
+   * Number of stripes between accumulator scrambles
+   */
+  static constexpr size_t stripesPerBlock = 16;
+
+  /**
+   * The 192-byte secret (24 words). Stripe k of a block is keyed by the 8 words starting at word k, so the 16 stripes
+   * use overlapping windows sliding over words 0 to 22; words 16 to 23 are also the scramble keys
+   */
+  static constexpr std::array<uint64_t, 24> xxh3StyleSecret = []() {
+    std::array<uint64_t, 24> secret{};
+    uint64_t                 state = 0x243F6A8885A308D3ull;
+    for (auto& word : secret)
+    {
+      // SplitMix64 sequence
+      uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+      z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z          = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      word       = z ^ (z >> 31);
+    }
+    return secret;
+  }();
+
+  /**
+   * Resets the context to its initial state
+   */
+  __JAFFAR_COMMON_INLINE__ void reset()
+  {
+    // Same initial accumulators as XXH3
+    _acc[0]  = 0xC2B2AE3Dull;
+    _acc[1]  = 0x9E3779B185EBCA87ull;
+    _acc[2]  = 0xC2B2AE3D27D4EB4Full;
+    _acc[3]  = 0x165667B19E3779F9ull;
+    _acc[4]  = 0x85EBCA77C2B2AE63ull;
+    _acc[5]  = 0x85EBCA77ull;
+    _acc[6]  = 0x27D4EB2F165667C5ull;
+    _acc[7]  = 0x9E3779B1ull;
+    _length  = 0;
+    _pending = 0;
+    _stripes = 0;
+  }
+
+  /**
+   * Absorbs a 64-byte stripe, scrambling the accumulators at the end of every block
+   *
+   * @param[in] ptr The stripe to absorb
+   */
+  __JAFFAR_COMMON_INLINE__ void processStripe(const uint8_t* ptr)
+  {
+    const uint64_t* secret   = &xxh3StyleSecret[_stripes];
+    const bool      scramble = ++_stripes == stripesPerBlock;
+    if (scramble) _stripes = 0;
+
+#if defined(__SSE2__)
+    const __m128i prime = _mm_set1_epi32((int)0x9E3779B1u);
+    for (size_t i = 0; i < 8; i += 2)
+    {
+      const __m128i data = _mm_loadu_si128((const __m128i*)(ptr + 8 * i));
+      const __m128i key  = _mm_xor_si128(data, _mm_loadu_si128((const __m128i*)&secret[i]));
+      // Low 32 bits of each key times its high 32 bits, and each word added to the neighbouring accumulator
+      const __m128i product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(2, 3, 0, 1)));
+      __m128i       acc     = _mm_loadu_si128((const __m128i*)&_acc[i]);
+      acc                   = _mm_add_epi64(acc, _mm_add_epi64(product, _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2))));
+
+      if (scramble)
+      {
+        acc                    = _mm_xor_si128(acc, _mm_srli_epi64(acc, 47));
+        acc                    = _mm_xor_si128(acc, _mm_loadu_si128((const __m128i*)&xxh3StyleSecret[16 + i]));
+        // 64x32-bit multiplication assembled from two 32x32->64 products
+        const __m128i lowPart  = _mm_mul_epu32(acc, prime);
+        const __m128i highPart = _mm_mul_epu32(_mm_srli_epi64(acc, 32), prime);
+        acc                    = _mm_add_epi64(lowPart, _mm_slli_epi64(highPart, 32));
+      }
+      _mm_storeu_si128((__m128i*)&_acc[i], acc);
+    }
+#else
+    for (size_t i = 0; i < 8; i++)
+    {
+      const uint64_t word = metroHashRead(ptr + 8 * i, 8);
+      const uint64_t key  = word ^ secret[i];
+      _acc[i ^ 1] += word;
+      _acc[i] += (key & 0xFFFFFFFFull) * (key >> 32);
+    }
+
+    if (scramble == false) return;
+    for (size_t i = 0; i < 8; i++)
+    {
+      _acc[i] ^= _acc[i] >> 47;
+      _acc[i] ^= xxh3StyleSecret[16 + i];
+      _acc[i] *= 0x9E3779B1ull;
+    }
+#endif
+  }
+
+  /**
+   * Multiplies two 64-bit values into 128 bits and folds the halves together
+   *
+   * @param[in] a First operand
+   * @param[in] b Second operand
+   * @return The XOR of the low and high halves of the product
+   */
+  static __JAFFAR_COMMON_INLINE__ uint64_t multiplyFold(const uint64_t a, const uint64_t b)
+  {
+    const __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+  }
+
+  /**
+   * XXH3's final avalanche step
+   *
+   * @param[in] h The value to mix
+   * @return The mixed value
+   */
+  static __JAFFAR_COMMON_INLINE__ uint64_t avalanche(uint64_t h)
+  {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ull;
+    h ^= h >> 32;
+    return h;
+  }
+
+  /**
+   * The eight accumulators
+   */
+  uint64_t _acc[8];
+
+  /**
+   * Total number of bytes absorbed
+   */
+  uint64_t _length;
+
+  /**
+   * Number of stripes absorbed since the last scramble
+   */
+  size_t _stripes;
+
+  /**
+   * Bytes waiting for a full stripe
+   */
+  uint8_t _stripe[stripeSize];
+
+  /**
+   * Number of bytes waiting in _stripe
+   */
+  size_t _pending;
+};
+
+} // namespace hash
+
+} // namespace jaffarCommon
\ No newline at end of file
@@ -0,0 +1,282 @@
+#pragma once
+
+/**
+ * @file incrementalHash.hpp
+ * @brief Contains a block-tree hasher that only rehashes the regions of a buffer that changed
+ */
+
+#include "exceptions.hpp"
+#include "hash.hpp"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace jaffarCommon
+{
+
+namespace hash
+{
+
+/**
+ * Incremental (Merkle-style) hasher for large, fixed-size buffers
+ *
+ * The buffer is split into fixed-size blocks. Each block is hashed into a leaf digest, and pairs of digests are
+ * hashed together level by level up to a single root, which is the resulting hash_t. After the first full hash,
+ * the caller reports which blocks (or byte ranges) changed and update() only rehashes those leaves and their
+ * ancestors, so the cost of a state hash scales with the size of the change rather than the size of the state.
+ *
+ * A typical use is to copy the parent's hasher into the child (the tree is small: two digests per block), mark the
+ * regions the step modified, and call update() with the child's buffer.
+ *
+ * @note The root is a tree hash: it is not equal to calculateHash() of the whole buffer. It only depends on
+ *       the buffer contents, the buffer size, the block size and the hashing backend.
+ *
+ * @tparam Hasher The hashing backend used for leaves and internal nodes (MetroHash128 by default)
+ */
+template <class Hasher = MetroHash128Hasher>
+class IncrementalHasher
+{
+public:
+  /**
+   * Constructor for the incremental hasher
+   *
+   * @param[in] bufferSize The size of the buffers to hash (fixed for the lifetime of the hasher)
+   * @param[in] blockSize The size of each leaf block. Smaller blocks track changes more precisely at the cost of a larger tree
+   */
+  IncrementalHasher(const size_t bufferSize, const size_t blockSize = 4096) : _bufferSize(bufferSize), _blockSize(blockSize)
+  {
+    if (_blockSize == 0) JAFFAR_THROW_LOGIC("The block size must be a positive number");
+
+    // Calculating the number of nodes at each level of the tree, from the leaves up to the root
+    _leafCount       = _bufferSize == 0 ? 1 : (_bufferSize + _blockSize - 1) / _blockSize;
+    size_t nodeCount = _leafCount;
+    size_t offset    = 0;
+    while (true)
+    {
+      _levelOffsets.push_back(offset);
+      _levelSizes.push_back(nodeCount);
+      offset += nodeCount;
+      if (nodeCount == 1) break;
+      nodeCount = (nodeCount + 1) / 2;
+    }
+
+    _nodes.resize(offset);
+    _dirty.resize(offset, false);
+    _dirtyNodes.resize(_levelSizes.size());
+  }
+
+  ~IncrementalHasher() = default;
+
+  /**
+   * Hashes the entire buffer from scratch, discarding any pending dirty marks
+   *
+   * @param[in] buffer The buffer to hash (of the size given at construction)
+   * @return The root hash of the buffer
+   */
+  __JAFFAR_COMMON_INLINE__ hash_t hashFull(const void* buffer)
+  {
+    const uint8_t* data = (const uint8_t*)buffer;
+
+    // Full-sized blocks go through the batched kernel; the last, possibly partial, block is hashed on its own
+    const size_t fullBlocks = _bufferSize / _blockSize;
+    _leafPointers.resize(fullBlocks);
+    for (size_t i = 0; i < fullBlocks; i++) _leafPointers[i] = &data[i * _blockSize];
+    Hasher::calculateBatch(_leafPointers.data(), fullBlocks, _blockSize, &_nodes[0]);
+    if (fullBlocks < _leafCount) _nodes[fullBlocks] = Hasher::calculate(&data[fullBlocks * _blockSize], _bufferSize - fullBlocks * _blockSize);
+
+    // Recomputing all internal nodes
+    for (size_t level = 1; level < _levelSizes.size(); level++)
+      for (size_t i = 0; i < _levelSizes[level]; i++) hashNode(level, i);
+
+    // Clearing dirty marks
+    for (size_t level = 0; level < _dirtyNodes.size(); level++)
+    {
+      for (const auto node : _dirtyNodes[level]) _dirty[_levelOffsets[level] + node] = false;
+      _dirtyNodes[level].clear();
+    }
+
+    return getRoot();
+  }
+
+  /**
+   * Marks a single block as modified
+   *
+   * @param[in] blockIdx The index of the block that changed
+   */
+  __JAFFAR_COMMON_INLINE__ void markDirtyBlock(const size_t blockIdx)
+  {
+    if (blockIdx >= _leafCount) JAFFAR_THROW_LOGIC("Block index %lu exceeds the block count (%lu)", blockIdx, _leafCount);
+    markDirtyNode(0, blockIdx);
+  }
+
+  /**
+   * Marks a byte range as modified. Every block that overlaps the range will be rehashed on the next update()
+   *
+   * @param[in] offset The starting byte of the modified range
+   * @param[in] size The number of modified bytes
+   */
+  __JAFFAR_COMMON_INLINE__ void markDirtyRange(const size_t offset, const size_t size)
+  {
+    if (size == 0) return;
+    if (offset > _bufferSize || size > _bufferSize - offset) JAFFAR_THROW_LOGIC("Dirty range (%lu + %lu) exceeds the buffer size (%lu)", offset, size, _bufferSize);
+
+    const size_t firstBlock = offset / _blockSize;
+    const size_t lastBlock  = (offset + size - 1) / _blockSize;
+    for (size_t i = firstBlock; i <= lastBlock; i++) markDirtyNode(0, i);
+  }
+
+  /**
+   * Rehashes the blocks marked as modified since the last update (or full hash) and propagates the changes up to the root
+   *
+   * @param[in] buffer The buffer to hash. It must match the previously hashed buffer outside of the marked regions
+   * @return The updated root hash
+   */
+  __JAFFAR_COMMON_INLINE__ hash_t update(const void* buffer)
+  {
+    const uint8_t* data = (const uint8_t*)buffer;
+
+    // Rehashing dirty leaves. Full-sized blocks are batched together to share the SIMD lanes
+    const size_t fullBlocks = _bufferSize / _blockSize;
+    _leafPointers.clear();
+    _leafIndexes.clear();
+    for (const auto leaf : _dirtyNodes[0])
+    {
+      _dirty[leaf] = false;
+      if (leaf < fullBlocks)
+      {
+        _leafPointers.push_back(&data[leaf * _blockSize]);
+        _leafIndexes.push_back(leaf);
+      }
+      else
+        _nodes[leaf] = Hasher::calculate(&data[leaf * _blockSize], _bufferSize - leaf * _blockSize);
+      if (_levelSizes.size() > 1) markDirtyNode(1, leaf / 2);
+    }
+    _dirtyNodes[0].clear();
+
+    _leafHashes.resize(_leafPointers.size());
+    Hasher::calculateBatch(_leafPointers.data(), _leafPointers.size(), _blockSize, _leafHashes.data());
+    for (size_t i = 0; i < _leafIndexes.size(); i++) _nodes[_leafIndexes[i]] = _leafHashes[i];
+
+    // Propagating the changes upwards, one level at a time
+    for (size_t level = 1; level < _levelSizes.size(); level++)
+    {
+      for (const auto node : _dirtyNodes[level])
+      {
+        _dirty[_levelOffsets[level] + node] = false;
+        hashNode(level, node);
+        if (level + 1 < _levelSizes.size()) markDirtyNode(level + 1, node / 2);
+      }
+      _dirtyNodes[level].clear();
+    }
+
+    return getRoot();
+  }
+
+  /**
+   * Gets the root hash, as of the last full hash or update
+   *
+   * @return The root hash
+   */
+  __JAFFAR_COMMON_INLINE__ hash_t getRoot() const { return _nodes.back(); }
+
+  /**
+   * Gets the number of leaf blocks the buffer is split into
+   *
+   * @return The number of leaf blocks
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getBlockCount() const { return _leafCount; }
+
+  /**
+   * Gets the size of each leaf block
+   *
+   * @return The block size
+   */
+  __JAFFAR_COMMON_INLINE__ size_t getBlockSize() const { return _blockSize; }
+
+private:
+  /**
+   * Marks a node as needing to be recomputed, unless it is already marked
+   *
+   * @param[in] level The tree level of the node (0 = leaves)
+   * @param[in] idx The index of the node within its level
+   */
+  __JAFFAR_COMMON_INLINE__ void markDirtyNode(const size_t level, const size_t idx)
+  {
+    const size_t node = _levelOffsets[level] + idx;
+    if (_dirty[node] == true) return;
+    _dirty[node] = true;
+    _dirtyNodes[level].push_back(idx);
+  }
+
+  /**
+   * Recomputes an internal node from the digests of its (one or two) children
+   *
+   * @param[in] level The tree level of the node (1 or above)
+   * @param[in] idx The index of the node within its level
+   */
+  __JAFFAR_COMMON_INLINE__ void hashNode(const size_t level, const size_t idx)
+  {
+    const size_t firstChild = 2 * idx;
+    const size_t childCount = firstChild + 1 < _levelSizes[level - 1] ? 2 : 1;
+    _nodes[_levelOffsets[level] + idx] = Hasher::calculate(&_nodes[_levelOffsets[level - 1] + firstChild], childCount * sizeof(hash_t));
+  }
+
+  /**
+   * The size of the buffers to hash
+   */
+  size_t _bufferSize;
+
+  /**
+   * The size of each leaf block
+   */
+  size_t _blockSize;
+
+  /**
+   * The number of leaf blocks
+   */
+  size_t _leafCount;
+
+  /**
+   * All tree nodes, stored level by level starting from the leaves. The last node is the root
+   */
+  std::vector<hash_t> _nodes;
+
+  /**
+   * The position of the first node of each level within _nodes
+   */
+  std::vector<size_t> _levelOffsets;
+
+  /**
+   * The number of nodes at each level
+   */
+  std::vector<size_t> _levelSizes;
+
+  /**
+   * Per-node flag indicating it is already queued for recomputation
+   */
+  std::vector<bool> _dirty;
+
+  /**
+   * Per-level list of nodes queued for recomputation
+   */
+  std::vector<std::vector<size_t>> _dirtyNodes;
+
+  /**
+   * Scratch storage for the batched leaf rehash (kept to avoid reallocations across updates)
+   */
+  std::vector<const void*> _leafPointers;
+
+  /**
+   * Scratch storage for the leaf indexes matching _leafPointers
+   */
+  std::vector<size_t> _leafIndexes;
+
+  /**
+   * Scratch storage for the batched leaf hashes
+   */
+  std::vector<hash_t> _leafHashes;
+};
+
+} // namespace hash
+
+} // namespace jaffarCommon
\ No newline at end of file
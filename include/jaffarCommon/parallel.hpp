@@ -21,6 +21,12 @@ namespace parallel
 /// Macro to initiate a parallel for basic block. Uses OpenMP for this
 #define JAFFAR_PARALLEL_FOR _Pragma("omp parallel for")
 
+/// Macro to split a for loop among the workers of an enclosing parallel block, in equal contiguous chunks. Uses OpenMP for this
+#define JAFFAR_FOR _Pragma("omp for schedule(static)")
+
+/// Macro to split a for loop among the workers of an enclosing parallel block, handing out iterations on demand. Uses OpenMP for this
+#define JAFFAR_FOR_DYNAMIC _Pragma("omp for schedule(dynamic)")
+
 /// Macro to initiate a basic block where only the master thread runs
 #define JAFFAR_MASTER _Pragma("omp master")
 
@@ -0,0 +1,106 @@
+#pragma once
+
+/**
+ * @file hash.hpp
+ * @brief Contains the hashing serializer
+ */
+
+#include "../exceptions.hpp"
+#include "../hash.hpp"
+#include "base.hpp"
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+namespace jaffarCommon
+{
+
+namespace serializer
+{
+
+/**
+ * The hashing serializer feeds every pushed element straight into a hashing context, so the hash of a state can be
+ * obtained without first serializing it into a scratch buffer and then reading that buffer back.
+ *
+ * If an output buffer is given, it works in fused mode: elements are also written to the output buffer as with the
+ * contiguous serializer, and each piece is hashed right after being copied, while it is still in cache. Either way,
+ * the resulting hash equals the hash of the contiguous serialization of the same elements.
+ *
+ * @tparam Hasher The hashing backend to use (MetroHash128 by default)
+ */
+template <class Hasher = hash::MetroHash128Hasher>
+class Hash final : public serializer::Base
+{
+public:
+  /**
+   * Default constructor for the hashing serializer class
+   *
+   * @param[in] outputDataBuffer The output buffer onto which to also write the output data (fused mode). If nullptr, elements are only hashed
+   * @param[in] outputDataBufferSize The size of the output buffer (not to be exceeded)
+   */
+  Hash(void* __restrict outputDataBuffer = nullptr, const size_t outputDataBufferSize = std::numeric_limits<uint32_t>::max())
+      : serializer::Base(outputDataBuffer, outputDataBufferSize)
+  {
+  }
+
+  ~Hash() = default;
+
+  __JAFFAR_COMMON_INLINE__ void pushContiguous(const void* const __restrict inputDataBuffer = nullptr, const size_t inputDataSize = 0) override
+  {
+    // Making sure we do not exceed the maximum size estipulated
+    if (_outputDataBufferPos + inputDataSize > _outputDataBufferSize)
+      JAFFAR_THROW_RUNTIME("Maximum output data position (%lu) reached before hash serialization from pos (%lu) and input size (%lu)", _outputDataBufferSize,
+                           _outputDataBufferPos, inputDataSize);
+
+    // A null input only advances the output position (used to determine the required output buffer size)
+    if (inputDataBuffer != nullptr)
+    {
+      const uint8_t* input = (const uint8_t*)inputDataBuffer;
+
+      // In fused mode, copying and hashing go chunk by chunk so that the hasher reads data that was just brought into cache
+      if (_outputDataBuffer != nullptr)
+      {
+        for (size_t pos = 0; pos < inputDataSize; pos += _fusedChunkSize)
+        {
+          const size_t chunkSize = std::min(_fusedChunkSize, inputDataSize - pos);
+          memcpy(&_outputDataBuffer[_outputDataBufferPos + pos], &input[pos], chunkSize);
+          _hasher.update(&input[pos], chunkSize);
+        }
+      }
+      else
+        _hasher.update(input, inputDataSize);
+    }
+
+    // Moving output data pointer position
+    _outputDataBufferPos += inputDataSize;
+  }
+
+  __JAFFAR_COMMON_INLINE__ void push(const void* const __restrict inputDataBuffer, const size_t inputDataSize) override { pushContiguous(inputDataBuffer, inputDataSize); }
+
+  /**
+   * Gets the hash of all the data pushed so far. Serialization may continue afterwards
+   *
+   * @return The 128-bit hash of the serialized data
+   */
+  __JAFFAR_COMMON_INLINE__ hash::hash_t getHash() const
+  {
+    // Finalizing a copy, so that the running context is preserved
+    Hasher hasher = _hasher;
+    return hasher.finalize();
+  }
+
+private:
+  /**
+   * Number of bytes copied and hashed at a time in fused mode (small enough to stay in the L1 cache)
+   */
+  static constexpr size_t _fusedChunkSize = 4096;
+
+  /**
+   * The running hashing context
+   */
+  Hasher _hasher;
+};
+
+} // namespace serializer
+
+} // namespace jaffarCommon
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <jaffarCommon/concurrent.hpp>
 
 using namespace jaffarCommon::concurrent;
+using jaffarCommon::hash::hash_t;
 
 TEST(concurrent, deque)
 {
@@ -98,4 +99,1273 @@ TEST(concurrent, dequeConcurrency)
 
  ASSERT_EQ(d.wasSize(), 0);
  ASSERT_EQ(actualSum, expectedSum);
-}
\ No newline at end of file
+}
+
+TEST(concurrent, hashSet)
+{
+  ASSERT_THROW(HashSet(0), std::logic_error);
+
+  HashSet s(100);
+  ASSERT_EQ(s.capacity(), 128);
+  ASSERT_EQ(s.size(), 0);
+
+  const hash_t a(0x1234, 0x5678), b(0x1234, 0x9999), c(0x1234 + 128, 0x5678);
+  ASSERT_FALSE(s.contains(a));
+  ASSERT_TRUE(s.insert(a));
+  ASSERT_FALSE(s.insert(a));
+  ASSERT_TRUE(s.contains(a));
+
+  // Same home slot, different keys
+  ASSERT_FALSE(s.contains(b));
+  ASSERT_TRUE(s.insert(b));
+  ASSERT_TRUE(s.insert(c));
+  ASSERT_TRUE(s.contains(b));
+  ASSERT_TRUE(s.contains(c));
+
+  // Keys whose first word matches the internal sentinels are supported too
+  ASSERT_TRUE(s.insert(hash_t(0, 0)));
+  ASSERT_TRUE(s.insert(hash_t(1, 7)));
+  ASSERT_FALSE(s.insert(hash_t(0, 0)));
+  ASSERT_TRUE(s.contains(hash_t(1, 7)));
+  ASSERT_FALSE(s.contains(hash_t(1, 8)));
+  ASSERT_EQ(s.size(), 5);
+
+  // Filling the table up
+  for (uint64_t i = 2; s.size() < s.capacity() + 2; i++) s.insert(hash_t(i, i));
+  ASSERT_THROW(s.insert(hash_t(1000000, 0)), std::runtime_error);
+  ASSERT_FALSE(s.contains(hash_t(1000000, 0)));
+
+  s.clear();
+  ASSERT_EQ(s.size(), 0);
+  ASSERT_FALSE(s.contains(a));
+}
+
+TEST(concurrent, hashSetConcurrency)
+{
+  // Every key is inserted by four different iterations; exactly one insert per key must succeed
+  const size_t        keyCount = 20000;
+  HashSet             s(4 * keyCount);
+  std::atomic<size_t> inserted = 0;
+
+#pragma omp parallel for num_threads(8)
+  for (size_t i = 0; i < 4 * keyCount; i++)
+  {
+    const uint64_t k = i % keyCount;
+    // Only 256 distinct home slots, to force long, contended probe sequences
+    if (s.insert(hash_t((k % 256) + 2, k))) inserted++;
+  }
+
+  ASSERT_EQ(inserted, keyCount);
+  ASSERT_EQ(s.size(), keyCount);
+  for (size_t k = 0; k < keyCount; k++) ASSERT_TRUE(s.contains(hash_t((k % 256) + 2, k)));
+}
+
+TEST(concurrent, generationalHashSet)
+{
+  ASSERT_THROW(GenerationalHashSet(0), std::logic_error);
+
+  GenerationalHashSet s(3);
+  ASSERT_EQ(s.getLiveGenerationCount(), 1);
+  ASSERT_TRUE(s.insert(hash_t(1, 1)));
+  ASSERT_FALSE(s.insert(hash_t(1, 1)));
+  ASSERT_GT(s.getMemoryFootprint(), 0);
+
+  // Entries from live generations are still recognized, and refreshed into the current one
+  s.advanceGeneration();
+  ASSERT_FALSE(s.insert(hash_t(1, 1)));
+  ASSERT_TRUE(s.insert(hash_t(2, 2)));
+  s.advanceGeneration();
+  ASSERT_TRUE(s.insert(hash_t(3, 3)));
+  ASSERT_EQ(s.getLiveGenerationCount(), 3);
+  ASSERT_EQ(s.size(), 3);
+  ASSERT_TRUE(s.contains(hash_t(1, 1)));
+
+  // The first generation falls out of the window, but the hash seen again since then stays
+  s.advanceGeneration();
+  ASSERT_EQ(s.getCurrentGeneration(), 3);
+  ASSERT_EQ(s.getLiveGenerationCount(), 3);
+  ASSERT_EQ(s.getRetiredEntryCount(), 0);
+  ASSERT_TRUE(s.contains(hash_t(1, 1)));
+  ASSERT_TRUE(s.contains(hash_t(2, 2)));
+
+  // Hashes not seen within the window are forgotten
+  s.advanceGeneration();
+  ASSERT_EQ(s.getRetiredEntryCount(), 2);
+  ASSERT_FALSE(s.contains(hash_t(1, 1)));
+  ASSERT_TRUE(s.insert(hash_t(1, 1)));
+
+  // Shrinking the window retires generations right away
+  s.setWindowSize(1);
+  ASSERT_EQ(s.getLiveGenerationCount(), 1);
+  ASSERT_EQ(s.size(), 1);
+  ASSERT_EQ(s.getRetiredEntryCount(), 3);
+  ASSERT_FALSE(s.contains(hash_t(3, 3)));
+
+  // With a wider window, expired entries wait for the next sweep, but are already treated as absent
+  GenerationalHashSet wide(4);
+  ASSERT_TRUE(wide.insert(hash_t(1, 1)));
+  for (size_t g = 0; g < 4; g++) wide.advanceGeneration();
+  ASSERT_EQ(wide.getRetiredEntryCount(), 0);
+  ASSERT_FALSE(wide.contains(hash_t(1, 1)));
+  ASSERT_EQ(wide.size(), 0);
+  ASSERT_TRUE(wide.insert(hash_t(1, 1)));
+  ASSERT_FALSE(wide.insert(hash_t(1, 1)));
+  ASSERT_TRUE(wide.insert(hash_t(2, 2)));
+  for (size_t g = 0; g < 4; g++) wide.advanceGeneration();
+  ASSERT_EQ(wide.getRetiredEntryCount(), 0);
+  wide.advanceGeneration();
+  ASSERT_EQ(wide.getRetiredEntryCount(), 2);
+}
+
+TEST(concurrent, generationalHashSetConcurrency)
+{
+  GenerationalHashSet s(2);
+  const size_t        keyCount = 10000;
+  for (size_t k = 0; k < keyCount; k += 2) s.insert(hash_t(k, k));
+  s.advanceGeneration();
+
+  // Only the keys absent from the previous generation get inserted, each exactly once; the others are refreshed
+  std::atomic<size_t> inserted = 0;
+#pragma omp parallel for num_threads(8)
+  for (size_t i = 0; i < 3 * keyCount; i++)
+    if (s.insert(hash_t(i % keyCount, i % keyCount))) inserted++;
+
+  ASSERT_EQ(inserted, keyCount / 2);
+  ASSERT_EQ(s.size(), keyCount);
+  s.advanceGeneration();
+  ASSERT_EQ(s.size(), keyCount);
+  for (size_t k = 0; k < keyCount; k++) ASSERT_TRUE(s.contains(hash_t(k, k)));
+}
+
+TEST(concurrent, bloomFilter)
+{
+  ASSERT_THROW(BloomFilter(0), std::logic_error);
+  ASSERT_THROW(BloomFilter(10, 0), std::logic_error);
+
+  const size_t entryCount = 100000;
+  BloomFilter  f(entryCount, 16);
+  ASSERT_EQ(f.getMemoryFootprint(), entryCount * 16 / 8);
+
+  // No false negatives
+  for (uint64_t i = 0; i < entryCount; i++) ASSERT_TRUE(f.insert(hash_t(i * 0x9E3779B97F4A7C15ull, i * 0xC2B2AE3D27D4EB4Full)));
+  for (uint64_t i = 0; i < entryCount; i++) ASSERT_TRUE(f.contains(hash_t(i * 0x9E3779B97F4A7C15ull, i * 0xC2B2AE3D27D4EB4Full)));
+  ASSERT_EQ(f.getQueryCount(), 2 * entryCount);
+  ASSERT_EQ(f.getDefinitelyNewCount(), entryCount);
+  ASSERT_EQ(f.getDefinitelyNewRate(), 0.5);
+
+  // False positives stay close to the estimate (about 0.1% at 16 bits per entry)
+  size_t falsePositives = 0;
+  for (uint64_t i = 0; i < entryCount; i++)
+    if (f.contains(hash_t((i + entryCount) * 0x9E3779B97F4A7C15ull, (i + entryCount) * 0xC2B2AE3D27D4EB4Full))) falsePositives++, f.reportFalsePositive();
+  const double estimate = f.getEstimatedFalsePositiveRate();
+  ASSERT_LT(estimate, 0.005);
+  ASSERT_LT((double)falsePositives / entryCount, 3 * estimate + 0.001);
+  ASSERT_EQ(f.getFalsePositiveCount(), falsePositives);
+  ASSERT_NEAR(f.getObservedFalsePositiveRate(), (double)falsePositives / entryCount, 1e-9);
+
+  f.clear();
+  ASSERT_EQ(f.getQueryCount(), 0);
+  ASSERT_FALSE(f.contains(hash_t(0, 0)));
+}
+
+TEST(concurrent, bloomFilterConcurrency)
+{
+  // Keys inserted concurrently by several threads are all found afterwards, and nearly all are reported new exactly once
+  const size_t        keyCount = 50000;
+  BloomFilter         f(keyCount);
+  std::atomic<size_t> definitelyNew = 0;
+
+#pragma omp parallel for num_threads(8)
+  for (size_t i = 0; i < 2 * keyCount; i++)
+    if (f.insert(hash_t((i % keyCount) * 0x9E3779B97F4A7C15ull, (i % keyCount) * 0xC2B2AE3D27D4EB4Full))) definitelyNew++;
+
+  ASSERT_GT(definitelyNew, keyCount * 99 / 100);
+  ASSERT_LT(definitelyNew, keyCount * 101 / 100);
+  ASSERT_EQ(f.getDefinitelyNewCount(), definitelyNew);
+  for (size_t k = 0; k < keyCount; k++) ASSERT_TRUE(f.contains(hash_t(k * 0x9E3779B97F4A7C15ull, k * 0xC2B2AE3D27D4EB4Full)));
+}
+
+template <class Fingerprint>
+void testFingerprintSet()
+{
+  ASSERT_THROW(FingerprintSet<Fingerprint>(0), std::logic_error);
+
+  FingerprintSet<Fingerprint> s(1000);
+  ASSERT_EQ(s.capacity(), 1024);
+  ASSERT_EQ(s.getMemoryFootprint(), 1024 * sizeof(Fingerprint));
+
+  ASSERT_TRUE(s.insert(hash_t(5, 0x1111111122222222ull)));
+  ASSERT_FALSE(s.insert(hash_t(5, 0x1111111122222222ull)));
+  ASSERT_TRUE(s.contains(hash_t(5, 0x1111111122222222ull)));
+  ASSERT_TRUE(s.insert(hash_t(5, 0x1111111122222223ull)));
+  ASSERT_FALSE(s.contains(hash_t(5, 0x3333333322222224ull)));
+
+  // Zero fingerprints are supported
+  ASSERT_TRUE(s.insert(hash_t(6, 0)));
+  ASSERT_TRUE(s.contains(hash_t(6, 0)));
+  ASSERT_EQ(s.size(), 3);
+
+  // Only the fingerprint bits tell keys apart
+  const bool sameFingerprint = sizeof(Fingerprint) == 4;
+  ASSERT_EQ(s.contains(hash_t(5, 0xFFFFFFFF22222222ull)), sameFingerprint);
+
+  for (uint64_t i = 0; s.size() < s.capacity(); i++) s.insert(hash_t(i * 0x9E3779B97F4A7C15ull, i * 0xC2B2AE3D27D4EB4Full + 7));
+  ASSERT_THROW(s.insert(hash_t(1, 1234567)), std::runtime_error);
+
+  s.clear();
+  ASSERT_EQ(s.size(), 0);
+}
+
+TEST(concurrent, fingerprintSet)
+{
+  testFingerprintSet<uint32_t>();
+  testFingerprintSet<uint64_t>();
+}
+
+TEST(concurrent, fingerprintSetConcurrency)
+{
+  const size_t             keyCount = 20000;
+  FingerprintSet<uint32_t> s(4 * keyCount);
+  std::atomic<size_t>      inserted = 0;
+
+#pragma omp parallel for num_threads(8)
+  for (size_t i = 0; i < 4 * keyCount; i++)
+  {
+    const uint64_t k = i % keyCount;
+    if (s.insert(hash_t(k % 256, k * 0x9E3779B97F4A7C15ull + 1))) inserted++;
+  }
+
+  ASSERT_EQ(inserted, keyCount);
+  ASSERT_EQ(s.size(), keyCount);
+}
+
+TEST(concurrent, frozenHashSet)
+{
+  for (const size_t keyCount : {0, 1, 2, 3, 15, 16, 17, 100, 100000})
+  {
+    HashSet_t<hash_t> set;
+    for (uint64_t i = 0; i < keyCount; i++) set.insert(hash_t(i * 0x9E3779B97F4A7C15ull, i));
+
+    // Keys sharing their first word are told apart by the second
+    if (keyCount > 0) set.insert(hash_t(0, 12345));
+
+    const auto frozen = freeze(set);
+    ASSERT_EQ(frozen->size(), set.size());
+    ASSERT_LE(frozen->getMemoryFootprint(), set.size() * sizeof(hash_t) + (set.size() / 2 + 3) * sizeof(size_t));
+
+    for (uint64_t i = 0; i < keyCount; i++) ASSERT_TRUE(frozen->contains(hash_t(i * 0x9E3779B97F4A7C15ull, i)));
+    ASSERT_EQ(frozen->contains(hash_t(0, 12345)), keyCount > 0);
+    ASSERT_FALSE(frozen->contains(hash_t(0, 1)));
+    ASSERT_FALSE(frozen->contains(hash_t(0, 12346)));
+    ASSERT_FALSE(frozen->contains(hash_t(UINT64_MAX, UINT64_MAX)));
+    for (uint64_t i = 0; i < keyCount; i++) ASSERT_FALSE(frozen->contains(hash_t(i * 0x9E3779B97F4A7C15ull + 1, i)));
+
+    // Batched lookups, mixing present and absent keys
+    std::vector<hash_t> queries;
+    for (uint64_t i = 0; i < 2 * keyCount; i++) queries.push_back(hash_t((i / 2) * 0x9E3779B97F4A7C15ull + (i % 2), i / 2));
+    std::unique_ptr<bool[]> results(new bool[queries.size()]);
+    frozen->containsBatch(queries.data(), queries.size(), results.get());
+    for (size_t i = 0; i < queries.size(); i++) ASSERT_EQ(results[i], i % 2 == 0);
+  }
+
+  // Sets with other submap counts and lock types are frozen submap by submap too
+  HashSet_t<hash_t, 2, SpinLock> set;
+  for (uint64_t i = 0; i < 10000; i++) set.insert(hash_t(i * 0x9E3779B97F4A7C15ull, i));
+  size_t traversed = 0;
+  for (size_t i = 0; i < set.subcnt(); i++) set.forEachInSubmap(i, [&traversed](const hash_t&) { traversed++; });
+  ASSERT_EQ(traversed, 10000);
+  const auto frozen = freeze(set);
+  ASSERT_EQ(frozen->size(), 10000);
+  for (uint64_t i = 0; i < 10000; i++) ASSERT_TRUE(frozen->contains(hash_t(i * 0x9E3779B97F4A7C15ull, i)));
+}
+
+TEST(concurrent, hashSetInsertBatch)
+{
+  HashSet_t<hash_t> set;
+  set.insert(hash_t(1, 1));
+
+  // Already present, new, and repeated within the batch
+  std::vector<hash_t> keys = {hash_t(1, 1), hash_t(2, 2), hash_t(3, 3), hash_t(2, 2), hash_t(4, 4)};
+  bool                wasNew[5];
+  set.insertBatch(keys.data(), keys.size(), wasNew);
+  ASSERT_FALSE(wasNew[0]);
+  ASSERT_TRUE(wasNew[1]);
+  ASSERT_TRUE(wasNew[2]);
+  ASSERT_FALSE(wasNew[3]);
+  ASSERT_TRUE(wasNew[4]);
+  ASSERT_EQ(set.size(), 4);
+
+  set.insertBatch(keys.data(), 0, nullptr);
+  set.insertBatch(keys.data(), keys.size(), nullptr);
+  ASSERT_EQ(set.size(), 4);
+
+  // Concurrent batches with overlapping keys: every key is reported new exactly once
+  const size_t        keyCount = 20000;
+  std::atomic<size_t> newCount = 0;
+  HashSet_t<hash_t>   concurrentSet;
+#pragma omp parallel num_threads(8)
+  {
+    std::vector<hash_t>     batch;
+    std::unique_ptr<bool[]> results(new bool[256]);
+    for (size_t i = jaffarCommon::parallel::getThreadId(); i < 4 * keyCount; i += 8)
+    {
+      batch.push_back(hash_t(i % keyCount, i % keyCount));
+      if (batch.size() < 256) continue;
+      concurrentSet.insertBatch(batch.data(), batch.size(), results.get());
+      for (size_t j = 0; j < batch.size(); j++) newCount += results[j];
+      batch.clear();
+    }
+    concurrentSet.insertBatch(batch.data(), batch.size(), results.get());
+    for (size_t j = 0; j < batch.size(); j++) newCount += results[j];
+  }
+  ASSERT_EQ(newCount, keyCount);
+  ASSERT_EQ(concurrentSet.size(), keyCount);
+}
+
+TEST(concurrent, hashSetInsertBuffer)
+{
+  HashSet_t<hash_t>   set;
+  std::vector<hash_t> flushedKeys;
+  std::vector<bool>   flushedResults;
+  size_t              flushCount = 0;
+  const auto          onFlush    = [&](const hash_t* keys, const bool* wasNew, const size_t count) {
+    flushCount++;
+    for (size_t i = 0; i < count; i++) flushedKeys.push_back(keys[i]), flushedResults.push_back(wasNew[i]);
+  };
+
+  ASSERT_THROW(HashSetInsertBuffer<hash_t>(set, 0, onFlush), std::logic_error);
+
+  HashSetInsertBuffer<hash_t> buffer(set, 4, onFlush);
+  for (uint64_t i = 0; i < 10; i++) buffer.push(hash_t(i % 6, 0));
+
+  // Two automatic flushes; the last two keys are still staged
+  ASSERT_EQ(flushCount, 2);
+  ASSERT_EQ(buffer.size(), 2);
+  ASSERT_EQ(set.size(), 6);
+  buffer.flush();
+  buffer.flush();
+  ASSERT_EQ(flushCount, 3);
+  ASSERT_EQ(buffer.size(), 0);
+
+  ASSERT_EQ(flushedKeys.size(), 10);
+  for (uint64_t i = 0; i < 10; i++)
+  {
+    ASSERT_EQ(flushedKeys[i], hash_t(i % 6, 0));
+    ASSERT_EQ(flushedResults[i], i < 6);
+  }
+}
+
+TEST(concurrent, hashSetLockTypes)
+{
+  HashSet_t<hash_t, 10, SpinLock> spinSet;
+  ASSERT_EQ(spinSet.subcnt(), 1024);
+
+  HashSet_t<hash_t, 2, ContentionStatsMutex<std::mutex>> statsSet;
+  ASSERT_EQ(statsSet.subcnt(), 4);
+
+  const size_t        keyCount = 20000;
+  std::atomic<size_t> spinNew  = 0;
+  std::atomic<size_t> statsNew = 0;
+#pragma omp parallel for num_threads(8)
+  for (size_t i = 0; i < 4 * keyCount; i++)
+  {
+    const hash_t key(i % keyCount, i % keyCount);
+    if (spinSet.insert(key).second) spinNew++;
+    if (statsSet.insert(key).second) statsNew++;
+  }
+  ASSERT_EQ(spinNew, keyCount);
+  ASSERT_EQ(statsNew, keyCount);
+  ASSERT_EQ(spinSet.size(), keyCount);
+
+  // Every insert took exactly one submap lock
+  size_t acquisitions = 0;
+  for (size_t i = 0; i < statsSet.subcnt(); i++)
+  {
+    const auto& mutex = statsSet.getSubmapMutex(i);
+    ASSERT_LE(mutex.getContendedCount(), mutex.getAcquisitionCount());
+    ASSERT_TRUE(mutex.getContendedCount() > 0 || mutex.getWaitNanoseconds() == 0);
+    acquisitions += mutex.getAcquisitionCount();
+  }
+  ASSERT_EQ(acquisitions, 4 * keyCount);
+
+  // Batched inserts take every non-empty submap's lock once
+  for (size_t i = 0; i < statsSet.subcnt(); i++) statsSet.getSubmapMutex(i).resetStats();
+  std::vector<hash_t> batch;
+  for (uint64_t i = 0; i < 1000; i++) batch.push_back(hash_t(i, i));
+  statsSet.insertBatch(batch.data(), batch.size(), nullptr);
+  for (size_t i = 0; i < statsSet.subcnt(); i++) ASSERT_EQ(statsSet.getSubmapMutex(i).getAcquisitionCount(), 1);
+
+  // The other containers accept the configured set types
+  ASSERT_EQ(freeze(statsSet)->size(), statsSet.size());
+  size_t                                    flushed = 0;
+  HashSetInsertBuffer<hash_t, 10, SpinLock> buffer(spinSet, 8, [&](const hash_t*, const bool*, const size_t count) { flushed += count; });
+  for (uint64_t i = 0; i < 20; i++) buffer.push(hash_t(i, i));
+  buffer.flush();
+  ASSERT_EQ(flushed, 20);
+
+  ContentionStatsMutex<SpinLock> lock;
+  ASSERT_TRUE(lock.try_lock());
+  ASSERT_FALSE(lock.try_lock());
+  lock.unlock();
+  ASSERT_EQ(lock.getAcquisitionCount(), 1);
+}
+
+TEST(concurrent, hashMapLockTypes)
+{
+  HashMap_t<uint64_t, uint64_t> defaultMap;
+  ASSERT_EQ(defaultMap.subcnt(), 256);
+
+  HashMap_t<uint64_t, uint64_t, 3, ContentionStatsMutex<SpinLock>> map;
+  ASSERT_EQ(map.subcnt(), 8);
+
+#pragma omp parallel for num_threads(8)
+  for (uint64_t i = 0; i < 10000; i++) map.try_emplace_l(i % 100, [](auto& value) { value++; }, 1);
+
+  size_t acquisitions = 0;
+  for (size_t i = 0; i < map.subcnt(); i++) acquisitions += map.getSubmapMutex(i).getAcquisitionCount();
+  ASSERT_EQ(acquisitions, 10000);
+  ASSERT_EQ(map.size(), 100);
+  for (uint64_t i = 0; i < 100; i++) ASSERT_EQ(map[i], 100);
+}
+
+TEST(concurrent, atomicHashMap)
+{
+  ASSERT_THROW(AtomicHashMap<>(0), std::logic_error);
+
+  AtomicHashMap<uint64_t> map(100);
+  ASSERT_EQ(map.capacity(), 128);
+
+  uint64_t value = 0;
+  ASSERT_FALSE(map.get(hash_t(5, 5), value));
+  ASSERT_EQ(map.fetchAdd(hash_t(5, 5), 3), 0);
+  ASSERT_EQ(map.fetchAdd(hash_t(5, 5), 4), 3);
+  ASSERT_TRUE(map.get(hash_t(5, 5), value));
+  ASSERT_EQ(value, 7);
+
+  ASSERT_EQ(map.fetchMax(hash_t(5, 5), 2), 7);
+  ASSERT_EQ(map.fetchMax(hash_t(5, 5), 10), 7);
+  ASSERT_EQ(map.fetchMin(hash_t(5, 5), 20), 10);
+  ASSERT_EQ(map.fetchMin(hash_t(5, 5), 1), 10);
+  ASSERT_TRUE(map.get(hash_t(5, 5), value));
+  ASSERT_EQ(value, 1);
+
+  uint64_t expected = 2;
+  ASSERT_FALSE(map.compareExchange(hash_t(5, 5), expected, 9));
+  ASSERT_EQ(expected, 1);
+  ASSERT_TRUE(map.compareExchange(hash_t(5, 5), expected, 9));
+  ASSERT_TRUE(map.get(hash_t(5, 5), value));
+  ASSERT_EQ(value, 9);
+
+  // Keys sharing a first word, and keys colliding with the sentinel tags
+  map.fetchAdd(hash_t(5, 6), 1);
+  map.fetchAdd(hash_t(0, 1), 2);
+  map.fetchAdd(hash_t(1, 0), 3);
+  map.fetchAdd(hash_t(1, 0), 3);
+  ASSERT_TRUE(map.get(hash_t(1, 0), value));
+  ASSERT_EQ(value, 6);
+  ASSERT_FALSE(map.get(hash_t(0, 0), value));
+  ASSERT_EQ(map.size(), 4);
+
+  size_t   entryCount = 0;
+  uint64_t valueSum   = 0;
+  map.parallelForEach([&](const hash_t&, const uint64_t value) {
+#pragma omp critical
+    entryCount++, valueSum += value;
+  });
+  ASSERT_EQ(entryCount, 4);
+  ASSERT_EQ(valueSum, 9 + 1 + 2 + 6);
+
+  map.clear();
+  ASSERT_EQ(map.size(), 0);
+
+  for (uint64_t i = 0; i < 128; i++) map.fetchAdd(hash_t(i + 2, 0), 1);
+  ASSERT_THROW(map.fetchAdd(hash_t(1000, 0), 1), std::runtime_error);
+
+  // Doubles, with a custom initial value
+  AtomicHashMap<double> rewards(16, -1.0e9);
+  ASSERT_EQ(rewards.fetchMax(hash_t(7, 7), 2.5), -1.0e9);
+  ASSERT_EQ(rewards.fetchAdd(hash_t(7, 7), 0.5), 2.5);
+  double reward = 0.0;
+  ASSERT_TRUE(rewards.get(hash_t(7, 7), reward));
+  ASSERT_EQ(reward, 3.0);
+}
+
+TEST(concurrent, atomicHashMapConcurrency)
+{
+  const size_t           keyCount = 1000;
+  AtomicHashMap<int64_t> counts(4 * keyCount);
+  AtomicHashMap<int64_t> maxima(4 * keyCount, INT64_MIN);
+  AtomicHashMap<int64_t> minima(4 * keyCount, INT64_MAX);
+
+#pragma omp parallel for num_threads(8)
+  for (size_t i = 0; i < 100 * keyCount; i++)
+  {
+    const hash_t key(i % keyCount, i % keyCount + 1);
+    counts.fetchAdd(key, 1);
+    maxima.fetchMax(key, (int64_t)i);
+    minima.fetchMin(key, (int64_t)i);
+  }
+
+  for (size_t k = 0; k < keyCount; k++)
+  {
+    const hash_t key(k, k + 1);
+    int64_t      value = 0;
+    ASSERT_TRUE(counts.get(key, value));
+    ASSERT_EQ(value, 100);
+    ASSERT_TRUE(maxima.get(key, value));
+    ASSERT_EQ(value, (int64_t)(99 * keyCount + k));
+    ASSERT_TRUE(minima.get(key, value));
+    ASSERT_EQ(value, (int64_t)k);
+  }
+  ASSERT_EQ(counts.size(), keyCount);
+}
+
+TEST(concurrent, recentHashCache)
+{
+  ASSERT_THROW(RecentHashCache(0), std::logic_error);
+
+  RecentHashCache cache(4);
+  ASSERT_EQ(cache.getEntryCount(), 4);
+
+  // Three keys on the same line: the least recently used one is evicted
+  const hash_t a(1, 0), b(2, 2), c(3, 4);
+  ASSERT_FALSE(cache.lookup(a));
+  cache.add(a);
+  cache.add(b);
+  ASSERT_TRUE(cache.lookup(a));
+  cache.add(c);
+  ASSERT_TRUE(cache.lookup(a));
+  ASSERT_FALSE(cache.lookup(b));
+  ASSERT_TRUE(cache.lookup(c));
+
+  // The all-zero hash is never cached
+  cache.add(hash_t(0, 0));
+  ASSERT_FALSE(cache.lookup(hash_t(0, 0)));
+
+  ASSERT_EQ(cache.getLookupCount(), 6);
+  ASSERT_EQ(cache.getHitCount(), 3);
+  cache.clear();
+  ASSERT_EQ(cache.getLookupCount(), 0);
+  ASSERT_FALSE(cache.lookup(a));
+}
+
+TEST(concurrent, cachedHashSet)
+{
+  HashSet_t<hash_t>                set;
+  CachedHashSet<HashSet_t<hash_t>> cached(set, 64);
+
+  ASSERT_TRUE(cached.insert(hash_t(1, 1)));
+  ASSERT_FALSE(cached.insert(hash_t(1, 1)));
+  ASSERT_TRUE(cached.contains(hash_t(1, 1)));
+  ASSERT_FALSE(cached.contains(hash_t(2, 2)));
+  ASSERT_EQ(cached.getLookupCount(), 4);
+  ASSERT_EQ(cached.getHitCount(), 2);
+  ASSERT_EQ(cached.getHitRate(), 0.5);
+
+  // Keys inserted by another path are found through the set, then cached
+  set.insert(hash_t(3, 3));
+  ASSERT_TRUE(cached.contains(hash_t(3, 3)));
+  ASSERT_FALSE(cached.insert(hash_t(3, 3)));
+  ASSERT_EQ(cached.getHitCount(), 3);
+  cached.clear();
+  ASSERT_EQ(cached.getHitRate(), 0.0);
+
+  // The all-zero hash is a regular key, even though it marks empty cache entries
+  ASSERT_FALSE(cached.contains(hash_t(0, 0)));
+  ASSERT_TRUE(cached.insert(hash_t(0, 0)));
+  ASSERT_TRUE(set.contains(hash_t(0, 0)));
+  ASSERT_FALSE(cached.insert(hash_t(0, 0)));
+  ASSERT_EQ(cached.getHitCount(), 0);
+
+  // Concurrent inserts through the lock-free set, with many repeats: every key is new exactly once
+  const size_t           keyCount = 5000;
+  HashSet                lockFreeSet(4 * keyCount);
+  CachedHashSet<HashSet> cachedLockFree(lockFreeSet);
+  std::atomic<size_t>    newCount = 0;
+#pragma omp parallel for
+  for (size_t i = 0; i < 20 * keyCount; i++)
+    if (cachedLockFree.insert(hash_t(i / 20 % keyCount + 2, i / 20))) newCount++;
+  ASSERT_EQ(newCount, keyCount);
+  ASSERT_EQ(lockFreeSet.size(), keyCount);
+  ASSERT_GT(cachedLockFree.getHitRate(), 0.5);
+}
+
+TEST(concurrent, dedupQueue)
+{
+  ASSERT_THROW(DedupQueue<int>(16, 0), std::logic_error);
+
+  DedupQueue<int> queue(64, 8);
+  ASSERT_TRUE(queue.push(hash_t(2, 2), 20));
+  ASSERT_FALSE(queue.push(hash_t(2, 2), 21));
+  ASSERT_TRUE(queue.push(hash_t(3, 3), 30));
+  ASSERT_EQ(queue.wasSize(), 2);
+
+  // Batches skip elements seen before or repeated within the batch
+  const hash_t keys[]     = {hash_t(3, 3), hash_t(4, 4), hash_t(5, 5), hash_t(4, 4)};
+  const int    elements[] = {31, 40, 50, 41};
+  bool         wasNew[4];
+  ASSERT_EQ(queue.pushBatch(keys, elements, 4, wasNew), 2);
+  ASSERT_FALSE(wasNew[0]);
+  ASSERT_TRUE(wasNew[1]);
+  ASSERT_TRUE(wasNew[2]);
+  ASSERT_FALSE(wasNew[3]);
+  ASSERT_EQ(queue.pushBatch(keys, elements, 4), 0);
+
+  int popped[8];
+  ASSERT_EQ(queue.pop_front_get_batch(popped, 3), 3);
+  ASSERT_EQ(popped[0], 20);
+  ASSERT_EQ(popped[1], 30);
+  ASSERT_EQ(popped[2], 40);
+  int element;
+  ASSERT_TRUE(queue.pop_front_get(element));
+  ASSERT_EQ(element, 50);
+  ASSERT_FALSE(queue.pop_front_get(element));
+  ASSERT_EQ(queue.getEnqueuedCount(), 4);
+
+  // Clearing the queue keeps the seen hashes
+  queue.clearQueue();
+  ASSERT_EQ(queue.wasSize(), 0);
+  ASSERT_TRUE(queue.contains(hash_t(5, 5)));
+  ASSERT_FALSE(queue.push(hash_t(5, 5), 51));
+  for (int i = 0; i < 8; i++) ASSERT_TRUE(queue.push(hash_t(100 + i, i), i));
+  ASSERT_THROW(queue.push(hash_t(200, 0), 0), std::runtime_error);
+  ASSERT_FALSE(queue.contains(hash_t(200, 0)));
+
+  // A batch that does not fit enqueues nothing and marks nothing as seen; the queue stays consistent
+  DedupQueue<int> small(64, 2);
+  ASSERT_TRUE(small.push(hash_t(10, 10), 10));
+  const hash_t overflowKeys[]     = {hash_t(11, 11), hash_t(12, 12)};
+  const int    overflowElements[] = {11, 12};
+  ASSERT_THROW(small.pushBatch(overflowKeys, overflowElements, 2), std::runtime_error);
+  ASSERT_FALSE(small.contains(hash_t(11, 11)));
+  ASSERT_FALSE(small.contains(hash_t(12, 12)));
+  ASSERT_EQ(small.getEnqueuedCount(), 1);
+  ASSERT_EQ(small.wasSize(), 1);
+  ASSERT_EQ(small.pop_front_get_batch(popped, 8), 1);
+  ASSERT_EQ(popped[0], 10);
+  ASSERT_EQ(small.pushBatch(&overflowKeys[1], &overflowElements[1], 1), 1);
+  ASSERT_TRUE(small.pop_front_get(element));
+  ASSERT_EQ(element, 12);
+  ASSERT_FALSE(small.pop_front_get(element));
+
+  // A full set leaves no claimed position pending: pops skip them instead of waiting forever
+  DedupQueue<int> fullSet(2, 8);
+  ASSERT_TRUE(fullSet.push(hash_t(20, 20), 20));
+  ASSERT_TRUE(fullSet.push(hash_t(21, 21), 21));
+  ASSERT_THROW(fullSet.push(hash_t(22, 22), 22), std::runtime_error);
+  const hash_t fullKeys[]     = {hash_t(23, 23), hash_t(24, 24)};
+  const int    fullElements[] = {23, 24};
+  ASSERT_THROW(fullSet.pushBatch(fullKeys, fullElements, 2), std::runtime_error);
+  ASSERT_EQ(fullSet.getEnqueuedCount(), 2);
+  ASSERT_EQ(fullSet.pop_front_get_batch(popped, 8), 2);
+  ASSERT_EQ(popped[0], 20);
+  ASSERT_EQ(popped[1], 21);
+  ASSERT_FALSE(fullSet.pop_front_get(element));
+}
+
+TEST(concurrent, dedupQueueConcurrency)
+{
+  // Producers push with many repeats while consumers drain; every distinct state comes out exactly once. Pushes that
+  // lose a race to the same hash leave positions empty, hence the room beyond the number of keys
+  const size_t         keyCount = 20000;
+  DedupQueue<uint64_t> queue(4 * keyCount, 2 * keyCount);
+  std::vector<uint8_t> seen(keyCount, 0);
+  std::atomic<size_t>  poppedCount = 0;
+  std::atomic<size_t>  pushedCount = 0;
+  std::atomic<bool>    duplicate   = false;
+  const size_t         producers   = 4;
+
+#pragma omp parallel num_threads(8)
+  {
+    const size_t threadId = jaffarCommon::parallel::getThreadId();
+    if (threadId < producers)
+    {
+      std::vector<hash_t>   keys;
+      std::vector<uint64_t> elements;
+      for (size_t i = threadId; i < 4 * keyCount; i += producers)
+      {
+        const uint64_t k = i % keyCount;
+        if (threadId % 2 == 0) pushedCount += queue.push(hash_t(k + 2, k), k);
+        else keys.push_back(hash_t(k + 2, k)), elements.push_back(k);
+        if (keys.size() == 64 || (i + producers >= 4 * keyCount && keys.empty() == false))
+        {
+          pushedCount += queue.pushBatch(keys.data(), elements.data(), keys.size());
+          keys.clear(), elements.clear();
+        }
+      }
+    }
+    else
+    {
+      uint64_t batch[16];
+      while (poppedCount < keyCount)
+      {
+        const size_t count = queue.pop_front_get_batch(batch, 16);
+        for (size_t j = 0; j < count; j++)
+          if (std::atomic_ref<uint8_t>(seen[batch[j]]).exchange(1) == 1) duplicate = true;
+        poppedCount += count;
+      }
+    }
+  }
+
+  ASSERT_FALSE(duplicate);
+  ASSERT_EQ(pushedCount, keyCount);
+  ASSERT_EQ(poppedCount, keyCount);
+  ASSERT_EQ(queue.getEnqueuedCount(), keyCount);
+}
+
+TEST(concurrent, lockFreeDeque)
+{
+  LockFreeDeque<int> d(4);
+  ASSERT_EQ(d.capacity(), 4);
+
+  int value = 0;
+  ASSERT_FALSE(d.pop_front_get(value));
+  ASSERT_FALSE(d.pop_back_get(value));
+
+  // Same ordering as Deque at both ends, across several growths
+  for (int i = 0; i < 100; i++) d.push_back(i);
+  for (int i = 1; i <= 100; i++) d.push_front(-i);
+  ASSERT_EQ(d.wasSize(), 200);
+  ASSERT_EQ(d.capacity(), 256);
+
+  ASSERT_TRUE(d.pop_front_get(value));
+  ASSERT_EQ(value, -100);
+  ASSERT_TRUE(d.pop_back_get(value));
+  ASSERT_EQ(value, 99);
+
+  int batch[300];
+  ASSERT_EQ(d.pop_front_get_batch(batch, 99), 99);
+  for (int i = 0; i < 99; i++) ASSERT_EQ(batch[i], i - 99);
+  ASSERT_EQ(d.pop_front_get_batch(batch, 300), 99);
+  for (int i = 0; i < 99; i++) ASSERT_EQ(batch[i], i);
+  ASSERT_EQ(d.wasSize(), 0);
+  ASSERT_EQ(d.pop_front_get_batch(batch, 300), 0);
+
+  // Wrapping around the circular array
+  for (int round = 0; round < 1000; round++)
+  {
+    d.push_back_no_lock(round);
+    d.push_front_no_lock(-round);
+    ASSERT_TRUE(d.pop_back_get(value));
+    ASSERT_EQ(value, round);
+    ASSERT_TRUE(d.pop_front_get(value));
+    ASSERT_EQ(value, -round);
+  }
+  ASSERT_EQ(d.capacity(), 256);
+}
+
+TEST(concurrent, lockFreeDequeConcurrency)
+{
+  // Threads push at both ends (growing the deque from a tiny capacity) and pop from both ends at the same time
+  LockFreeDeque<size_t> d(2);
+  const size_t          elementCount = 200000;
+  std::vector<uint8_t>  seen(elementCount, 0);
+  std::atomic<size_t>   poppedCount = 0;
+  std::atomic<bool>     duplicate   = false;
+
+  const auto markPopped = [&](const size_t value) {
+    if (std::atomic_ref<uint8_t>(seen[value]).exchange(1) == 1) duplicate = true;
+    poppedCount++;
+  };
+
+#pragma omp parallel num_threads(8)
+  {
+    const size_t threadId = jaffarCommon::parallel::getThreadId();
+    size_t       value;
+    size_t       batch[8];
+#pragma omp for schedule(dynamic, 64)
+    for (size_t i = 0; i < elementCount; i++)
+    {
+      if (i % 2 == 0) d.push_back(i);
+      else d.push_front(i);
+
+      if (i % 3 == 0 && d.pop_back_get(value)) markPopped(value);
+      if (i % 5 == 0 && d.pop_front_get(value)) markPopped(value);
+      if (i % 7 == 0)
+        for (size_t j = 0, count = d.pop_front_get_batch(batch, 8); j < count; j++) markPopped(batch[j]);
+    }
+
+    // Draining what is left
+    while (threadId % 2 == 0 ? d.pop_front_get(value) : d.pop_back_get(value)) markPopped(value);
+  }
+
+  ASSERT_FALSE(duplicate);
+  ASSERT_EQ(poppedCount, elementCount);
+  ASSERT_EQ(d.wasSize(), 0);
+}
+
+TEST(concurrent, workStealingScheduler)
+{
+  // Every seeded element spawns a small tree of children; all of them must be processed exactly once
+  const size_t                  threadCount = 8;
+  const size_t                  seedCount   = 1000;
+  const size_t                  depth       = 4;
+  WorkStealingScheduler<size_t> scheduler(threadCount);
+  ASSERT_EQ(scheduler.getThreadCount(), threadCount);
+
+  std::vector<size_t> seeds(seedCount);
+  for (size_t i = 0; i < seedCount; i++) seeds[i] = i << 8;
+  scheduler.seed(seeds.data(), seeds.size());
+
+  // Element = (root << 8) | (level << 4) | child; a level-l element has level+1 children, unbalancing the per-thread work
+  std::vector<std::atomic<size_t>> visits(seedCount);
+  const size_t                     defaultThreadCount = jaffarCommon::parallel::getMaxThreadCount();
+  jaffarCommon::parallel::setThreadCount(threadCount / 2);
+  scheduler.run([&](const size_t& element) {
+    const size_t root  = element >> 8;
+    const size_t level = (element >> 4) & 0xF;
+    visits[root]++;
+    if (level < depth)
+      for (size_t c = 0; c <= level; c++) scheduler.push((root << 8) | ((level + 1) << 4) | c);
+  });
+  jaffarCommon::parallel::setThreadCount(defaultThreadCount);
+
+  // Tree size: 1 + 1 + 1*2 + 1*2*3 + 1*2*3*4
+  const size_t treeSize = 1 + 1 + 2 + 6 + 24;
+  for (size_t i = 0; i < seedCount; i++) ASSERT_EQ(visits[i], treeSize);
+
+  size_t processedCount = 0;
+  for (size_t t = 0; t < threadCount; t++)
+  {
+    processedCount += scheduler.getProcessedCount(t);
+    ASSERT_GE(scheduler.getStolenElementCount(t), scheduler.getStealCount(t));
+    ASSERT_GE(scheduler.getIdleSeconds(t), 0.0);
+  }
+  ASSERT_EQ(processedCount, seedCount * treeSize);
+
+  // Running again after all work is done returns right away; the counters accumulate until reset
+  scheduler.run([&](const size_t&) { FAIL(); });
+  scheduler.resetStats();
+  for (size_t t = 0; t < threadCount; t++) ASSERT_EQ(scheduler.getProcessedCount(t), 0);
+
+  // More threads than the scheduler was created for is a logic error
+  WorkStealingScheduler<size_t> small(1);
+  jaffarCommon::parallel::setThreadCount(2);
+  ASSERT_THROW(small.run([](const size_t&) {}), std::logic_error);
+  jaffarCommon::parallel::setThreadCount(defaultThreadCount);
+}
+
+TEST(concurrent, drainBufferParallelFill)
+{
+  const size_t         perThread = 10000;
+  const size_t         threads   = 4;
+  DrainBuffer<size_t>  buffer;
+  std::vector<uint8_t> seen(threads * perThread, 0);
+  buffer.reserve(threads * perThread);
+
+  // Unordered: every thread reserves ranges of various sizes; all elements must be there once
+#pragma omp parallel num_threads(threads)
+  {
+    const size_t threadId = jaffarCommon::parallel::getThreadId();
+    size_t       base     = threadId * perThread;
+    for (size_t remaining = perThread, chunk = 1; remaining > 0; chunk = chunk % 97 + 1)
+    {
+      const size_t count = std::min(chunk, remaining);
+      if (chunk % 2 == 0)
+      {
+        size_t* range = buffer.reserveRange(count);
+        for (size_t i = 0; i < count; i++) range[i] = base + i;
+      }
+      else
+      {
+        std::vector<size_t> elements(count);
+        for (size_t i = 0; i < count; i++) elements[i] = base + i;
+        buffer.push_back_batch(elements.data(), count);
+      }
+      base += count, remaining -= count;
+    }
+  }
+
+  ASSERT_EQ(buffer.wasSize(), threads * perThread);
+  size_t value;
+  while (buffer.pop_front_get(value))
+  {
+    ASSERT_EQ(seen[value], 0);
+    seen[value] = 1;
+  }
+  ASSERT_EQ(buffer.wasSize(), 0);
+
+  // Ordered: the result matches appending thread by thread, after what was pushed serially
+  buffer.clear();
+  buffer.push_back_no_lock(123);
+#pragma omp parallel num_threads(threads)
+  {
+    const size_t        threadId = jaffarCommon::parallel::getThreadId();
+    const size_t        count    = (threadId + 1) * 1000;
+    std::vector<size_t> elements(count);
+    for (size_t i = 0; i < count; i++) elements[i] = threadId * perThread + i;
+    buffer.push_back_ordered(elements.data(), count);
+  }
+
+  ASSERT_EQ(buffer.wasSize(), 1 + 1000 * threads * (threads + 1) / 2);
+  ASSERT_TRUE(buffer.pop_front_get(value));
+  ASSERT_EQ(value, 123);
+  for (size_t t = 0; t < threads; t++)
+    for (size_t i = 0; i < (t + 1) * 1000; i++)
+    {
+      ASSERT_TRUE(buffer.pop_front_get(value));
+      ASSERT_EQ(value, t * perThread + i);
+    }
+  ASSERT_FALSE(buffer.pop_back_get(value));
+
+  // Overflowing the reserved capacity is reported, and leaves the buffer as it was
+  buffer.clear();
+  buffer.push_back_no_lock(123);
+  ASSERT_THROW(buffer.reserveRange(threads * perThread), std::runtime_error);
+  ASSERT_EQ(buffer.wasSize(), 1);
+  size_t* range = buffer.reserveRange(threads * perThread - 1);
+  for (size_t i = 0; i < threads * perThread - 1; i++) range[i] = i;
+  ASSERT_EQ(buffer.wasSize(), threads * perThread);
+
+  // An ordered fill that does not fit appends nothing, and all threads are told so
+  buffer.clear();
+  buffer.push_back_no_lock(123);
+  std::atomic<size_t> fitCount = 0;
+#pragma omp parallel num_threads(threads)
+  {
+    std::vector<size_t> elements(perThread, 0);
+    if (buffer.push_back_ordered(elements.data(), elements.size()) == true) fitCount++;
+  }
+  ASSERT_EQ(fitCount, 0);
+  ASSERT_EQ(buffer.wasSize(), 1);
+  ASSERT_TRUE(buffer.pop_back_get(value));
+  ASSERT_EQ(value, 123);
+  ASSERT_FALSE(buffer.pop_front_get(value));
+}
+
+TEST(concurrent, segmentedDrainBuffer)
+{
+  // Small segments, so that fills and batches span many of them
+  SegmentedDrainBuffer<size_t, 8> buffer;
+  const size_t                    segmentSize = buffer.getSegmentSize();
+  ASSERT_EQ(segmentSize, 256);
+  ASSERT_EQ(buffer.wasSize(), 0);
+
+  const size_t count = 10 * segmentSize + 17;
+  for (size_t i = 0; i < count; i++) buffer.push_back_no_lock(i);
+  ASSERT_EQ(buffer.wasSize(), count);
+  ASSERT_EQ(buffer.getSegmentCount(), 11);
+
+  // Draining from both ends, with batches crossing segment boundaries
+  std::vector<size_t> batch(3 * segmentSize);
+  size_t              value;
+  ASSERT_TRUE(buffer.pop_back_get(value));
+  ASSERT_EQ(value, count - 1);
+  ASSERT_EQ(buffer.pop_front_get_batch(batch.data(), 300), 300);
+  for (size_t i = 0; i < 300; i++) ASSERT_EQ(batch[i], i);
+  ASSERT_EQ(buffer.pop_front_get_batch(batch.data(), batch.size()), batch.size());
+  for (size_t i = 0; i < batch.size(); i++) ASSERT_EQ(batch[i], 300 + i);
+  size_t expected = 300 + batch.size();
+  while (buffer.pop_front_get(value)) ASSERT_EQ(value, expected++);
+  ASSERT_EQ(expected, count - 1);
+  ASSERT_FALSE(buffer.pop_back_get(value));
+
+  // Segments go back to the pool and are reused by the next fill
+  buffer.clear();
+  ASSERT_EQ(buffer.getPooledSegmentCount(), 11);
+  for (size_t i = 0; i < 5 * segmentSize; i++) buffer.push_back_no_lock(i);
+  ASSERT_EQ(buffer.getPooledSegmentCount(), 6);
+  buffer.clear();
+  buffer.trimPool(4);
+  ASSERT_EQ(buffer.getPooledSegmentCount(), 4);
+
+  // Concurrent fills, unordered and ordered
+  const size_t         threads   = 4;
+  const size_t         perThread = 5000;
+  std::vector<uint8_t> seen(threads * perThread, 0);
+#pragma omp parallel num_threads(threads)
+  {
+    const size_t threadId = jaffarCommon::parallel::getThreadId();
+    for (size_t begin = 0, chunk = 1; begin < perThread; begin += chunk, chunk = chunk % 300 + 1)
+    {
+      const size_t        length = std::min(chunk, perThread - begin);
+      std::vector<size_t> elements(length);
+      for (size_t i = 0; i < length; i++) elements[i] = threadId * perThread + begin + i;
+      buffer.push_back_batch(elements.data(), length);
+    }
+  }
+  ASSERT_EQ(buffer.wasSize(), threads * perThread);
+
+  std::atomic<bool> duplicate = false;
+#pragma omp parallel num_threads(threads)
+  {
+    size_t local[100];
+    for (size_t taken = buffer.pop_front_get_batch(local, 100); taken > 0; taken = buffer.pop_front_get_batch(local, 100))
+      for (size_t i = 0; i < taken; i++)
+        if (std::atomic_ref<uint8_t>(seen[local[i]]).exchange(1) == 1) duplicate = true;
+  }
+  ASSERT_FALSE(duplicate);
+  ASSERT_EQ(std::count(seen.begin(), seen.end(), 1), threads * perThread);
+
+  buffer.clear();
+#pragma omp parallel num_threads(threads)
+  {
+    const size_t        threadId = jaffarCommon::parallel::getThreadId();
+    std::vector<size_t> elements(perThread - threadId * 1000);
+    for (size_t i = 0; i < elements.size(); i++) elements[i] = threadId * perThread + i;
+    buffer.push_back_ordered(elements.data(), elements.size());
+  }
+  for (size_t t = 0; t < threads; t++)
+    for (size_t i = 0; i < perThread - t * 1000; i++)
+    {
+      ASSERT_TRUE(buffer.pop_front_get(value));
+      ASSERT_EQ(value, t * perThread + i);
+    }
+  ASSERT_EQ(buffer.wasSize(), 0);
+
+  // Fills beyond the capacity append nothing (the elements are never read, so they need not be that many)
+  buffer.clear();
+  buffer.push_back_no_lock(123);
+  ASSERT_THROW(buffer.push_back_batch(&value, UINT32_MAX), std::runtime_error);
+  ASSERT_EQ(buffer.wasSize(), 1);
+  std::atomic<size_t> fitCount = 0;
+#pragma omp parallel num_threads(threads)
+  {
+    if (buffer.push_back_ordered(&value, UINT32_MAX / threads + 1) == true) fitCount++;
+  }
+  ASSERT_EQ(fitCount, 0);
+  ASSERT_EQ(buffer.wasSize(), 1);
+  ASSERT_EQ(buffer.getSegmentCount(), 1);
+  ASSERT_TRUE(buffer.pop_front_get(value));
+  ASSERT_EQ(value, 123);
+}
+
+TEST(concurrent, wideDrainBuffer)
+{
+  // Both with the 128-bit CAS (where available) and with the two-step claims
+  for (const bool useWideCAS : {true, false})
+  {
+    WideDrainBuffer<size_t> buffer(useWideCAS);
+    const size_t            count = 100000;
+    buffer.reserve(count);
+    for (size_t i = 0; i < count; i++) buffer.push_back_no_lock(i);
+    ASSERT_EQ(buffer.wasSize(), count);
+
+    size_t value;
+    ASSERT_TRUE(buffer.pop_back_get(value));
+    ASSERT_EQ(value, count - 1);
+    ASSERT_TRUE(buffer.pop_front_get(value));
+    ASSERT_EQ(value, 0);
+
+    // Both ends drained concurrently: every element is claimed exactly once
+    std::vector<uint8_t> seen(count, 0);
+    seen[0] = seen[count - 1] = 1;
+    std::atomic<bool> duplicate = false;
+#pragma omp parallel num_threads(4)
+    {
+      size_t batch[64];
+      bool   fromBack = jaffarCommon::parallel::getThreadId() % 2 == 1;
+      while (true)
+      {
+        const size_t taken = fromBack ? (buffer.pop_back_get(batch[0]) ? 1 : 0) : buffer.pop_front_get_batch(batch, 64);
+        if (taken == 0) break;
+        for (size_t i = 0; i < taken; i++)
+          if (std::atomic_ref<uint8_t>(seen[batch[i]]).exchange(1) == 1) duplicate = true;
+      }
+    }
+    ASSERT_FALSE(duplicate);
+    ASSERT_EQ(std::count(seen.begin(), seen.end(), 1), count);
+    ASSERT_EQ(buffer.wasSize(), 0);
+    ASSERT_FALSE(buffer.pop_front_get(value));
+
+    // Concurrent ordered fill after a clear
+    buffer.clear();
+#pragma omp parallel num_threads(4)
+    {
+      const size_t        threadId = jaffarCommon::parallel::getThreadId();
+      std::vector<size_t> elements(1000, threadId);
+      buffer.push_back_ordered(elements.data(), elements.size());
+    }
+    ASSERT_EQ(buffer.wasSize(), 4000);
+    for (size_t i = 0; i < 4000; i++)
+    {
+      ASSERT_TRUE(buffer.pop_front_get(value));
+      ASSERT_EQ(value, i / 1000);
+    }
+
+    // Fills beyond the capacity append nothing, and leave no budget to claim past the fill
+    ASSERT_THROW(buffer.reserveRange(count - 4000 + 1), std::runtime_error);
+    ASSERT_EQ(buffer.wasSize(), 0);
+    std::atomic<size_t> fitCount = 0;
+#pragma omp parallel num_threads(4)
+    {
+      std::vector<size_t> elements(count / 4, 0);
+      if (buffer.push_back_ordered(elements.data(), elements.size()) == true) fitCount++;
+    }
+    ASSERT_EQ(fitCount, 0);
+    ASSERT_EQ(buffer.wasSize(), 0);
+    ASSERT_FALSE(buffer.pop_front_get(value));
+    ASSERT_FALSE(buffer.pop_back_get(value));
+    size_t* range = buffer.reserveRange(count - 4000);
+    for (size_t i = 0; i < count - 4000; i++) range[i] = 4000 + i;
+    ASSERT_EQ(buffer.wasSize(), count - 4000);
+    ASSERT_TRUE(buffer.pop_back_get(value));
+    ASSERT_EQ(value, count - 1);
+  }
+}
+
+TEST(concurrent, multiQueue)
+{
+  // With a single heap, the order is exact (greatest key first by default)
+  MultiQueue<int, int> exact(1, 1);
+  ASSERT_EQ(exact.getHeapCount(), 1);
+  int key, value;
+  ASSERT_FALSE(exact.pop(key, value));
+  for (int i = 0; i < 1000; i++) exact.push((i * 7919) % 1000, i);
+  ASSERT_EQ(exact.wasSize(), 1000);
+  for (int expected = 999; expected >= 0; expected--)
+  {
+    ASSERT_TRUE(exact.pop(key, value));
+    ASSERT_EQ(key, expected);
+    ASSERT_EQ((value * 7919) % 1000, key);
+  }
+  ASSERT_FALSE(exact.pop(key, value));
+
+  // A custom ordering (smallest first) and batched pops
+  MultiQueue<int, int, std::less<int>> ascending(1, 1);
+  for (int i = 0; i < 100; i++) ascending.push(99 - i, i);
+  int keys[64], values[64];
+  ASSERT_EQ(ascending.pop_batch(keys, values, 64), 64);
+  for (int i = 0; i < 64; i++) ASSERT_EQ(keys[i], i);
+  ASSERT_EQ(ascending.pop_batch(keys, values, 64), 36);
+  ASSERT_EQ(ascending.pop_batch(keys, values, 64), 0);
+
+  // With many heaps, the order is relaxed: the first pops still come from the top of the distribution
+  MultiQueue<size_t, size_t> relaxed(4, 4);
+  ASSERT_EQ(relaxed.getHeapCount(), 16);
+  const size_t count = 20000;
+  for (size_t i = 0; i < count; i++) relaxed.push((i * 7919) % count, i);
+  for (size_t i = 0; i < 100; i++)
+  {
+    size_t k, v;
+    ASSERT_TRUE(relaxed.pop(k, v));
+    ASSERT_GE(k, count - 1000);
+  }
+  size_t popped = 100, k, v;
+  while (relaxed.pop(k, v)) popped++;
+  ASSERT_EQ(popped, count);
+  ASSERT_EQ(relaxed.wasSize(), 0);
+}
+
+TEST(concurrent, multiQueueConcurrency)
+{
+  // Threads push and pop at the same time; every element comes out exactly once
+  MultiQueue<uint32_t, uint32_t> queue(2, 8);
+  const size_t                   count = 200000;
+  std::vector<uint8_t>           seen(count, 0);
+  std::atomic<bool>              duplicate   = false;
+  std::atomic<size_t>            poppedCount = 0;
+
+  const auto markPopped = [&](const uint32_t key, const uint32_t value) {
+    if (key != value % 1000 || std::atomic_ref<uint8_t>(seen[value]).exchange(1) == 1) duplicate = true;
+    poppedCount++;
+  };
+
+#pragma omp parallel num_threads(8)
+  {
+    uint32_t keys[16], values[16];
+#pragma omp for schedule(dynamic, 256)
+    for (size_t i = 0; i < count; i++)
+    {
+      queue.push((uint32_t)i % 1000, (uint32_t)i);
+      if (i % 3 == 0 && queue.pop(keys[0], values[0])) markPopped(keys[0], values[0]);
+      if (i % 7 == 0)
+        for (size_t j = 0, n = queue.pop_batch(keys, values, 16); j < n; j++) markPopped(keys[j], values[j]);
+    }
+
+    while (queue.pop(keys[0], values[0])) markPopped(keys[0], values[0]);
+  }
+
+  ASSERT_FALSE(duplicate);
+  ASSERT_EQ(poppedCount, count);
+  ASSERT_EQ(queue.wasSize(), 0);
+}
+
+TEST(concurrent, bucketQueue)
+{
+  for (const bool monotone : {false, true})
+  {
+    // Highest priority first, and push order within a priority
+    BucketQueue<int> queue(5000, monotone);
+    ASSERT_EQ(queue.getBucketCount(), 5000);
+    int    element;
+    size_t priority;
+    ASSERT_FALSE(queue.pop(element, priority));
+    ASSERT_THROW(queue.push(5000, 0), std::logic_error);
+
+    for (int i = 0; i < 1000; i++) queue.push((size_t)(i % 10) * 450, i);
+    ASSERT_EQ(queue.wasSize(), 1000);
+    for (int p = 9; p >= 0; p--)
+      for (int j = 0; j < 100; j++)
+      {
+        ASSERT_TRUE(queue.pop(element, priority));
+        ASSERT_EQ(priority, (size_t)p * 450);
+        ASSERT_EQ(element, j * 10 + p);
+      }
+    ASSERT_FALSE(queue.pop(element, priority));
+
+    // Pushing above the current top between pops, and draining the top bucket in bulk (across several segments)
+    queue.push(10, 1);
+    ASSERT_TRUE(queue.pop(element, priority));
+    ASSERT_EQ(priority, 10);
+    for (int i = 0; i < 300; i++) queue.push(4999, i);
+    queue.push(3, -1);
+    std::vector<int> batch(1000);
+    ASSERT_EQ(queue.pop_batch(batch.data(), 200, priority), 200);
+    ASSERT_EQ(priority, 4999);
+    for (int i = 0; i < 200; i++) ASSERT_EQ(batch[i], i);
+    ASSERT_EQ(queue.pop_batch(batch.data(), 1000, priority), 100);
+    ASSERT_EQ(batch[99], 299);
+    ASSERT_EQ(queue.pop_batch(batch.data(), 1000, priority), 1);
+    ASSERT_EQ(priority, 3);
+    ASSERT_EQ(queue.wasSize(), 0);
+
+    // Clearing leaves nothing behind, and the storage is reused
+    queue.push(7, 7);
+    queue.clear();
+    ASSERT_FALSE(queue.pop(element, priority));
+    queue.push(8, 8);
+    ASSERT_TRUE(queue.pop(element, priority));
+    ASSERT_EQ(element, 8);
+    queue.release();
+    ASSERT_EQ(queue.wasSize(), 0);
+  }
+}
+
+TEST(concurrent, bucketQueueConcurrency)
+{
+  // Threads push and pop at the same time, in both modes; every element comes out exactly once, with its priority
+  for (const bool monotone : {false, true})
+  {
+    BucketQueue<uint32_t> queue(300, monotone);
+    const size_t          count = 200000;
+    std::vector<uint8_t>  seen(count, 0);
+    std::atomic<bool>     error       = false;
+    std::atomic<size_t>   poppedCount = 0;
+
+    const auto markPopped = [&](const uint32_t element, const size_t priority) {
+      if (priority != element % 300 || std::atomic_ref<uint8_t>(seen[element]).exchange(1) == 1) error = true;
+      poppedCount++;
+    };
+
+#pragma omp parallel num_threads(8)
+    {
+      uint32_t batch[16];
+      size_t   priority;
+#pragma omp for schedule(dynamic, 256)
+      for (size_t i = 0; i < count; i++)
+      {
+        queue.push(i % 300, (uint32_t)i);
+        if (i % 3 == 0 && queue.pop(batch[0], priority)) markPopped(batch[0], priority);
+        if (i % 7 == 0)
+          for (size_t j = 0, n = queue.pop_batch(batch, 16, priority); j < n; j++) markPopped(batch[j], priority);
+      }
+
+      while (queue.pop(batch[0], priority)) markPopped(batch[0], priority);
+    }
+
+    ASSERT_FALSE(error);
+    ASSERT_EQ(poppedCount, count);
+    ASSERT_EQ(queue.wasSize(), 0);
+  }
+}
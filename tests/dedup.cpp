@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <jaffarCommon/dedup.hpp>
+#include <random>
+#include <set>
+
+using namespace jaffarCommon::dedup;
+using jaffarCommon::hash::hash_t;
+
+TEST(dedup, radixSort)
+{
+  std::mt19937_64 rng(0);
+  for (const size_t count : {0, 1, 2, 3, 1000, 100000})
+  {
+    // Random keys, plus repeated keys and keys sharing only their first word
+    std::vector<hash_t> keys(count);
+    for (size_t i = 0; i < count; i++) keys[i] = i % 7 == 3 ? keys[rng() % i] : hash_t(rng(), rng());
+    for (size_t i = 0; i < count; i++)
+    {
+      if (i % 11 == 5) keys[i].first = keys[rng() % i].first;
+    }
+
+    std::vector<hash_t> expected = keys;
+    std::sort(expected.begin(), expected.end());
+    radixSort(keys);
+    ASSERT_EQ(keys, expected);
+  }
+}
+
+TEST(dedup, radixSortPayload)
+{
+  std::mt19937_64     rng(1);
+  const size_t        count = 50000;
+  std::vector<hash_t> keys(count);
+  std::vector<size_t> payloads(count);
+  for (size_t i = 0; i < count; i++)
+  {
+    keys[i]     = i % 5 == 2 ? keys[rng() % i] : hash_t(rng() % 1000, rng());
+    payloads[i] = i;
+  }
+  std::vector<hash_t> original = keys;
+
+  radixSort(keys, payloads);
+  ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+
+  // Payloads follow their keys, and equal keys keep their input order
+  for (size_t i = 0; i < count; i++) ASSERT_EQ(original[payloads[i]], keys[i]);
+  for (size_t i = 1; i < count; i++)
+  {
+    if (keys[i] == keys[i - 1]) { ASSERT_LT(payloads[i - 1], payloads[i]); }
+  }
+
+  std::vector<size_t> wrongPayloads(count - 1);
+  ASSERT_THROW(radixSort(keys, wrongPayloads), std::logic_error);
+}
+
+TEST(dedup, dedupAgainst)
+{
+  std::mt19937_64                  rng(2);
+  std::vector<std::vector<hash_t>> history;
+  std::set<hash_t>                 seen;
+  std::vector<hash_t>              pool;
+
+  // Every step repeats some keys from its own batch and from earlier steps
+  for (size_t step = 0; step < 8; step++)
+  {
+    std::vector<hash_t> batch(20000);
+    std::vector<size_t> payloads(batch.size());
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+      const size_t choice = rng() % 4;
+      if (choice == 0 && pool.empty() == false) batch[i] = pool[rng() % pool.size()];
+      else if (choice == 1 && i > 0) batch[i] = batch[rng() % i];
+      else batch[i] = hash_t(rng(), rng());
+      payloads[i] = i;
+    }
+
+    std::vector<hash_t> original = batch;
+    std::set<hash_t>    expected;
+    for (const auto& key : batch)
+      if (seen.count(key) == 0) expected.insert(key);
+
+    radixSort(batch, payloads);
+    const size_t kept = dedupAgainst(batch, payloads, history);
+    ASSERT_EQ(kept, expected.size());
+    ASSERT_EQ(batch, std::vector<hash_t>(expected.begin(), expected.end()));
+
+    // The payload kept is that of the key's first occurrence in the batch
+    for (size_t i = 0; i < kept; i++) ASSERT_EQ(payloads[i], (size_t)(std::find(original.begin(), original.end(), batch[i]) - original.begin()));
+
+    seen.insert(batch.begin(), batch.end());
+    pool.insert(pool.end(), batch.begin(), batch.end());
+    history.push_back(batch);
+  }
+
+  // Keys-only version, and empty batches
+  std::vector<hash_t> batch = {history[0][0], history[3][5], hash_t(1, 2), hash_t(1, 2)};
+  radixSort(batch);
+  ASSERT_EQ(dedupAgainst(batch, history), 1);
+  ASSERT_EQ(batch[0], hash_t(1, 2));
+
+  std::vector<hash_t> empty;
+  ASSERT_EQ(dedupAgainst(empty, history), 0);
+
+  std::vector<size_t> wrongPayloads(3);
+  ASSERT_THROW(dedupAgainst(batch, wrongPayloads, history), std::logic_error);
+}
@@ -3,6 +3,7 @@
 #include "gtest/gtest.h"
 #include <jaffarCommon/file.hpp>
 
+using namespace jaffarCommon;
 using namespace jaffarCommon::file;
 
 TEST(file, loadFile)
@@ -33,6 +34,54 @@ TEST(file, saveFile)
   ASSERT_EQ(expectedContents, fileContents);
 }
 
+TEST(file, hashFile)
+{
+  std::string sha1String;
+  hash::hash_t hash;
+  ASSERT_FALSE(getFileSHA1String(sha1String, "WrongPath.txt"));
+  ASSERT_FALSE(getFileHash(hash, "WrongPath.txt"));
+
+  std::string fileContents;
+  ASSERT_TRUE(loadStringFromFile(fileContents, "testFile1.txt"));
+  ASSERT_TRUE(getFileSHA1String(sha1String, "testFile1.txt"));
+  ASSERT_EQ(sha1String, hash::getSHA1String(fileContents));
+  ASSERT_TRUE(getFileHash(hash, "testFile1.txt"));
+  ASSERT_EQ(hash, hash::calculateMetroHash(fileContents.data(), fileContents.size()));
+
+  // A file spanning several (memory-mapped) blocks, including a partial last one
+  std::string largeContents(3 * 4096 * 5 + 123, ' ');
+  for (size_t i = 0; i < largeContents.size(); i++) largeContents[i] = (char)(i * 31 + i / 4096);
+  ASSERT_TRUE(saveStringToFile(largeContents, "testFile3.bin"));
+  std::string readContents;
+  size_t      blockCount = 0;
+  ASSERT_TRUE(processFileBlocks(
+    "testFile3.bin", [&](const uint8_t* data, const size_t size) { readContents.append((const char*)data, size), blockCount++; }, 3 * 4096));
+  ASSERT_EQ(readContents, largeContents);
+  ASSERT_EQ(blockCount, 6);
+  ASSERT_TRUE(getFileSHA1String(sha1String, "testFile3.bin"));
+  ASSERT_EQ(sha1String, hash::getSHA1String(largeContents));
+  ASSERT_TRUE(getFileHash(hash, "testFile3.bin"));
+  ASSERT_EQ(hash, hash::calculateMetroHash(largeContents.data(), largeContents.size()));
+
+  // Zero-sized blocks are rejected, and a throwing callback does not leak the file descriptor
+  ASSERT_THROW(processFileBlocks("testFile3.bin", [](const uint8_t*, const size_t) {}, 0), std::logic_error);
+  const int lowestFreeFd = dup(0);
+  close(lowestFreeFd);
+  ASSERT_THROW(processFileBlocks("testFile3.bin", [](const uint8_t*, const size_t) { throw std::runtime_error("Callback failure"); }), std::runtime_error);
+  ASSERT_THROW(processFileBlocks("/proc/self/cmdline", [](const uint8_t*, const size_t) { throw std::runtime_error("Callback failure"); }), std::runtime_error);
+  const int nextFreeFd = dup(0);
+  close(nextFreeFd);
+  ASSERT_EQ(nextFreeFd, lowestFreeFd);
+  std::remove("testFile3.bin");
+
+  // Files that report no size (like procfs entries) are read rather than mapped
+  std::string cmdLine;
+  ASSERT_TRUE(loadStringFromFile(cmdLine, "/proc/self/cmdline"));
+  readContents.clear();
+  ASSERT_TRUE(processFileBlocks("/proc/self/cmdline", [&](const uint8_t* data, const size_t size) { readContents.append((const char*)data, size); }));
+  ASSERT_EQ(readContents, cmdLine);
+}
+
 TEST(file, memFile)
 {
   const size_t size = 16;
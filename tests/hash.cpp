@@ -1,6 +1,12 @@
 #include "gtest/gtest.h"
 #include <jaffarCommon/hash.hpp>
+#include <jaffarCommon/hashers/crc32c.hpp>
+#include <jaffarCommon/hashers/xxh3Style.hpp>
+#include <sha1/sha1.hpp>
+#include <algorithm>
+#include <vector>
 
+using namespace jaffarCommon;
 using namespace jaffarCommon::hash;
 
 TEST(hash, SHA1)
@@ -10,6 +16,34 @@ TEST(hash, SHA1)
   EXPECT_EQ(getSHA1String("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu"), "A49B2446A02C645BF419F995B67091253A04A259");
 }
 
+TEST(hash, SHA1Streaming)
+{
+  std::vector<uint8_t> input(100000);
+  for (size_t i = 0; i < input.size(); i++) input[i] = (uint8_t)(i * 7 + i / 251);
+
+  // Must match the reference implementation for every padding case, whether fed at once or in uneven chunks
+  const size_t sizes[] = {0, 1, 55, 56, 63, 64, 65, 119, 120, 128, 1000, 100000};
+  SHA1Hasher   hasher;
+  for (const size_t size : sizes)
+  {
+    const std::string expected = sha1::SHA1::GetHash(input.data(), size);
+    ASSERT_EQ(getSHA1String(input.data(), size), expected);
+    for (size_t pos = 0, chunk = 1; pos < size; pos += chunk, chunk = chunk * 2 + 1) hasher.update(&input[pos], std::min(chunk, size - pos));
+    ASSERT_EQ(hasher.finalize(), expected);
+  }
+
+#if defined(__x86_64__)
+  // The SHA-NI path, when available, must match the portable one
+  if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1"))
+  {
+    uint32_t scalarState[5] = {1, 2, 3, 4, 5}, acceleratedState[5] = {1, 2, 3, 4, 5};
+    sha1ProcessBlocksScalar(scalarState, input.data(), input.size() / 64);
+    sha1ProcessBlocksSHANI(acceleratedState, input.data(), input.size() / 64);
+    for (size_t i = 0; i < 5; i++) ASSERT_EQ(scalarState[i], acceleratedState[i]);
+  }
+#endif
+}
+
 TEST(hash, calculateMetroHash)
 {
   std::string inputString = "012345678901234567890123456789012345678901234567890123456789012";
@@ -31,4 +65,188 @@ TEST(hash, hashToString)
   value.first = 0x0011223344556677;
   value.second = 0x8899AABBCCDDEEFF;
   EXPECT_EQ(hashToString(value), "0x00112233445566778899AABBCCDDEEFF");
-}
\ No newline at end of file
+}
+
+TEST(hash, calculateMetroHashBatch)
+{
+  const size_t sizes[] = {0, 1, 15, 31, 32, 33, 63, 64, 100, 4103};
+  const size_t maxCount = 19;
+
+  for (const size_t size : sizes)
+  {
+    std::vector<uint8_t> arena(size * maxCount + 1);
+    for (size_t i = 0; i < arena.size(); i++) arena[i] = (uint8_t)(i * 131 + 7);
+
+    for (size_t count = 1; count <= maxCount; count++)
+    {
+      std::vector<const void*> buffers(count);
+      std::vector<hash_t> expected(count);
+      for (size_t i = 0; i < count; i++) buffers[i] = &arena[i * size + 1];
+      for (size_t i = 0; i < count; i++) expected[i] = calculateMetroHash(buffers[i], size);
+
+      std::vector<hash_t> batched(count);
+      calculateMetroHashBatch(buffers.data(), count, size, batched.data());
+      ASSERT_EQ(batched, expected);
+
+      std::vector<hash_t> strided(count);
+      calculateMetroHashStrided(&arena[1], size, count, size, strided.data());
+      ASSERT_EQ(strided, expected);
+    }
+  }
+}
+
+TEST(hash, metroHashBatchKernels)
+{
+  const size_t size = 1000;
+  std::vector<uint8_t> arena(size * 8);
+  for (size_t i = 0; i < arena.size(); i++) arena[i] = (uint8_t)(i * 17 + 3);
+
+  const uint8_t* buffers[8];
+  hash_t expected[8];
+  for (size_t i = 0; i < 8; i++) buffers[i] = &arena[i * size];
+  for (size_t i = 0; i < 8; i++) expected[i] = calculateMetroHash(buffers[i], size);
+
+  hash_t result[8];
+  metroHashBatchScalar(buffers, 8, size, result);
+  for (size_t i = 0; i < 8; i++) ASSERT_EQ(result[i], expected[i]);
+
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("avx2"))
+  {
+    metroHashBatchAVX2(buffers, 4, size, result);
+    for (size_t i = 0; i < 4; i++) ASSERT_EQ(result[i], expected[i]);
+  }
+
+  if (__builtin_cpu_supports("avx512f"))
+  {
+    metroHashBatchAVX512(buffers, 8, size, result);
+    for (size_t i = 0; i < 8; i++) ASSERT_EQ(result[i], expected[i]);
+  }
+#endif
+}
+
+template <class Hasher>
+void testHashBackend()
+{
+  std::vector<uint8_t> input(5000);
+  for (size_t i = 0; i < input.size(); i++) input[i] = (uint8_t)(i * 29 + 11);
+
+  // Streaming in uneven chunks must match the one-shot hash, for every input size around the block boundaries
+  const size_t sizes[] = {0, 1, 7, 31, 32, 33, 63, 64, 65, 127, 1023, 1024, 1025, 5000};
+  Hasher hasher;
+  for (const size_t size : sizes)
+  {
+    const hash_t oneShot = Hasher::calculate(input.data(), size);
+    for (size_t pos = 0, chunk = 1; pos < size; pos += chunk, chunk = chunk * 3 + 1) hasher.update(&input[pos], std::min(chunk, size - pos));
+    ASSERT_EQ(hasher.finalize(), oneShot);
+    ASSERT_EQ(calculateHash<Hasher>(input.data(), size), oneShot);
+  }
+
+  // Different lengths (even if the extra bytes are zero) and single-bit changes must produce different hashes
+  std::vector<uint8_t> zeros(100, 0);
+  ASSERT_NE(Hasher::calculate(zeros.data(), 99), Hasher::calculate(zeros.data(), 100));
+  const hash_t original = Hasher::calculate(input.data(), input.size());
+  input[2500] ^= 0x10;
+  ASSERT_NE(Hasher::calculate(input.data(), input.size()), original);
+
+  // Batches must match individual hashes
+  const void* buffers[3] = {&input[0], &input[100], &input[200]};
+  hash_t hashes[3];
+  Hasher::calculateBatch(buffers, 3, 1000, hashes);
+  for (size_t i = 0; i < 3; i++) ASSERT_EQ(hashes[i], Hasher::calculate(buffers[i], 1000));
+}
+
+TEST(hash, backends)
+{
+  testHashBackend<MetroHash128Hasher>();
+  testHashBackend<CRC32CHasher>();
+  testHashBackend<XXH3StyleHasher>();
+
+  // The default backend is MetroHash128
+  const std::string inputString = "012345678901234567890123456789012345678901234567890123456789012";
+  ASSERT_EQ(calculateHash(inputString.data(), inputString.size()), calculateMetroHash(inputString.data(), inputString.size()));
+}
+
+TEST(hash, crc32cSoftware)
+{
+  // Standard CRC32C check value for "12345678" (initial value and final XOR of 0xFFFFFFFF)
+  uint64_t word;
+  memcpy(&word, "12345678", 8);
+  ASSERT_EQ(CRC32CHasher::crc32cSoftware(0xFFFFFFFF, word) ^ 0xFFFFFFFF, 0x6087809A);
+}
+
+TEST(hash, parallelHash)
+{
+  std::vector<uint8_t> input(1000000);
+  for (size_t i = 0; i < input.size(); i++) input[i] = (uint8_t)(i * 17 + i / 1000);
+
+  ASSERT_THROW(calculateParallelHash(input.data(), input.size(), 0), std::logic_error);
+
+  // The result is the hash of the chunk digests followed by the buffer and chunk sizes
+  const size_t        chunkSize = 65536;
+  std::vector<hash_t> digests;
+  for (size_t pos = 0; pos < input.size(); pos += chunkSize) digests.push_back(calculateMetroHash(&input[pos], std::min(chunkSize, input.size() - pos)));
+  const uint64_t     sizes[2] = {input.size(), chunkSize};
+  MetroHash128Hasher hasher;
+  hasher.update(digests.data(), digests.size() * sizeof(hash_t));
+  hasher.update(sizes, sizeof(sizes));
+  const hash_t expected = hasher.finalize();
+
+  // ...regardless of the number of threads
+  const size_t maxThreads = parallel::getMaxThreadCount();
+  for (const size_t threadCount : {(size_t)1, (size_t)3, (size_t)8})
+  {
+    parallel::setThreadCount(threadCount);
+    ASSERT_EQ(calculateParallelHash(input.data(), input.size(), chunkSize), expected);
+  }
+  parallel::setThreadCount(maxThreads);
+
+  // Changing the chunk size, the contents or the size changes the hash; empty buffers are supported
+  ASSERT_NE(calculateParallelHash(input.data(), input.size(), chunkSize * 2), expected);
+  ASSERT_NE(calculateParallelHash(input.data(), input.size() - 1, chunkSize), expected);
+  input[777777] ^= 1;
+  ASSERT_NE(calculateParallelHash(input.data(), input.size(), chunkSize), expected);
+  ASSERT_NE(calculateParallelHash(input.data(), 0), calculateParallelHash(input.data(), 1));
+}
+
+TEST(hash, maskedHash)
+{
+  std::vector<uint8_t> input(1000);
+  for (size_t i = 0; i < input.size(); i++) input[i] = (uint8_t)(i * 13 + 5);
+
+  // Out of range exclusions and mismatched buffer sizes are rejected
+  ASSERT_THROW(HashMask(1000, {{990, 11}}), std::logic_error);
+  ASSERT_THROW(HashMask(1000, {{1001, 0}}), std::logic_error);
+  ASSERT_THROW(calculateMaskedHash(input.data(), 999, HashMask(1000, {})), std::logic_error);
+
+  // Without exclusions, the masked hash is the plain hash
+  ASSERT_EQ(calculateMaskedHash(input.data(), input.size(), HashMask(1000, {})), calculateMetroHash(input.data(), input.size()));
+
+  // Unsorted, overlapping, adjacent and empty ranges get merged into the complementary segments
+  const HashMask mask(1000, {{500, 20}, {0, 10}, {510, 30}, {540, 5}, {700, 0}, {990, 10}});
+  const std::vector<std::pair<size_t, size_t>> expectedSegments = {{10, 490}, {545, 445}};
+  ASSERT_EQ(mask.getSegments(), expectedSegments);
+  ASSERT_EQ(mask.getHashedSize(), 935);
+
+  // The masked hash equals the hash of the kept bytes, concatenated
+  std::vector<uint8_t> kept;
+  for (const auto& segment : expectedSegments) kept.insert(kept.end(), &input[segment.first], &input[segment.first + segment.second]);
+  const hash_t masked = calculateMaskedHash(input.data(), input.size(), mask);
+  ASSERT_EQ(masked, calculateMetroHash(kept.data(), kept.size()));
+  ASSERT_EQ(calculateMaskedHash<CRC32CHasher>(input.data(), input.size(), mask), CRC32CHasher::calculate(kept.data(), kept.size()));
+
+  // Changes inside excluded ranges are ignored; changes elsewhere are not
+  input[5] ^= 1, input[520] ^= 1, input[999] ^= 1;
+  ASSERT_EQ(calculateMaskedHash(input.data(), input.size(), mask), masked);
+  input[600] ^= 1;
+  ASSERT_NE(calculateMaskedHash(input.data(), input.size(), mask), masked);
+
+  // A bitmap describing the same exclusions compiles to the same segments
+  std::vector<bool> excludedBytes(1000, true);
+  for (const auto& segment : expectedSegments)
+    for (size_t i = 0; i < segment.second; i++) excludedBytes[segment.first + i] = false;
+  ASSERT_EQ(HashMask(excludedBytes).getSegments(), expectedSegments);
+
+  // Excluding everything hashes the empty input
+  ASSERT_EQ(calculateMaskedHash(input.data(), input.size(), HashMask(1000, {{0, 1000}})), calculateMetroHash(input.data(), 0));
+}
@@ -2,6 +2,8 @@
 #include <jaffarCommon/serializers/contiguous.hpp>
 #include <jaffarCommon/deserializers/contiguous.hpp>
 #include <jaffarCommon/serializers/differential.hpp>
+#include <jaffarCommon/serializers/hash.hpp>
+#include <jaffarCommon/hashers/crc32c.hpp>
 #include <jaffarCommon/deserializers/differential.hpp>
 
 using namespace jaffarCommon;
@@ -98,6 +100,42 @@ TEST(contiguous, deserializerGetters)
   ASSERT_EQ(d.getInputDataBuffer(), inputBuffer);
 }
 
+TEST(hash, serialization)
+{
+  std::string input1 = "Hello,";
+  std::string input2(10000, 'x');
+  for (size_t i = 0; i < input2.size(); i++) input2[i] = (char)(i * 7);
+
+  const std::string contiguous = input1 + input2;
+  const auto        expected   = hash::calculateMetroHash(contiguous.data(), contiguous.size());
+
+  // Hash-only mode
+  serializer::Hash s;
+  ASSERT_NO_THROW(s.push(input1.data(), input1.size()));
+  ASSERT_EQ(s.getHash(), hash::calculateMetroHash(input1.data(), input1.size()));
+  ASSERT_NO_THROW(s.pushContiguous(input2.data(), input2.size()));
+  ASSERT_EQ(s.getOutputSize(), contiguous.size());
+  ASSERT_EQ(s.getOutputDataBuffer(), nullptr);
+  ASSERT_EQ(s.getHash(), expected);
+
+  // Fused mode: the output buffer gets the contiguous serialization and the hash is the same
+  const size_t outputBufferSize = 16384;
+  auto         outputBuffer     = calloc(1, outputBufferSize);
+  serializer::Hash f(outputBuffer, outputBufferSize);
+  ASSERT_THROW(f.push(nullptr, outputBufferSize + 1), std::runtime_error);
+  ASSERT_NO_THROW(f.push(input1.data(), input1.size()));
+  ASSERT_NO_THROW(f.push(input2.data(), input2.size()));
+  ASSERT_EQ(std::string((const char*)outputBuffer, f.getOutputSize()), contiguous);
+  ASSERT_EQ(f.getHash(), expected);
+  free(outputBuffer);
+
+  // Alternative backends hash the same bytes
+  serializer::Hash<hash::CRC32CHasher> c;
+  c.push(input1.data(), input1.size());
+  c.push(input2.data(), input2.size());
+  ASSERT_EQ(c.getHash(), hash::CRC32CHasher::calculate(contiguous.data(), contiguous.size()));
+}
+
 TEST(differential, fullCycleNoZlib)
 {
   const std::string reference = "Hello, World!"; // Reference Data